@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interaction.h"
+#include "rnainteraction.h"
+
+// a context of the API: the folding context and its cache
+struct rnai_context{
+	struct context ctx;
+	struct cache cache;
+};
+
+int rnaiVersion(void){
+	return(RNAI_VERSION);
+}
+
+const char* rnaiStatusString(const int status){
+	switch(status){
+		case RNAI_OK: return("ok");
+		case RNAI_ERROR_ARGUMENT: return("invalid argument");
+		case RNAI_ERROR_MEMORY: return("out of memory");
+		case RNAI_ERROR_FOLD: return("folding failed");
+		default: return("unknown status");
+	}
+}
+
+// checks of the arguments
+
+// bases of one or more strands, separated by '&'
+static int validSeq(const char *seq){
+	if(!seq || !*seq || *seq == '&') return(0);
+	for(const char *c = seq; *c; ++c){
+		if(*c == '&'){
+			if(c[1] == '&' || !c[1]) return(0);
+		} else if(!strchr("ACGUTacgut", *c)) return(0);
+	}
+	return(1);
+}
+
+// str is a balanced structure of the strands joined by '&', separators where the strands have them too
+static int validStructure(const char *str, const char **strands, const unsigned int no_strands){
+	if(!str) return(0);
+	int depth = 0;
+	for(unsigned int s = 0; s < no_strands; ++s){
+		if(s && *str++ != '&') return(0);
+		for(const char *c = strands[s]; *c; ++c, ++str){
+			if(*c == '&' ? *str != '&' : *str == '&') return(0);
+			switch(*str){
+				case '(': ++depth; break;
+				case ')': if(--depth < 0) return(0); break;
+				case '.': case '&': break;
+				default: return(0);
+			}
+		}
+	}
+	return( !*str && !depth );
+}
+
+// the workspace of the calling thread, grown for length chars, with its error cleared
+static struct workspace* beginCall(rnai_context *c, const unsigned int length){
+	struct workspace *ws = getWorkspace(&c->ctx, length);
+	if(ws) ws->error = 0;
+	return(ws);
+}
+
+// copy a list of the arena to a block of the caller
+static int copyStructures(vrna_subopt_solution_t *l, struct rnai_structures *out){
+	const unsigned int n = countLength(l);
+	out->items = NULL;
+	out->count = 0;
+	if(!n) return(RNAI_OK);
+
+	size_t size = n * sizeof(struct rnai_structure);
+	for(unsigned int k = 0; k < n; ++k) size += strlen(l[k].structure) + 1;
+	struct rnai_structure *items = (struct rnai_structure*) malloc(size);
+	if(!items) return(RNAI_ERROR_MEMORY);
+
+	char *strings = (char*) (items + n);
+	for(unsigned int k = 0; k < n; ++k){
+		items[k].energy = l[k].energy;
+		items[k].structure = strcpy(strings, l[k].structure);
+		strings += strlen(strings) + 1;
+	}
+	out->items = items;
+	out->count = n;
+	return(RNAI_OK);
+}
+
+// contexts
+
+///  create a context for a given temperature
+/**
+ * @param[in] temperature Temperature of binding in Celsius degrees
+ * @param[out] ctx The new context, free it with rnaiDestroy
+ *
+ * @return RNAI_OK, or RNAI_ERROR_ARGUMENT or RNAI_ERROR_MEMORY.
+ */
+int rnaiCreate(const double temperature, rnai_context **ctx){
+	if(!ctx) return(RNAI_ERROR_ARGUMENT);
+	*ctx = (rnai_context*) calloc(1, sizeof(rnai_context));
+	if(!*ctx) return(RNAI_ERROR_MEMORY);
+	if(!initContext(temperature, &(*ctx)->ctx)){
+		free(*ctx);
+		*ctx = NULL;
+		return(RNAI_ERROR_MEMORY);
+	}
+	return(RNAI_OK);
+}
+
+void rnaiDestroy(rnai_context *ctx){
+	if(!ctx) return;
+	if(ctx->ctx.cache) freeCache(ctx->ctx.cache);
+	freeContext(&ctx->ctx);
+	free(ctx);
+}
+
+///  memoize results in a cache of bytes (0 turns it off), before the first call
+int rnaiSetCache(rnai_context *ctx, const size_t bytes){
+	if(!ctx) return(RNAI_ERROR_ARGUMENT);
+	if(ctx->ctx.cache){
+		freeCache(ctx->ctx.cache);
+		ctx->ctx.cache = NULL;
+	}
+	if(!bytes) return(RNAI_OK);
+	if(!initCache(bytes, 64, &ctx->cache)) return(RNAI_ERROR_MEMORY);
+	ctx->ctx.cache = &ctx->cache;
+	return(RNAI_OK);
+}
+
+///  limits of the lists of rnaiFn3 and rnaiConnect3 (see struct subopt_limits), before the first call
+int rnaiSetLimits(rnai_context *ctx, const unsigned int top_k, const int window, const unsigned int max_count){
+	if(!ctx) return(RNAI_ERROR_ARGUMENT);
+	ctx->ctx.limits.top_k = top_k;
+	ctx->ctx.limits.window = window;
+	ctx->ctx.limits.max_count = max_count;
+	return(RNAI_OK);
+}
+
+///  rnaiFn2 folds only the dangling ends around the fixed monomer structures (see hybridizeEnds), before the first call
+int rnaiSetEnds(rnai_context *ctx, const int ends){
+	if(!ctx) return(RNAI_ERROR_ARGUMENT);
+	ctx->ctx.ends = ends;
+	return(RNAI_OK);
+}
+
+///  rnaiFn3 and rnaiConnect3 draw this many structures from the Boltzmann ensemble instead of enumerating them (0 turns it off, see sampledSubopt), before the first call
+int rnaiSetSampling(rnai_context *ctx, const unsigned int samples){
+	if(!ctx) return(RNAI_ERROR_ARGUMENT);
+	ctx->ctx.limits.samples = samples;
+	return(RNAI_OK);
+}
+
+// functions
+
+///  MFE and MFE structure of a single RNA, see foldRNA
+/**
+ * @param[out] structure strlen(seq)+1 chars, can be NULL
+ */
+int rnaiFold(rnai_context *ctx, const char *seq, float *mfe, char *structure){
+	if(!ctx || !mfe || !validSeq(seq) || strchr(seq, '&')) return(RNAI_ERROR_ARGUMENT);
+	struct workspace *ws = beginCall(ctx, strlen(seq));
+	if(!ws) return(RNAI_ERROR_MEMORY);
+
+	*mfe = foldRNA(seq, structure, &ctx->ctx);
+	resetArena(&ws->arena);
+	return( ws->error ? RNAI_ERROR_FOLD : RNAI_OK );
+}
+
+///  the 3' dangling end of the left RNA binding the 5' dangling end of the right one, see fn2
+/**
+ * @param[out] structure Structure of left&right, strlen(left_seq) + strlen(right_seq) + 2 chars, can be NULL
+ */
+int rnaiFn2(rnai_context *ctx, const char *left_seq, const char *left_str, const char *right_seq, const char *right_str, float *mfe, char *structure){
+	if(!ctx || !mfe || !validSeq(left_seq) || !validSeq(right_seq) || strchr(left_seq, '&') || strchr(right_seq, '&')
+			|| !validStructure(left_str, &left_seq, 1) || !validStructure(right_str, &right_seq, 1)) return(RNAI_ERROR_ARGUMENT);
+	struct workspace *ws = beginCall(ctx, strlen(left_seq) + strlen(right_seq) + 2);
+	if(!ws) return(RNAI_ERROR_MEMORY);
+
+	char *compl_str = NULL;
+	*mfe = fn2((char*) left_seq, (char*) left_str, (char*) right_seq, (char*) right_str, NULL, structure ? &compl_str : NULL, &ctx->ctx);
+	const int status = ws->error ? RNAI_ERROR_FOLD : structure && !compl_str ? RNAI_ERROR_MEMORY : RNAI_OK;
+	if(status == RNAI_OK && structure) strcpy(structure, compl_str);
+	resetArena(&ws->arena);
+	return(status);
+}
+
+///  duplexes of two RNAs up to 0 kcal/mol, see fn3
+/**
+ * @param[out] duplexes The list, empty if no duplex was formed. Free it with rnaiFreeStructures.
+ */
+int rnaiFn3(rnai_context *ctx, const char *rna1, const char *rna2, struct rnai_structures *duplexes){
+	if(!ctx || !duplexes || !validSeq(rna1) || !validSeq(rna2) || strchr(rna1, '&') || strchr(rna2, '&')) return(RNAI_ERROR_ARGUMENT);
+	duplexes->items = NULL;
+	duplexes->count = 0;
+	struct workspace *ws = beginCall(ctx, strlen(rna1) + strlen(rna2) + 1);
+	if(!ws) return(RNAI_ERROR_MEMORY);
+
+	vrna_subopt_solution_t *l = fn3((char*) rna1, (char*) rna2, &ctx->ctx);
+	const int status = ws->error ? RNAI_ERROR_FOLD : copyStructures(l, duplexes);
+	resetArena(&ws->arena);
+	return(status);
+}
+
+///  triplexes of a duplex and a single RNA up to 0 kcal/mol, see connect3
+/**
+ * @param[out] triplexes The list, empty if no triplex was formed. Free it with rnaiFreeStructures.
+ */
+int rnaiConnect3(rnai_context *ctx, const char *duplex1_seq, const char *duplex2_seq, const char *duplex_str, const char *single_seq, struct rnai_structures *triplexes){
+	const char *duplex[2] = {duplex1_seq, duplex2_seq};
+	if(!ctx || !triplexes || !validSeq(duplex1_seq) || !validSeq(duplex2_seq) || !validSeq(single_seq)
+			|| strchr(duplex1_seq, '&') || strchr(duplex2_seq, '&') || strchr(single_seq, '&')
+			|| !validStructure(duplex_str, duplex, 2)) return(RNAI_ERROR_ARGUMENT);
+	triplexes->items = NULL;
+	triplexes->count = 0;
+	struct workspace *ws = beginCall(ctx, strlen(duplex_str) + strlen(single_seq) + 2);
+	if(!ws) return(RNAI_ERROR_MEMORY);
+
+	vrna_subopt_solution_t *l = connect3((char*) duplex1_seq, (char*) duplex2_seq, (char*) duplex_str, (char*) single_seq, &ctx->ctx);
+	const int status = ws->error ? RNAI_ERROR_FOLD : copyStructures(l, triplexes);
+	resetArena(&ws->arena);
+	return(status);
+}
+
+///  energy of a complex in a given structure, see fn4
+/**
+ * @param[in] seq Strands separated by '&'
+ * @param[in] str Structure with the separators of seq
+ */
+int rnaiFn4(rnai_context *ctx, const char *seq, const char *str, float *mfe){
+	if(!ctx || !mfe || !validSeq(seq) || !validStructure(str, &seq, 1)) return(RNAI_ERROR_ARGUMENT);
+	struct workspace *ws = beginCall(ctx, strlen(seq));
+	if(!ws) return(RNAI_ERROR_MEMORY);
+
+	*mfe = fn4((char*) seq, (char*) str, &ctx->ctx);
+	resetArena(&ws->arena);
+	return( ws->error ? RNAI_ERROR_FOLD : RNAI_OK );
+}
+
+void rnaiFreeStructures(struct rnai_structures *list){
+	if(!list) return;
+	free(list->items);
+	list->items = NULL;
+	list->count = 0;
+}
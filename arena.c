@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+void initArena(const size_t block_size, struct arena *a){
+	a->blocks = NULL;
+	a->spare = NULL;
+	a->block_size = block_size;
+}
+
+static void freeBlocks(struct arena_block *b){
+	while(b){
+		struct arena_block *next = b->next;
+		free(b);
+		b = next;
+	}
+}
+
+void freeArena(struct arena *a){
+	freeBlocks(a->blocks);
+	freeBlocks(a->spare);
+	a->blocks = NULL;
+	a->spare = NULL;
+}
+
+///  release everything allocated from the arena
+/**
+ * The blocks are kept for reuse, so once an arena has grown to the size of a job, the following jobs do not allocate.
+ */
+void resetArena(struct arena *a){
+	while(a->blocks){
+		struct arena_block *next = a->blocks->next;
+		a->blocks->used = 0;
+		a->blocks->next = a->spare;
+		a->spare = a->blocks;
+		a->blocks = next;
+	}
+}
+
+///  allocate memory from an arena
+/**
+ * @param[in] a The arena
+ * @param[in] size Number of bytes, the memory is aligned to 16 bytes and not initialised
+ *
+ * @return Pointer to the memory, or NULL if a new block could not be allocated.
+ */
+void* arenaAlloc(struct arena *a, const size_t size){
+	const size_t aligned = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+
+	if(!a->blocks || a->blocks->used + aligned > a->blocks->size){
+		// take a spare block if it is large enough, otherwise make a new one
+		struct arena_block **s = &a->spare;
+		while(*s && (*s)->size < aligned) s = &(*s)->next;
+
+		struct arena_block *b = *s;
+		if(b){
+			*s = b->next;
+		} else {
+			const size_t block_size = aligned > a->block_size ? aligned : a->block_size;
+			b = (struct arena_block*) malloc(sizeof(struct arena_block) + block_size);
+			if(!b){
+				fprintf(stderr, "ERROR: arenaAlloc: could not allocate block in size %zu\n", block_size);
+				return(NULL);
+			}
+			b->size = block_size;
+		}
+		b->used = 0;
+		b->next = a->blocks;
+		a->blocks = b;
+	}
+
+	void *p = a->blocks->data + a->blocks->used;
+	a->blocks->used += aligned;
+	return(p);
+}
+
+char* arenaStrdup(struct arena *a, const char *str){
+	const size_t length = strlen(str);
+	char *copy = (char*) arenaAlloc(a, length+1);
+	if(copy) memcpy(copy, str, length+1);
+	return(copy);
+}
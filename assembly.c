@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <omp.h>
+#include <ViennaRNA/fold.h>
+#include "assembly.h"
+#include "scheduler.h"
+
+#define TRANSPOSITION_SIZE (1U << 20) // entries of the transposition table, a power of 2
+#define TRANSPOSITION_LOCKS 64
+#define ASSEMBLY_EPS 1e-3f // energies closer than this are equal
+
+// a complex on the way and the pathway that built it
+struct node{
+	unsigned int k; // strands in the complex
+	unsigned int used; // bit set of them
+	struct assembly a; // seq and structure are not owned
+};
+
+// a complex one step further
+struct child{
+	unsigned char strand, side;
+	float energy, binding;
+	char *seq, *structure;
+};
+
+// transposition table: best binding energy an order of strands was reached with, lossy
+struct transposition{
+	uint64_t key; // 0 if empty
+	float binding;
+};
+
+struct search{
+	const struct pool *p;
+	struct context *ctx;
+	float *pair; // binding energy of every ordered pair, the complex left&right
+	float lb[ASSEMBLY_MAX_STRANDS]; // lower bound of the binding step of every strand
+	struct transposition *table;
+	pthread_mutex_t locks[TRANSPOSITION_LOCKS];
+	pthread_mutex_t lock; // guards best
+	struct assembly *best;
+	int found;
+	struct assembly_stats stats;
+	int error;
+};
+
+// key of an order of strands, 5 bits per strand
+static uint64_t orderKey(const struct node *n){
+	uint64_t key = 0;
+	for(unsigned int k = 0; k < n->k; ++k) key = (key << 5) | (n->a.order[k] + 1);
+	return(key);
+}
+
+// fold a complex with fn2 and copy it out of the arena, energy is 1.0 on errors
+static float bindStrand(const char *left_seq, const char *left_str, const char *right_seq, const char *right_str, char **seq, char **structure, struct context *ctx){
+	struct workspace *ws = getWorkspace(ctx, 0);
+	if(!ws) return(1.0);
+	ws->error = 0;
+	char *compl_seq = NULL, *compl_str = NULL;
+	const float mfe = fn2((char*) left_seq, (char*) left_str, (char*) right_seq, (char*) right_str, &compl_seq, &compl_str, ctx);
+	const int ok = !ws->error && compl_seq && compl_str;
+	*seq = ok ? strdup(compl_seq) : NULL;
+	*structure = ok ? strdup(compl_str) : NULL;
+	resetArena(&ws->arena);
+	if(!*seq || !*structure){
+		free(*seq);
+		free(*structure);
+		*seq = *structure = NULL;
+		return(1.0);
+	}
+	return(mfe);
+}
+
+// keep n if it is the best full complex so far
+static void offer(struct search *s, const struct node *n){
+	pthread_mutex_lock(&s->lock);
+	if(!s->found || n->a.binding < s->best->binding - ASSEMBLY_EPS){
+		char *seq = strdup(n->a.seq), *structure = strdup(n->a.structure);
+		if(seq && structure){
+			freeAssembly(s->best);
+			*s->best = n->a;
+			s->best->seq = seq;
+			s->best->structure = structure;
+			s->found = 1;
+		} else{
+			free(seq);
+			free(structure);
+			s->error = 1;
+		}
+	}
+	pthread_mutex_unlock(&s->lock);
+}
+
+// can n not lead to a better complex than the best so far
+static int bounded(struct search *s, const struct node *n){
+	float rest = n->a.binding;
+	for(unsigned int t = 0; t < s->p->n; ++t) if(!(n->used & (1U << t))) rest += s->lb[t];
+	pthread_mutex_lock(&s->lock);
+	const int b = s->found && rest >= s->best->binding - ASSEMBLY_EPS;
+	pthread_mutex_unlock(&s->lock);
+	return(b);
+}
+
+// was the order of n reached before with no higher energy, else record it
+static int transposed(struct search *s, const struct node *n){
+	const uint64_t key = orderKey(n);
+	const uint64_t h = key * 0x9E3779B97F4A7C15ULL;
+	const unsigned int slot = (unsigned int) (h >> 40) & (TRANSPOSITION_SIZE - 1);
+	pthread_mutex_t *lock = s->locks + (slot % TRANSPOSITION_LOCKS);
+	struct transposition *e = s->table + slot;
+
+	pthread_mutex_lock(lock);
+	const int seen = e->key == key && e->binding <= n->a.binding + ASSEMBLY_EPS;
+	if(!seen){ // replace whatever was there
+		e->key = key;
+		e->binding = n->a.binding;
+	}
+	pthread_mutex_unlock(lock);
+	return(seen);
+}
+
+static int compareChildren(const void *x, const void *y){
+	const struct child *a = (const struct child*) x, *b = (const struct child*) y;
+	return( (a->binding > b->binding) - (a->binding < b->binding) );
+}
+
+// depth first search below n, most favourable steps first
+static void expand(struct search *s, const struct node *n){
+	const struct pool *p = s->p;
+	#pragma omp atomic
+	++s->stats.complexes;
+
+	if(n->k == p->n){
+		offer(s, n);
+		return;
+	}
+	if(bounded(s, n)){
+		#pragma omp atomic
+		++s->stats.bounded;
+		return;
+	}
+	if(transposed(s, n)){
+		#pragma omp atomic
+		++s->stats.transpositions;
+		return;
+	}
+
+	// every strand left, on both ends
+	struct child *children = (struct child*) calloc(2 * (p->n - n->k), sizeof(struct child));
+	if(!children){
+		fprintf(stderr, "ERROR: expand: could not allocate steps\n");
+		s->error = 1;
+		return;
+	}
+	unsigned int no_children = 0;
+	float monomers = n->a.energy - n->a.binding;
+	for(unsigned int t = 0; t < p->n && !s->error; ++t){
+		if(n->used & (1U << t)) continue;
+		for(unsigned char side = ASSEMBLY_3; side <= ASSEMBLY_5; ++side){
+			struct child *c = children + no_children;
+			c->energy = side == ASSEMBLY_3 ?
+				bindStrand(n->a.seq, n->a.structure, p->seqs[t], p->strs[t], &c->seq, &c->structure, s->ctx) :
+				bindStrand(p->seqs[t], p->strs[t], n->a.seq, n->a.structure, &c->seq, &c->structure, s->ctx);
+			if(!c->seq){
+				fprintf(stderr, "ERROR: expand: could not bind strand %u to %s\n", t, n->a.seq);
+				s->error = 1;
+				break;
+			}
+			c->strand = t;
+			c->side = side;
+			c->binding = c->energy - monomers - p->mfe[t];
+			++no_children;
+		}
+	}
+	qsort(children, no_children, sizeof(struct child), &compareChildren);
+
+	for(unsigned int k = 0; k < no_children && !s->error; ++k){
+		const struct child *c = children + k;
+		struct node next = *n;
+		next.k = n->k + 1;
+		next.used = n->used | (1U << c->strand);
+		if(c->side == ASSEMBLY_3) next.a.order[n->k] = c->strand;
+		else{
+			memmove(next.a.order + 1, n->a.order, n->k);
+			next.a.order[0] = c->strand;
+		}
+		next.a.steps[next.a.no_steps++] = (struct assembly_step) {c->strand, c->side, c->binding - n->a.binding};
+		next.a.seq = c->seq;
+		next.a.structure = c->structure;
+		next.a.energy = c->energy;
+		next.a.binding = c->binding;
+		expand(s, &next);
+	}
+
+	for(unsigned int k = 0; k < no_children; ++k){
+		free(children[k].seq);
+		free(children[k].structure);
+	}
+	free(children);
+}
+
+// one branch of the search: the duplex of an ordered pair
+static void searchPair(const unsigned long int task, const int worker, void *arg){
+	struct search *s = (struct search*) arg;
+	const struct pool *p = s->p;
+	const unsigned int left = task / p->n, right = task % p->n;
+	if(left == right || s->error) return;
+
+	struct node n;
+	memset(&n, 0, sizeof(n));
+	n.k = 2;
+	n.used = (1U << left) | (1U << right);
+	n.a.first = left;
+	n.a.order[0] = left;
+	n.a.order[1] = right;
+	n.a.energy = bindStrand(p->seqs[left], p->strs[left], p->seqs[right], p->strs[right], &n.a.seq, &n.a.structure, s->ctx);
+	if(!n.a.seq){
+		fprintf(stderr, "ERROR: searchPair: could not bind strands %u and %u\n", left, right);
+		s->error = 1;
+		return;
+	}
+	n.a.binding = n.a.energy - p->mfe[left] - p->mfe[right];
+	n.a.steps[n.a.no_steps++] = (struct assembly_step) {right, ASSEMBLY_3, n.a.binding};
+	expand(s, &n);
+
+	free(n.a.seq);
+	free(n.a.structure);
+}
+
+///  best pathway to assemble all strands of a pool into one complex
+/**
+ * Branch and bound over the binding orders: every branch starts with the duplex of an ordered pair, and binds the strands left one at a time to the 3' or the 5' end of the complex with fn2, most favourable step first. The binding energies of all pairs give every strand a lower bound of its binding step, and a complex is not expanded if its binding energy plus the bounds of the strands left can not beat the best full complex found so far. A complex whose order of strands was already reached with no higher energy is not expanded again (kept in a lossy transposition table), and with a cache in the context, complexes reached along several pathways are folded once.
+ *
+ * With ctx->ends set and endsApplicable, the cores of the strands stay as folded alone and every step only hybridizes two free ends, so the bound holds and the complex of an order does not depend on the pathway (unless a strand without pairs of its own is bound on both sides), the search is exact. With the full DP of fn2 a step may rearrange the complex, and the search is a heuristic.
+ *
+ * Branches are run by runTasks, the most favourable duplexes first, so a good bound is known early.
+ *
+ * @param[in] p Pool of 2 to ASSEMBLY_MAX_STRANDS strands, already folded with foldPool
+ * @param[in] threads Number of workers. If 0, the OpenMP default is used.
+ * @param[in] ctx Folding context (temperature, model details, workspaces, cache)
+ * @param[out] best The best pathway, free it with freeAssembly
+ * @param[out] stats Counts of the search, can be NULL
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int assemble(const struct pool *p, const int threads, struct context *ctx, struct assembly *best, struct assembly_stats *stats){
+	memset(best, 0, sizeof(struct assembly));
+	if(p->n < 2 || p->n > ASSEMBLY_MAX_STRANDS){
+		fprintf(stderr, "ERROR: assemble: can assemble 2 to %d strands, not %u\n", ASSEMBLY_MAX_STRANDS, p->n);
+		return(0);
+	}
+
+	struct search s;
+	memset(&s, 0, sizeof(s));
+	s.p = p;
+	s.ctx = ctx;
+	s.best = best;
+	const unsigned long int no_tasks = (unsigned long int) p->n * p->n;
+	s.pair = (float*) malloc(no_tasks * sizeof(float));
+	s.table = (struct transposition*) calloc(TRANSPOSITION_SIZE, sizeof(struct transposition));
+	double *cost = (double*) malloc(no_tasks * sizeof(double));
+	if(!s.pair || !s.table || !cost){
+		fprintf(stderr, "ERROR: assemble: could not allocate the search\n");
+		free(s.pair);
+		free(s.table);
+		free(cost);
+		return(0);
+	}
+	pthread_mutex_init(&s.lock, NULL);
+	for(unsigned int k = 0; k < TRANSPOSITION_LOCKS; ++k) pthread_mutex_init(s.locks + k, NULL);
+
+	// binding energies of all pairs
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(threads ? threads : omp_get_max_threads())
+	for(unsigned long int t = 0; t < no_tasks; ++t){
+		const unsigned int left = t / p->n, right = t % p->n;
+		s.pair[t] = 0.0f;
+		if(left == right) continue;
+		char *seq, *structure;
+		const float mfe = bindStrand(p->seqs[left], p->strs[left], p->seqs[right], p->strs[right], &seq, &structure, ctx);
+		if(!seq){
+			#pragma omp atomic write
+			s.error = 1;
+			continue;
+		}
+		s.pair[t] = mfe - p->mfe[left] - p->mfe[right];
+		free(seq);
+		free(structure);
+	}
+
+	// a strand binds at best as well as to its best partner, and never unfavourably
+	for(unsigned int t = 0; t < p->n; ++t){
+		s.lb[t] = 0.0f;
+		for(unsigned int u = 0; u < p->n; ++u){
+			if(u == t) continue;
+			if(s.pair[t * p->n + u] < s.lb[t]) s.lb[t] = s.pair[t * p->n + u];
+			if(s.pair[u * p->n + t] < s.lb[t]) s.lb[t] = s.pair[u * p->n + t];
+		}
+	}
+
+	// most favourable duplexes first
+	for(unsigned long int t = 0; t < no_tasks; ++t) cost[t] = (t / p->n == t % p->n) ? 0.0 : 1.0 - s.pair[t];
+
+	if(!s.error && runTasks(no_tasks, cost, threads, &searchPair, &s)) s.error = 1;
+
+	for(unsigned int k = 0; k < TRANSPOSITION_LOCKS; ++k) pthread_mutex_destroy(s.locks + k);
+	pthread_mutex_destroy(&s.lock);
+	free(s.pair);
+	free(s.table);
+	free(cost);
+
+	if(stats) *stats = s.stats;
+	if(s.error || !s.found){
+		if(!s.error) fprintf(stderr, "ERROR: assemble: no complex was found\n");
+		freeAssembly(best);
+		return(0);
+	}
+	return(1);
+}
+
+void freeAssembly(struct assembly *a){
+	free(a->seq);
+	free(a->structure);
+	a->seq = a->structure = NULL;
+}
+
+int assemblyMain(int argc, char** argv){
+	char *input = "-";
+	unsigned long int cache_mb = 64;
+	int threads = 0, full = 0;
+	double temperature = VRNA_MODEL_DEFAULT_TEMPERATURE;
+
+	int c;
+	while((c = getopt(argc, argv, "i:t:c:T:F")) != -1){
+		switch(c){
+			case 'i': input = optarg; break;
+			case 't': threads = atoi(optarg); break;
+			case 'c': cache_mb = strtoul(optarg, NULL, 10); break;
+			case 'T': temperature = strtod(optarg, NULL); break;
+			case 'F': full = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-i strands] [-t threads] [-c cache_MB] [-T temperature] [-F]\n", argv[0]);
+				return(1);
+		}
+	}
+
+	struct context ctx;
+	if(!initContext(temperature, &ctx)) return(1);
+	ctx.ends = !full; // the full DP of fn2 may rearrange the complex at every step
+
+	struct cache cache;
+	if(cache_mb){
+		if(!initCache(cache_mb << 20, 64, &cache)){
+			freeContext(&ctx);
+			return(1);
+		}
+		ctx.cache = &cache;
+	}
+
+	struct pool p;
+	memset(&p, 0, sizeof(p));
+	struct assembly best;
+	struct assembly_stats stats;
+	int error = !readPool(input, &p) || !foldPool(&p, threads, &ctx) || !assemble(&p, threads, &ctx, &best, &stats);
+
+	if(!error){
+		printf("%s\n%s %6.2f (binding %6.2f)\n", best.seq, best.structure, best.energy, best.binding);
+		printf("start %u\n", best.first);
+		for(unsigned int k = 0; k < best.no_steps; ++k)
+			printf("bind %u at %s end %6.2f\n", best.steps[k].strand, best.steps[k].side == ASSEMBLY_3 ? "3'" : "5'", best.steps[k].energy);
+		fprintf(stderr, "assemble: %lu complexes, %lu bounded, %lu transpositions\n", stats.complexes, stats.bounded, stats.transpositions);
+		freeAssembly(&best);
+	}
+
+	freePool(&p);
+	if(ctx.cache){
+		printCacheStats(ctx.cache, stderr);
+		freeCache(ctx.cache);
+	}
+	freeContext(&ctx);
+	return(error);
+}
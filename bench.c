@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <ViennaRNA/fold.h>
+#include <ViennaRNA/subopt/wuchty.h>
+#include <gsl/gsl_rng.h>
+#include "interaction.h"
+#include "energy.h"
+#include "hybrid.h"
+#include "constraint.h"
+#include "bound.h"
+
+// allocations
+
+// every allocation of the process is counted, RNAlib included, by interposing the allocator of glibc
+#ifdef __GLIBC__
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void *p, size_t size);
+
+static unsigned long int allocations = 0;
+
+void* malloc(size_t size){
+	__atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+	return( __libc_malloc(size) );
+}
+
+void* calloc(size_t n, size_t size){
+	__atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+	return( __libc_calloc(n, size) );
+}
+
+void* realloc(void *p, size_t size){
+	__atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+	return( __libc_realloc(p, size) );
+}
+
+static unsigned long int countAllocations(){
+	return( __atomic_load_n(&allocations, __ATOMIC_RELAXED) );
+}
+#define COUNTS_ALLOCATIONS 1
+#else
+static unsigned long int countAllocations(){ return(0); }
+#define COUNTS_ALLOCATIONS 0
+#endif
+
+// workloads
+
+enum bench_function{BENCH_FN2, BENCH_FN3, BENCH_CONNECT3, BENCH_CONNECT3_ENDS, BENCH_FN4, BENCH_PIPELINE, BENCH_FN2_ENDS, BENCH_EVAL, BENCH_HYBRID, BENCH_CONSTRAINT, BENCH_PREFILTER, NO_FUNCTIONS};
+static const char *function_names[] = {"fn2", "fn3", "connect3", "connect3_ends", "fn4", "pipeline", "fn2_ends", "eval", "hybrid", "constraint", "prefilter"};
+
+// lengths of the strands of a workload, in nt, and the share of the calls it gets
+struct bench_lengths{
+	unsigned int min, max;
+	unsigned int divisor; // a workload makes calls/divisor calls, long strands are much slower
+};
+static const struct bench_lengths lengths[] = {{4, 12, 1}, {20, 50, 10}, {100, 150, 100}};
+#define NO_LENGTHS (sizeof(lengths) / sizeof(lengths[0]))
+
+// measurements of one workload
+struct bench_result{
+	unsigned long int calls;
+	double seconds, p50, p99; // latencies in seconds
+	double allocations; // per call
+	double subopt_mean; // mean length of the suboptimal lists, 0 for fn2 and fn4
+	unsigned int subopt_max;
+	long peak_rss; // in kB, of the process so far
+	unsigned long int mismatches; // fn2_ends, eval, hybrid or constraint calls whose energy differs from fn2, fn4, fn3 or fn2 with dot-bracket constraints, duplexes the prefilter rejects that fn3 binds
+};
+
+#define BENCH_BATCH 256 // duplexes of a timed fn3Batch call
+
+static double now(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return( t.tv_sec + t.tv_nsec * 1e-9 );
+}
+
+static int compareDouble(const void *a, const void *b){
+	const double x = *(const double*) a, y = *(const double*) b;
+	return( (x > y) - (x < y) );
+}
+
+static char* randomSeq(gsl_rng *r, const struct bench_lengths *l, struct arena *a){
+	const char bases[4] = {'A', 'U', 'G', 'C'};
+	unsigned int length = l->min + gsl_rng_uniform_int(r, l->max - l->min + 1);
+	char *seq = (char*) arenaAlloc(a, length+1);
+	if(!seq) return(NULL);
+
+	seq[length] = '\0';
+	while(length){seq[--length] = bases[gsl_rng_uniform_int(r, 4)];}
+	return(seq);
+}
+
+// monomer structure of a random strand
+static char* foldSeq(const char *seq, struct context *ctx){
+	char *str = (char*) arenaAlloc(getArena(ctx), strlen(seq)+1);
+	if(str) foldRNA(seq, str, ctx);
+	return(str);
+}
+
+// strand1&strand2 and the structures of the strands joined the same way, for fn4
+static char* join(const char *a, const char *b, struct arena *ar){
+	char *s = (char*) arenaAlloc(ar, strlen(a) + strlen(b) + 2);
+	if(s) sprintf(s, "%s&%s", a, b);
+	return(s);
+}
+
+///  time one workload
+/**
+ * Inputs of every call are drawn from a random stream seeded with the seed of the run and the index of the workload, and prepared outside of the timed region (monomer structures for fn2 and fn4, the full fn2 a fn2_ends call is checked against, fn4 of a duplex for eval, the best duplex for connect3 and connect3Ends, the MFE of fn3 for hybrid, fn2 with dot-bracket constraints for constraint). Calls are made from the calling thread one after another, with the cache off. Hybrid calls are timed BENCH_BATCH at a time by fn3Batch, each of them taking an even share of the batch. A constraint call is fn2 with compiled constraints, it mismatches if its MFE or structure differs from fn2 with dot-bracket constraints, or if its compiled constraint differs from the compiled dot-bracket one. A prefilter call is duplexBound, every duplex it rejects is folded by fn3 afterwards and mismatches if its MFE is negative.
+ *
+ * @param[in] f Function to time
+ * @param[in] l Lengths of the strands
+ * @param[in] calls Number of calls
+ * @param[in] seed Seed of the workload
+ * @param[in] ctx Folding context
+ * @param[out] res The measurements
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+static int benchWorkload(const enum bench_function f, const struct bench_lengths *l, const unsigned long int calls, const unsigned long int seed, struct context *ctx, struct bench_result *res){
+	double *latencies = (double*) malloc(calls * sizeof(double));
+	gsl_rng *r = gsl_rng_alloc(gsl_rng_mt19937);
+	struct arena *a = getArena(ctx);
+	if(!latencies || !r || !a){
+		fprintf(stderr, "ERROR: benchWorkload: could not allocate memory for %lu calls\n", calls);
+		free(latencies);
+		if(r) gsl_rng_free(r);
+		return(0);
+	}
+	gsl_rng_set(r, seed);
+	struct evaluator evaluator;
+	initEvaluator(&evaluator);
+	struct compiled_constraint compiled, parsed;
+	initCompiled(&compiled);
+	initCompiled(&parsed);
+
+	memset(res, 0, sizeof(struct bench_result));
+	unsigned long int allocated = 0, subopts = 0, done = 0;
+	char *batch1[BENCH_BATCH], *batch2[BENCH_BATCH];
+	float references[BENCH_BATCH], mfe[BENCH_BATCH];
+	unsigned int pending = 0;
+	for(unsigned long int i = 0; i < calls; ++i){
+		// prepare
+		char *rna1 = randomSeq(r, l, a), *rna2 = randomSeq(r, l, a), *rna3 = randomSeq(r, l, a);
+		if(!rna1 || !rna2 || !rna3) break;
+		char *str1 = NULL, *str2 = NULL, *duplex = NULL;
+		if(f == BENCH_FN2 || f == BENCH_FN4 || f == BENCH_FN2_ENDS || f == BENCH_EVAL || f == BENCH_CONSTRAINT){
+			str1 = foldSeq(rna1, ctx);
+			str2 = foldSeq(rna2, ctx);
+			if(!str1 || !str2) break;
+		}
+		char *seq4 = NULL, *str4 = NULL;
+		if(f == BENCH_FN4 || f == BENCH_EVAL){
+			seq4 = join(rna1, rna2, a);
+			str4 = join(str1, str2, a);
+			if(!seq4 || !str4) break;
+		}
+		if(f == BENCH_EVAL){
+			// stored complexes are mostly duplexes
+			vrna_subopt_solution_t *d = fn3(rna1, rna2, ctx);
+			if(countLength(d) > 0) str4 = d[0].structure;
+		}
+		if(f == BENCH_CONNECT3 || f == BENCH_CONNECT3_ENDS){
+			vrna_subopt_solution_t *d = fn3(rna1, rna2, ctx);
+			if(countLength(d) > 0) duplex = d[0].structure;
+			else{
+				// no duplex to bind to, still time the call on an open one
+				duplex = (char*) arenaAlloc(a, strlen(rna1) + strlen(rna2) + 2);
+				if(!duplex) break;
+				sprintf(duplex, "%*s&%*s", (int) strlen(rna1), "", (int) strlen(rna2), "");
+				for(char *c = duplex; *c; ++c) if(*c == ' ') *c = '.';
+			}
+		}
+
+		if(f == BENCH_HYBRID){
+			// fold the duplexes once a batch of them is drawn, the arena keeps them until then
+			vrna_subopt_solution_t *d = fn3(rna1, rna2, ctx);
+			batch1[pending] = rna1;
+			batch2[pending] = rna2;
+			references[pending++] = countLength(d) > 0 ? d[0].energy : 0.0;
+			if(pending < BENCH_BATCH && i+1 < calls) continue;
+		}
+
+		float reference = 0.0;
+		if(f == BENCH_FN2_ENDS){
+			// the full DP is the reference, the timed call folds only the ends
+			reference = fn2(rna1, str1, rna2, str2, NULL, NULL, ctx);
+			ctx->ends = 1;
+		}
+		if(f == BENCH_EVAL) reference = fn4(seq4, str4, ctx);
+		char *reference_str = NULL, *structure = NULL;
+		int *tables = NULL;
+		if(f == BENCH_PREFILTER){
+			tables = (int*) arenaAlloc(a, 2 * strlen(rna1) * strlen(rna2) * sizeof(int));
+			if(!tables) break;
+		}
+		if(f == BENCH_CONSTRAINT){
+			// the string path is the reference, the compiled one has to give the same constraint and fold
+			const unsigned int length1 = strlen(rna1), length2 = strlen(rna2);
+			char *constraint = (char*) arenaAlloc(a, length1 + length2 + 2);
+			if(!constraint) break;
+			fn2Constraint(str1, length1, str2, length2, constraint);
+			if(!compileConstraint(constraint, FN2_CONSTRAINT, &parsed) || !compileFn2(str1, length1, str2, length2, &compiled) || !equalCompiled(&parsed, &compiled)) ++res->mismatches;
+			ctx->dot_bracket = 1;
+			reference = fn2(rna1, str1, rna2, str2, NULL, &reference_str, ctx);
+			ctx->dot_bracket = 0;
+			if(!reference_str) break;
+		}
+
+		// call
+		vrna_subopt_solution_t *list = NULL;
+		struct triplex_ends ends;
+		int energy, bound = -1;
+		const unsigned long int before = countAllocations();
+		const double start = now();
+		switch(f){
+			case BENCH_FN2: fn2(rna1, str1, rna2, str2, NULL, NULL, ctx); break;
+			case BENCH_FN2_ENDS:
+				if(fabs(fn2(rna1, str1, rna2, str2, NULL, NULL, ctx) - reference) > 0.005) ++res->mismatches;
+				break;
+			case BENCH_FN3: list = fn3(rna1, rna2, ctx); break;
+			case BENCH_CONNECT3: list = connect3(rna1, rna2, duplex, rna3, ctx); break;
+			case BENCH_CONNECT3_ENDS:
+				connect3Ends(rna1, rna2, duplex, rna3, &ends, ctx);
+				if(ends.best >= 0) list = ends.orientation[ends.best].triplexes;
+				break;
+			case BENCH_FN4: fn4(seq4, str4, ctx); break;
+			case BENCH_PIPELINE:
+				list = fn3(rna1, rna2, ctx);
+				if(countLength(list) > 0) list = connect3(rna1, rna2, list[0].structure, rna3, ctx);
+				break;
+			case BENCH_EVAL:
+				if(!evalStructure(seq4, str4, ctx->params, &evaluator, &energy) || fabs(energy / 100.0 - reference) > 0.005) ++res->mismatches;
+				break;
+			case BENCH_CONSTRAINT:
+				if(fabs(fn2(rna1, str1, rna2, str2, NULL, &structure, ctx) - reference) > 0.005 || !structure || strcmp(structure, reference_str)) ++res->mismatches;
+				break;
+			case BENCH_PREFILTER:
+				if(ctx->bound.applicable) bound = duplexBound(rna1, strlen(rna1), rna2, strlen(rna2), &ctx->bound, ctx->params, tables);
+				break;
+			case BENCH_HYBRID:
+				if(!fn3Batch(batch1, batch2, pending, mfe, ctx)) pending = 0;
+				break;
+			case NO_FUNCTIONS: break;
+		}
+		const double elapsed = now() - start;
+		allocated += countAllocations() - before;
+		ctx->ends = 0;
+		if(bound >= 0){
+			// a rejected duplex must not bind, fn3 folds it without the prefilter of the context
+			vrna_subopt_solution_t *d = fn3(rna1, rna2, ctx);
+			if(countLength(d) > 0 && d[0].energy < 0) ++res->mismatches;
+		}
+
+		const unsigned int length = countLength(list);
+		subopts += length;
+		if(length > res->subopt_max) res->subopt_max = length;
+		res->seconds += elapsed;
+		if(f == BENCH_HYBRID){
+			if(!pending) break;
+			for(unsigned int k = 0; k < pending; ++k){
+				latencies[i+1-pending+k] = elapsed / pending;
+				if(fabs(mfe[k] - references[k]) > 0.005) ++res->mismatches;
+			}
+			done += pending;
+			pending = 0;
+		} else {
+			latencies[i] = elapsed;
+			++done;
+		}
+
+		resetArena(a);
+	}
+	resetArena(a);
+	gsl_rng_free(r);
+	freeEvaluator(&evaluator);
+	freeCompiled(&compiled);
+	freeCompiled(&parsed);
+
+	if(done < calls){
+		fprintf(stderr, "ERROR: benchWorkload: could not prepare call %lu of %s\n", done, function_names[f]);
+		free(latencies);
+		return(0);
+	}
+
+	qsort(latencies, calls, sizeof(double), compareDouble);
+	res->calls = calls;
+	res->p50 = latencies[(calls - 1) / 2];
+	res->p99 = latencies[(calls - 1) * 99 / 100];
+	res->allocations = (double) allocated / calls;
+	res->subopt_mean = (double) subopts / calls;
+
+	struct rusage usage;
+	res->peak_rss = getrusage(RUSAGE_SELF, &usage) ? -1 : usage.ru_maxrss;
+
+	free(latencies);
+	return(1);
+}
+
+static void printResult(FILE *out, const enum bench_function f, const struct bench_lengths *l, const struct bench_result *res, const struct hybrid_params *k){
+	fprintf(out, "    {\"function\": \"%s\", \"min_length\": %u, \"max_length\": %u, \"calls\": %lu, ", function_names[f], l->min, l->max, res->calls);
+	fprintf(out, "\"seconds\": %.6f, \"calls_per_s\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, ", res->seconds, res->seconds > 0.0 ? res->calls / res->seconds : 0.0, res->p50 * 1e6, res->p99 * 1e6);
+	if(COUNTS_ALLOCATIONS) fprintf(out, "\"allocations_per_call\": %.2f, ", res->allocations);
+	else fprintf(out, "\"allocations_per_call\": null, ");
+	fprintf(out, "\"subopt_mean\": %.3f, \"subopt_max\": %u, \"peak_rss_kb\": %ld", res->subopt_mean, res->subopt_max, res->peak_rss);
+	if(f == BENCH_FN2_ENDS || f == BENCH_EVAL || f == BENCH_HYBRID || f == BENCH_CONSTRAINT || f == BENCH_PREFILTER) fprintf(out, ", \"mismatches\": %lu", res->mismatches);
+	if(f == BENCH_HYBRID) fprintf(out, ", \"kernel\": \"%s\"", hybridKernelName(k));
+	fprintf(out, "}");
+}
+
+int main(int argc, char** argv){
+	unsigned long int seed = 1, calls = 1000;
+	struct subopt_limits limits = {100, -1, 0, 0}; // long strands have too many structures up to 0 kcal/mol
+	const char *path = NULL, *only = NULL;
+
+	int c;
+	while((c = getopt(argc, argv, "s:n:k:w:m:S:f:o:")) != -1){
+		switch(c){
+			case 's': seed = strtoul(optarg, NULL, 10); break;
+			case 'n': calls = strtoul(optarg, NULL, 10); break;
+			case 'k': limits.top_k = strtoul(optarg, NULL, 10); break;
+			case 'w': limits.window = atoi(optarg); break;
+			case 'm': limits.max_count = strtoul(optarg, NULL, 10); break;
+			case 'S': limits.samples = strtoul(optarg, NULL, 10); break;
+			case 'f': only = optarg; break;
+			case 'o': path = optarg; break;
+			default:
+				fprintf(stderr, "usage: %s [-s seed] [-n calls] [-k top_k] [-w window] [-m max_count] [-S samples] [-f function] [-o out.json]\n", argv[0]);
+				return(1);
+		}
+	}
+
+	FILE *out = path ? fopen(path, "w") : stdout;
+	if(!out){
+		fprintf(stderr, "ERROR: could not open %s\n", path);
+		return(1);
+	}
+
+	struct context ctx;
+	if(!initContext(VRNA_MODEL_DEFAULT_TEMPERATURE, &ctx)){
+		if(path) fclose(out);
+		return(1);
+	}
+	ctx.limits = limits;
+
+	fprintf(out, "{\n  \"seed\": %lu, \"calls\": %lu, \"temperature\": %.2f,\n", seed, calls, ctx.md.temperature);
+	fprintf(out, "  \"limits\": {\"top_k\": %u, \"window\": %d, \"max_count\": %u, \"samples\": %u},\n", limits.top_k, limits.window, limits.max_count, limits.samples);
+	fprintf(out, "  \"workloads\": [\n");
+
+	int error = 0, first = 1;
+	struct bench_result res;
+	for(unsigned int f = 0; f < NO_FUNCTIONS && !error; ++f){
+		if(only && strcmp(only, function_names[f])) continue;
+		for(unsigned int l = 0; l < NO_LENGTHS && !error; ++l){
+			const unsigned long int n = calls / lengths[l].divisor ? calls / lengths[l].divisor : 1;
+			if(!benchWorkload(f, lengths + l, n, seed + f * NO_LENGTHS + l, &ctx, &res)){
+				error = 1;
+				break;
+			}
+			if(!first) fprintf(out, ",\n");
+			printResult(out, f, lengths + l, &res, &ctx.hybrid);
+			fflush(out);
+			first = 0;
+		}
+	}
+
+	struct rusage usage;
+	fprintf(out, "\n  ],\n  \"peak_rss_kb\": %ld\n}\n", getrusage(RUSAGE_SELF, &usage) ? -1 : usage.ru_maxrss);
+
+	freeContext(&ctx);
+	if(path) fclose(out);
+	return(error);
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "bound.h"
+#include "energy.h"
+
+#define BOUND_INF (INT_MAX / 4)
+
+static inline int lower(const int a, const int b){
+	return( a < b ? a : b );
+}
+
+// exterior stem of type with the neighbours n5d and n3d (-1 if there is none), at its lowest over the dangles models
+static int stemBound(const int type, const int n5d, const int n3d, const vrna_param_t *P){
+	int e = extStemEnergy(type, -1, -1, P);
+	if(n5d >= 0) e = lower(e, extStemEnergy(type, n5d, -1, P));
+	if(n3d >= 0) e = lower(e, extStemEnergy(type, -1, n3d, P));
+	if(n5d >= 0 && n3d >= 0) e = lower(e, extStemEnergy(type, n5d, n3d, P));
+	return(e);
+}
+
+///  lower bounds of the loops of duplexes, once per set of energy parameters
+void initBound(const vrna_param_t *P, struct duplex_bound *b){
+	b->applicable = evalApplicable(&P->model_details);
+	b->loop[0] = BOUND_INF;
+	for(int type = 1; type <= NBPAIRS; ++type) b->loop[type] = interiorLoopBound(BOUND_SMALL_LOOP + 1, type, P);
+}
+
+///  lower bound of the MFE of two strands under the fn3 constraint
+/**
+ * A DP over the pairs (a,j) of rna1 x rna2, f(a,j) bounding the chains from the outer end down to (a,j): the chain starts at (a,j) with DuplexInit and its stem, or extends the chain of a pair at most BOUND_SMALL_LOOP bases outside of (a,j) on both sides by the exact interior loop, or of any pair further out by the lowest loop enclosing the type of (a,j). The bound is the lowest f plus the stem at the cut, O(length1 * length2).
+ *
+ * @param[in] rna1 First strand, length1 bases
+ * @param[in] rna2 Second strand, length2 bases
+ * @param[in] b Bounds of the energy parameters, b->applicable must be set
+ * @param[in] P Energy parameters of the context
+ * @param[in] tables Scratch memory of 2 * length1 * length2 ints
+ *
+ * @return The bound in dcal/mol, INT_MAX / 4 if no pair can form at all.
+ */
+int duplexBound(const char *rna1, const unsigned int length1, const char *rna2, const unsigned int length2, const struct duplex_bound *b, const vrna_param_t *P, int *tables){
+	const vrna_md_t *md = &P->model_details;
+	const unsigned int gap = BOUND_SMALL_LOOP + 1; // pairs this far out on one side close a larger loop
+	int *f = tables; // f[a*length2+j]
+	int *R = tables + (size_t) length1 * length2; // lowest f at or before row a, at or after column j
+
+	int best = BOUND_INF;
+	for(unsigned int a = 0; a < length1; ++a){
+		const int sa = encodeBase(rna1[a]);
+		for(unsigned int j = length2; j-- > 0;){
+			const int sb = encodeBase(rna2[j]);
+			const int type = md->pair[sa][sb];
+			int e = BOUND_INF;
+			if(type){
+				// neighbours of (a,j) in the strands, -1 past their ends
+				const int sa5 = a ? encodeBase(rna1[a-1]) : -1, sa3 = a+1 < length1 ? encodeBase(rna1[a+1]) : -1;
+				const int sb5 = j ? encodeBase(rna2[j-1]) : -1, sb3 = j+1 < length2 ? encodeBase(rna2[j+1]) : -1;
+				const int rtype = md->pair[sb][sa];
+				e = P->DuplexInit + stemBound(type, sa5, sb3, P);
+
+				// small loops
+				for(unsigned int o = a > gap ? a - gap : 0; o < a; ++o){
+					for(unsigned int p = j+1; p < length2 && p <= j + gap; ++p){
+						const int outer = f[o*length2+p];
+						if(outer >= BOUND_INF) continue;
+						const int type_o = md->pair[encodeBase(rna1[o])][encodeBase(rna2[p])];
+						e = lower(e, outer + interiorLoopEnergy(a-o-1, p-j-1, type_o, rtype,
+									encodeBase(rna1[o+1]), encodeBase(rna2[p-1]), sa5, sb3, P));
+					}
+				}
+
+				// larger loops
+				if(a > gap && j+1 < length2 && R[(a-gap-1)*length2+j+1] < BOUND_INF) e = lower(e, R[(a-gap-1)*length2+j+1] + b->loop[rtype]);
+				if(a && j+gap+1 < length2 && R[(a-1)*length2+j+gap+1] < BOUND_INF) e = lower(e, R[(a-1)*length2+j+gap+1] + b->loop[rtype]);
+
+				best = lower(best, e + stemBound(rtype, sb5, sa3, P));
+			}
+			f[a*length2+j] = e;
+			R[a*length2+j] = lower(e, lower(a ? R[(a-1)*length2+j] : BOUND_INF, j+1 < length2 ? R[a*length2+j+1] : BOUND_INF));
+		}
+	}
+	return(best);
+}
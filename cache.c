@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+
+static unsigned long int hashKey(const char *key){
+	// FNV-1a
+	unsigned long long int h = 0xcbf29ce484222325ULL;
+	for(; *key; ++key){
+		h ^= (unsigned char) *key;
+		h *= 0x100000001b3ULL;
+	}
+	return( (unsigned long int) h );
+}
+
+static vrna_subopt_solution_t* copySubopt(const vrna_subopt_solution_t *l){
+	unsigned int n = 0;
+	while(l[n].structure) ++n;
+
+	vrna_subopt_solution_t *copy = (vrna_subopt_solution_t*) calloc(n+1, sizeof(vrna_subopt_solution_t));
+	if(!copy) return(NULL);
+
+	for(unsigned int i = 0; i < n; ++i){
+		copy[i].energy = l[i].energy;
+		copy[i].structure = strdup(l[i].structure);
+		if(!copy[i].structure){
+			while(i--) free(copy[i].structure);
+			free(copy);
+			return(NULL);
+		}
+	}
+	copy[n].structure = NULL;
+
+	return(copy);
+}
+
+static vrna_subopt_solution_t* arenaSubopt(struct arena *a, const vrna_subopt_solution_t *l){
+	unsigned int n = 0;
+	while(l[n].structure) ++n;
+
+	vrna_subopt_solution_t *copy = (vrna_subopt_solution_t*) arenaAlloc(a, (n+1) * sizeof(vrna_subopt_solution_t));
+	if(!copy) return(NULL);
+
+	for(unsigned int i = 0; i < n; ++i){
+		copy[i].energy = l[i].energy;
+		copy[i].structure = arenaStrdup(a, l[i].structure);
+		if(!copy[i].structure) return(NULL);
+	}
+	copy[n].energy = 0.0;
+	copy[n].structure = NULL;
+
+	return(copy);
+}
+
+static void freeEntry(struct cache_entry *e){
+	if(e->subopts){
+		for(unsigned int i = 0; e->subopts[i].structure; ++i) free(e->subopts[i].structure);
+		free(e->subopts);
+	}
+	free(e->structure);
+	free(e->key);
+	free(e);
+}
+
+///  init a sharded cache of folding results
+/**
+ * Results of fn2, fn3, connect3 and monomer folds are kept up to a memory budget. Every shard has its own lock and least recently used list, so threads hitting different shards do not wait for each other. Free it with freeCache.
+ *
+ * @param[in] budget Maximal memory used by the cached results in bytes, split evenly among the shards
+ * @param[in] no_shards Number of independently locked shards
+ * @param[out] c The cache to init
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int initCache(const size_t budget, const unsigned int no_shards, struct cache *c){
+	c->no_shards = no_shards ? no_shards : 1;
+	c->shards = (struct cache_shard*) calloc(c->no_shards, sizeof(struct cache_shard));
+	if(!c->shards){
+		fprintf(stderr, "ERROR: initCache: could not allocate %d shards!\n", c->no_shards);
+		return(0);
+	}
+
+	for(unsigned int s = 0; s < c->no_shards; ++s){
+		struct cache_shard *shard = c->shards + s;
+		shard->no_buckets = 64;
+		shard->buckets = (struct cache_entry**) calloc(shard->no_buckets, sizeof(struct cache_entry*));
+		if(!shard->buckets){
+			fprintf(stderr, "ERROR: initCache: could not allocate buckets!\n");
+			while(s--) free(c->shards[s].buckets);
+			free(c->shards);
+			return(0);
+		}
+		shard->budget = budget / c->no_shards;
+		pthread_mutex_init(&shard->lock, NULL);
+	}
+
+	return(1);
+}
+
+void freeCache(struct cache *c){
+	for(unsigned int s = 0; s < c->no_shards; ++s){
+		struct cache_shard *shard = c->shards + s;
+		while(shard->newest){
+			struct cache_entry *older = shard->newest->older;
+			freeEntry(shard->newest);
+			shard->newest = older;
+		}
+		free(shard->buckets);
+		pthread_mutex_destroy(&shard->lock);
+	}
+	free(c->shards);
+	c->shards = NULL;
+	c->no_shards = 0;
+}
+
+// lru list helpers, the shard has to be locked
+static void unlinkLRU(struct cache_shard *shard, struct cache_entry *e){
+	if(e->newer) e->newer->older = e->older;
+	else shard->newest = e->older;
+	if(e->older) e->older->newer = e->newer;
+	else shard->oldest = e->newer;
+	e->newer = e->older = NULL;
+}
+
+static void pushLRU(struct cache_shard *shard, struct cache_entry *e){
+	e->newer = NULL;
+	e->older = shard->newest;
+	if(shard->newest) shard->newest->newer = e;
+	shard->newest = e;
+	if(!shard->oldest) shard->oldest = e;
+}
+
+static void removeEntry(struct cache_shard *shard, struct cache_entry *e){
+	struct cache_entry **p = shard->buckets + (e->hash >> 8) % shard->no_buckets;
+	while(*p != e) p = &(*p)->next;
+	*p = e->next;
+
+	unlinkLRU(shard, e);
+	shard->used -= e->size;
+	--shard->count;
+	freeEntry(e);
+}
+
+static void growBuckets(struct cache_shard *shard){
+	const unsigned int no_buckets = shard->no_buckets * 2;
+	struct cache_entry **buckets = (struct cache_entry**) calloc(no_buckets, sizeof(struct cache_entry*));
+	if(!buckets) return; // keep the longer chains
+
+	for(unsigned int b = 0; b < shard->no_buckets; ++b){
+		struct cache_entry *e = shard->buckets[b];
+		while(e){
+			struct cache_entry *next = e->next;
+			struct cache_entry **head = buckets + (e->hash >> 8) % no_buckets;
+			e->next = *head;
+			*head = e;
+			e = next;
+		}
+	}
+
+	free(shard->buckets);
+	shard->buckets = buckets;
+	shard->no_buckets = no_buckets;
+}
+
+///  look up a result
+/**
+ * @param[in] c The cache
+ * @param[in] key Key made by cacheKey
+ * @param[in] a Arena the copies are allocated in
+ * @param[out] mfe MFE of the result. If NULL no output will be written.
+ * @param[out] structure Copy of the stored structure (or NULL if none was stored). If NULL no output will be written.
+ * @param[out] subopts Copy of the stored suboptimal list (or NULL if none was stored). If NULL no output will be written.
+ *
+ * @return 1 on hit, 0 on miss.
+ */
+int cacheGet(struct cache *c, const char *key, struct arena *a, float *mfe, char **structure, vrna_subopt_solution_t **subopts){
+	const unsigned long int hash = hashKey(key);
+	struct cache_shard *shard = c->shards + hash % c->no_shards;
+
+	pthread_mutex_lock(&shard->lock);
+
+	struct cache_entry *e = shard->buckets[(hash >> 8) % shard->no_buckets];
+	while(e && (e->hash != hash || strcmp(e->key, key))) e = e->next;
+
+	if(!e){
+		++shard->misses;
+		pthread_mutex_unlock(&shard->lock);
+		return(0);
+	}
+
+	// copy out under the lock, the entry may be evicted afterwards
+	if(structure) *structure = e->structure ? arenaStrdup(a, e->structure) : NULL;
+	if(subopts) *subopts = e->subopts ? arenaSubopt(a, e->subopts) : NULL;
+	if(mfe) *mfe = e->mfe;
+
+	// a failed copy counts as a miss, the caller will recompute
+	if((structure && e->structure && !*structure) || (subopts && e->subopts && !*subopts)){
+		++shard->misses;
+		pthread_mutex_unlock(&shard->lock);
+		return(0);
+	}
+
+	unlinkLRU(shard, e);
+	pushLRU(shard, e);
+	++shard->hits;
+
+	pthread_mutex_unlock(&shard->lock);
+	return(1);
+}
+
+///  store a result
+/**
+ * The result is copied. Least recently used entries of the shard are evicted until it fits in the budget. Results larger than the budget of a shard are not stored.
+ *
+ * @param[in] c The cache
+ * @param[in] key Key made by cacheKey
+ * @param[in] mfe MFE of the result
+ * @param[in] structure Structure of the result, can be NULL
+ * @param[in] subopts Suboptimal list of the result, can be NULL
+ */
+void cachePut(struct cache *c, const char *key, const float mfe, const char *structure, const vrna_subopt_solution_t *subopts){
+	const unsigned long int hash = hashKey(key);
+	struct cache_shard *shard = c->shards + hash % c->no_shards;
+
+	// build entry outside of the lock
+	struct cache_entry *e = (struct cache_entry*) calloc(1, sizeof(struct cache_entry));
+	if(!e) return;
+	e->hash = hash;
+	e->mfe = mfe;
+	e->key = strdup(key);
+	e->structure = structure ? strdup(structure) : NULL;
+	e->subopts = subopts ? copySubopt(subopts) : NULL;
+	if(!e->key || (structure && !e->structure) || (subopts && !e->subopts)){
+		freeEntry(e);
+		return;
+	}
+
+	e->size = sizeof(struct cache_entry) + strlen(e->key) + 1;
+	if(e->structure) e->size += strlen(e->structure) + 1;
+	if(e->subopts){
+		unsigned int i = 0;
+		for(; e->subopts[i].structure; ++i) e->size += strlen(e->subopts[i].structure) + 1;
+		e->size += (i+1) * sizeof(vrna_subopt_solution_t);
+	}
+
+	if(e->size > shard->budget){
+		freeEntry(e);
+		return;
+	}
+
+	pthread_mutex_lock(&shard->lock);
+
+	// another thread may have stored it meanwhile
+	struct cache_entry **head = shard->buckets + (hash >> 8) % shard->no_buckets;
+	for(struct cache_entry *o = *head; o; o = o->next){
+		if(o->hash == hash && !strcmp(o->key, key)){
+			pthread_mutex_unlock(&shard->lock);
+			freeEntry(e);
+			return;
+		}
+	}
+
+	// make space
+	while(shard->oldest && shard->used + e->size > shard->budget){
+		removeEntry(shard, shard->oldest);
+		++shard->evictions;
+	}
+
+	if(shard->count >= 2 * shard->no_buckets) growBuckets(shard);
+	head = shard->buckets + (hash >> 8) % shard->no_buckets;
+	e->next = *head;
+	*head = e;
+	pushLRU(shard, e);
+	shard->used += e->size;
+	++shard->count;
+
+	pthread_mutex_unlock(&shard->lock);
+}
+
+///  size of the buffer cacheKey needs for a complex of a given length
+size_t cacheKeyLength(const unsigned int length){
+	return( 2 * ((size_t) length + 1) + 64 );
+}
+
+///  make the key of a result
+/**
+ * @param[out] buf Buffer of at least cacheKeyLength(strlen(seq)) chars
+ * @param[in] kind Kind of the computation ('M' monomer, 'B' fn2, 'D' fn3, 'T' connect3, ...)
+ * @param[in] temperature Temperature of the computation
+ * @param[in] seq Sequence of the complex, strands separated by '&'
+ * @param[in] constraint Constraint of the computation, can be NULL
+ *
+ * @return buf
+ */
+char* cacheKey(char *buf, const char kind, const double temperature, const char *seq, const char *constraint){
+	sprintf(buf, "%c%.4f:%s:%s", kind, temperature, seq, constraint ? constraint : "");
+	return(buf);
+}
+
+void getCacheStats(struct cache *c, struct cache_stats *stats){
+	memset(stats, 0, sizeof(struct cache_stats));
+	for(unsigned int s = 0; s < c->no_shards; ++s){
+		struct cache_shard *shard = c->shards + s;
+		pthread_mutex_lock(&shard->lock);
+		stats->hits += shard->hits;
+		stats->misses += shard->misses;
+		stats->evictions += shard->evictions;
+		stats->entries += shard->count;
+		stats->used += shard->used;
+		stats->budget += shard->budget;
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+void printCacheStats(struct cache *c, FILE *out){
+	struct cache_stats stats;
+	getCacheStats(c, &stats);
+	const unsigned long int lookups = stats.hits + stats.misses;
+	fprintf(out, "cache: %lu hits, %lu misses (hit rate %.3f), %lu evictions, %lu entries, %zu/%zu bytes\n",
+			stats.hits, stats.misses, lookups ? (double) stats.hits / lookups : 0.0,
+			stats.evictions, stats.entries, stats.used, stats.budget);
+}
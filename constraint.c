@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ViennaRNA/constraints/hard.h>
+#include "constraint.h"
+#include "interaction.h"
+
+///  init an empty compiled constraint, its buffers grow on demand and are reused by every compile
+void initCompiled(struct compiled_constraint *c){
+	memset(c, 0, sizeof(struct compiled_constraint));
+}
+
+void freeCompiled(struct compiled_constraint *c){
+	free(c->ops);
+	free(c->scratch);
+	initCompiled(c);
+}
+
+// room for the ops and scratch of length bases
+static int reserveCompiled(struct compiled_constraint *c, const unsigned int length){
+	if(c->size < length){
+		struct hc_op *ops = (struct hc_op*) realloc(c->ops, length * sizeof(struct hc_op));
+		if(!ops) return(0);
+		c->ops = ops;
+		c->size = length;
+	}
+	if(c->scratch_size < length+1){
+		unsigned int *scratch = (unsigned int*) realloc(c->scratch, (length+1) * sizeof(unsigned int));
+		if(!scratch) return(0);
+		c->scratch = scratch;
+		c->scratch_size = length+1;
+	}
+	return(1);
+}
+
+// state of a compile: the bracket stack lives in c->scratch
+struct compiler{
+	struct compiled_constraint *c;
+	unsigned int options;
+	unsigned int pos; // bases so far
+	unsigned int depth; // of the bracket stack
+};
+
+static int startCompile(struct compiler *k, const unsigned int length, const unsigned int options, struct compiled_constraint *c){
+	if(!reserveCompiled(c, length)){
+		fprintf(stderr, "ERROR: startCompile: could not allocate constraint of %u bases\n", length);
+		return(0);
+	}
+	c->no_ops = 0;
+	c->length = length;
+	c->no_strands = 1;
+	c->strand_start[0] = 1;
+	c->pair_context = VRNA_CONSTRAINT_CONTEXT_ALL_LOOPS | ((options & VRNA_CONSTRAINT_DB_ENFORCE_BP) ? VRNA_CONSTRAINT_CONTEXT_ENFORCE : 0);
+	k->c = c;
+	k->options = options;
+	k->pos = 0;
+	k->depth = 0;
+	return(1);
+}
+
+///  one symbol of a dot-bracket constraint, read the way vrna_constraints_add reads it with the same options
+static int addSymbol(struct compiler *k, const char symbol){
+	struct compiled_constraint *c = k->c;
+	if(symbol == '&'){
+		if(c->no_strands == CONSTRAINT_MAX_STRANDS) return(0);
+		c->strand_start[c->no_strands++] = k->pos + 1;
+		return(1);
+	}
+
+	const unsigned int i = ++k->pos;
+	if(i > c->length) return(0);
+	switch(symbol){
+		case '.': break;
+		case 'x':
+			if(k->options & VRNA_CONSTRAINT_DB_X) c->ops[c->no_ops++] = (struct hc_op) {i, 0, HC_UNPAIRED};
+			break;
+		case 'e':
+			if(k->options & VRNA_CONSTRAINT_DB_INTERMOL) c->ops[c->no_ops++] = (struct hc_op) {i, 0, HC_INTERMOL};
+			break;
+		case '(':
+			if(k->options & VRNA_CONSTRAINT_DB_RND_BRACK) c->scratch[k->depth++] = i;
+			break;
+		case ')':
+			if(k->options & VRNA_CONSTRAINT_DB_RND_BRACK){
+				if(!k->depth) return(0);
+				c->ops[c->no_ops++] = (struct hc_op) {c->scratch[--k->depth], i, HC_PAIR};
+			}
+			break;
+		default:
+			return(0); // not used by the functions of this library
+	}
+	return(1);
+}
+
+static int endCompile(struct compiler *k){
+	k->c->strand_start[k->c->no_strands] = k->c->length + 1;
+	return( k->pos == k->c->length && !k->depth );
+}
+
+///  compile a dot-bracket constraint
+/**
+ * This is the reference the structured builders (compileFn2, compileFn3, compileConnect3, compileFn4) are checked against: compiling the string made by fn2Constraint etc. gives the same ops.
+ *
+ * @param[in] constraint Dot-bracket constraint with '&' separators, of '.', 'x', 'e', '(' and ')'
+ * @param[in] options Options it would be added with by vrna_constraints_add (e.g. FN2_CONSTRAINT)
+ * @param[out] c The compiled constraint
+ *
+ * @return 1 on success, 0 if the constraint has other symbols or unbalanced brackets.
+ */
+int compileConstraint(const char *constraint, const unsigned int options, struct compiled_constraint *c){
+	unsigned int length = 0;
+	for(const char *s = constraint; *s; ++s) if(*s != '&') ++length;
+
+	struct compiler k;
+	if(!startCompile(&k, length, options, c)) return(0);
+	for(const char *s = constraint; *s; ++s){
+		if(!addSymbol(&k, *s)) return(0);
+	}
+	return( endCompile(&k) );
+}
+
+// a strand of fn2 or connect3: unpaired bases of the sticky spans are 'e', other unpaired ones 'x', pairs stay
+static int addStrand(struct compiler *k, const char *str, const unsigned int length, const unsigned int sticky_head, const unsigned int sticky_tail){
+	for(unsigned int i = 0; i < length; ++i){
+		char symbol = str[i];
+		if(symbol == '.') symbol = (i < sticky_head || i >= length - sticky_tail) ? 'e' : 'x';
+		if(!addSymbol(k, symbol)) return(0);
+	}
+	return(1);
+}
+
+// unpaired bases at the 5' and 3' end of a strand
+static unsigned int headSpan(const char *str, const unsigned int length){
+	unsigned int i = 0;
+	while(i < length && str[i] == '.') ++i;
+	return(i);
+}
+
+static unsigned int tailSpan(const char *str, const unsigned int length){
+	unsigned int i = 0;
+	while(i < length && str[length-1-i] == '.') ++i;
+	return(i);
+}
+
+///  constraint of fn2 without the dot-bracket string, same as compiling fn2Constraint with FN2_CONSTRAINT
+int compileFn2(const char *left_str, const unsigned int left_length, const char *right_str, const unsigned int right_length, struct compiled_constraint *c){
+	struct compiler k;
+	if(!startCompile(&k, left_length + right_length, FN2_CONSTRAINT, c)) return(0);
+
+	// the 3' dangling end of the left strand and the 5' dangling end of the right one are sticky
+	const int ok = addStrand(&k, left_str, left_length, 0, tailSpan(left_str, left_length))
+		&& addSymbol(&k, '&')
+		&& addStrand(&k, right_str, right_length, headSpan(right_str, right_length), 0);
+	return( ok && endCompile(&k) );
+}
+
+///  constraint of fn3 without the dot-bracket string: every base is sticky
+int compileFn3(const unsigned int length1, const unsigned int length2, struct compiled_constraint *c){
+	struct compiler k;
+	if(!startCompile(&k, length1 + length2, FN3_CONSTRAINT, c)) return(0);
+	for(unsigned int i = 0; i < length1; ++i) addSymbol(&k, 'e');
+	addSymbol(&k, '&');
+	for(unsigned int i = 0; i < length2; ++i) addSymbol(&k, 'e');
+	return( endCompile(&k) );
+}
+
+///  constraint of connect3 without the dot-bracket string, same as compiling connect3Constraint with CONNECT3_CONSTRAINT
+/**
+ * Both strands of the duplex get sticky dangling ends at both sides (see makeStickyEnds), the single strand is sticky everywhere.
+ */
+int compileConnect3(const char *duplex_str, const unsigned int duplex1_length, const unsigned int single_length, struct compiled_constraint *c){
+	const unsigned int duplex_length = strlen(duplex_str);
+	if(duplex1_length >= duplex_length || duplex_str[duplex1_length] != '&') return(0);
+	const char *str2 = duplex_str + duplex1_length + 1;
+	const unsigned int duplex2_length = duplex_length - duplex1_length - 1;
+
+	struct compiler k;
+	if(!startCompile(&k, duplex_length - 1 + single_length, CONNECT3_CONSTRAINT, c)) return(0);
+
+	// an unpaired strand is sticky all along, like makeStickyEnds makes it
+	const unsigned int head1 = headSpan(duplex_str, duplex1_length), head2 = headSpan(str2, duplex2_length);
+	int ok = addStrand(&k, duplex_str, duplex1_length, head1, head1 == duplex1_length ? 0 : tailSpan(duplex_str, duplex1_length))
+		&& addSymbol(&k, '&')
+		&& addStrand(&k, str2, duplex2_length, head2, head2 == duplex2_length ? 0 : tailSpan(str2, duplex2_length))
+		&& addSymbol(&k, '&');
+	for(unsigned int i = 0; ok && i < single_length; ++i) ok = addSymbol(&k, 'e');
+	return( ok && endCompile(&k) );
+}
+
+///  constraint of fn4 without the dot-bracket string, same as compiling fn4Constraint with FN4_CONSTRAINT
+int compileFn4(const char *str, struct compiled_constraint *c){
+	unsigned int length = 0;
+	for(const char *s = str; *s; ++s) if(*s != '&') ++length;
+
+	struct compiler k;
+	if(!startCompile(&k, length, FN4_CONSTRAINT, c)) return(0);
+	for(const char *s = str; *s; ++s){
+		if(!addSymbol(&k, *s == '.' ? 'x' : *s)) return(0);
+	}
+	return( endCompile(&k) );
+}
+
+///  add a compiled constraint to a fold compound, through the hard constraint API
+/**
+ * Gives the same hard constraints as vrna_constraints_add with the dot-bracket string and options the constraint was compiled from, without building or parsing the string. Can be applied to any number of fold compounds of the same strand lengths.
+ *
+ * @param[in] fc Fold compound of the sequence, with the strands the constraint was compiled for
+ * @param[in] c The compiled constraint
+ *
+ * @return 1 on success, 0 if the strands do not match.
+ */
+int applyConstraint(vrna_fold_compound_t *fc, struct compiled_constraint *c){
+	if(fc->length != c->length) return(0);
+
+	unsigned int *intermol = c->scratch;
+	memset(intermol, 0, (c->length+1) * sizeof(unsigned int));
+	for(unsigned int o = 0; o < c->no_ops; ++o){
+		const struct hc_op *op = c->ops + o;
+		switch(op->kind){
+			case HC_UNPAIRED: vrna_hc_add_up(fc, op->i, VRNA_CONSTRAINT_CONTEXT_ALL_LOOPS); break;
+			case HC_PAIR: vrna_hc_add_bp(fc, op->i, op->j, c->pair_context); break;
+			case HC_INTERMOL: intermol[op->i] = 1; break;
+		}
+	}
+
+	// an intermolecular only base loses every pair within its strand, a pair of two of them is forbidden once
+	for(unsigned int s = 0; s < c->no_strands; ++s){
+		for(unsigned int i = c->strand_start[s]; i < c->strand_start[s+1]; ++i){
+			if(!intermol[i]) continue;
+			for(unsigned int l = c->strand_start[s]; l < c->strand_start[s+1]; ++l){
+				if(l == i || (intermol[l] && l < i)) continue;
+				vrna_hc_add_bp(fc, l < i ? l : i, l < i ? i : l, VRNA_CONSTRAINT_CONTEXT_NONE | VRNA_CONSTRAINT_CONTEXT_NO_REMOVE);
+			}
+		}
+	}
+	return(1);
+}
+
+// position where the parser emits an op: pairs at their closing base
+static unsigned int emitPosition(const struct hc_op *op){
+	return( op->kind == HC_PAIR ? op->j : op->i );
+}
+
+static int compareOps(const void *a, const void *b){
+	const unsigned int x = emitPosition((const struct hc_op*) a), y = emitPosition((const struct hc_op*) b);
+	return( (x > y) - (x < y) );
+}
+
+///  the same constraint with its strands in another order
+/**
+ * Gives the ops the strands would get if the constraint was compiled in the new order, without recompiling (e.g. the duplex of connect3 with its members swapped).
+ *
+ * @param[in] src The compiled constraint
+ * @param[in] order order[k] is the strand of src that becomes strand k
+ * @param[out] dst The permuted constraint, must not be src
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int permuteStrands(const struct compiled_constraint *src, const unsigned int *order, struct compiled_constraint *dst){
+	if(!reserveCompiled(dst, src->length ? src->length : 1)){
+		fprintf(stderr, "ERROR: permuteStrands: could not allocate constraint of %u bases\n", src->length);
+		return(0);
+	}
+
+	// shift of every strand of src
+	int shift[CONSTRAINT_MAX_STRANDS];
+	unsigned int start = 1;
+	for(unsigned int k = 0; k < src->no_strands; ++k){
+		const unsigned int s = order[k];
+		if(s >= src->no_strands) return(0);
+		dst->strand_start[k] = start;
+		shift[s] = (int) start - (int) src->strand_start[s];
+		start += src->strand_start[s+1] - src->strand_start[s];
+	}
+	dst->strand_start[src->no_strands] = start;
+	dst->no_strands = src->no_strands;
+	dst->length = src->length;
+	dst->pair_context = src->pair_context;
+
+	for(unsigned int o = 0; o < src->no_ops; ++o){
+		struct hc_op op = src->ops[o];
+		unsigned int s = 0;
+		while(op.i >= src->strand_start[s+1]) ++s;
+		op.i += shift[s];
+		if(op.kind == HC_PAIR){
+			for(s = 0; op.j >= src->strand_start[s+1]; ++s);
+			op.j += shift[s];
+			if(op.i > op.j){
+				const unsigned int i = op.i;
+				op.i = op.j;
+				op.j = i;
+			}
+		}
+		dst->ops[o] = op;
+	}
+	dst->no_ops = src->no_ops;
+
+	// in the order the parser would give them
+	qsort(dst->ops, dst->no_ops, sizeof(struct hc_op), compareOps);
+	return(1);
+}
+
+///  1 if two compiled constraints give the same hard constraints
+int equalCompiled(const struct compiled_constraint *a, const struct compiled_constraint *b){
+	if(a->length != b->length || a->no_ops != b->no_ops || a->no_strands != b->no_strands || a->pair_context != b->pair_context) return(0);
+	if(memcmp(a->strand_start, b->strand_start, (a->no_strands+1) * sizeof(unsigned int))) return(0);
+	for(unsigned int o = 0; o < a->no_ops; ++o){
+		if(a->ops[o].kind != b->ops[o].kind || a->ops[o].i != b->ops[o].i || a->ops[o].j != b->ops[o].j) return(0);
+	}
+	return(1);
+}
@@ -0,0 +1,637 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <ViennaRNA/fold.h>
+#include "interaction.h"
+#include "endindex.h"
+
+// code of a base as in packSeq, 4 if it is none of ACGU
+static int baseCode(const char c){
+	switch(c){
+		case 'A': case 'a': return(0);
+		case 'C': case 'c': return(1);
+		case 'G': case 'g': return(2);
+		case 'U': case 'u': case 'T': case 't': return(3);
+		default: return(4);
+	}
+}
+
+static int compareKeys(const void *a, const void *b){
+	const uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+	return( (x > y) - (x < y) );
+}
+
+// room for count more keys
+static int growKeys(uint64_t **keys, size_t *size, const size_t count){
+	if(count <= *size) return(1);
+	size_t s = *size ? *size : 256;
+	while(s < count) s *= 2;
+	uint64_t *k = (uint64_t*) realloc(*keys, s * sizeof(uint64_t));
+	if(!k) return(0);
+	*keys = k;
+	*size = s;
+	return(1);
+}
+
+///  runs of unpaired bases at the 5' and 3' end of a structure, the sticky ends of a strand
+static void stickyEnds(const char *str, const unsigned int length, unsigned int *head, unsigned int *tail){
+	for(*head = 0; *head < length && str[*head] == '.'; ++*head);
+	for(*tail = 0; *tail < length && str[length-1-*tail] == '.'; ++*tail);
+}
+
+// append the keys every k-mer of a segment pairs with, key << 2 | segments
+static int segmentKeys(const char *seg, const unsigned int length, const unsigned int k, const int wobble, const unsigned int segments, uint64_t **keys, size_t *size, size_t *count){
+	// partners of a base in the key, antiparallel: base k-1-d of the window pairs with digit d of the key
+	static const int partners[4][2] = {{3, -1}, {2, -1}, {1, 3}, {0, 2}};
+	for(unsigned int w = 0; w + k <= length; ++w){
+		size_t first = *count, last = first + 1;
+		if(!growKeys(keys, size, last)) return(0);
+		(*keys)[first] = 0;
+		int ok = 1;
+		for(unsigned int d = 0; d < k && ok; ++d){
+			const int b = baseCode(seg[w+k-1-d]);
+			if(b > 3){
+				ok = 0;
+				break;
+			}
+			const int alternatives = wobble && partners[b][1] >= 0 ? 2 : 1;
+			if(!growKeys(keys, size, first + (last-first) * alternatives)) return(0);
+			uint64_t *x = *keys;
+			if(alternatives == 2){
+				for(size_t i = first; i < last; ++i) x[last + i - first] = (x[i] << 2) | partners[b][1];
+			}
+			for(size_t i = first; i < last; ++i) x[i] = (x[i] << 2) | partners[b][0];
+			last = first + (last-first) * alternatives;
+		}
+		if(!ok) continue; // the window has other characters
+		for(size_t i = first; i < last; ++i) (*keys)[i] = ((*keys)[i] << 2) | segments;
+		*count = last;
+	}
+	return(1);
+}
+
+// sorted keys of a strand, each once with the union of its segments
+static int strandKeys(const char *seq, const char *str, const unsigned int length, const unsigned int k, const unsigned int flags, uint64_t **keys, size_t *size, size_t *count){
+	const int wobble = (flags & ENDINDEX_WOBBLE) != 0;
+	*count = 0;
+	if(flags & ENDINDEX_WHOLE){
+		if(!segmentKeys(seq, length, k, wobble, ENDINDEX_HEAD | ENDINDEX_TAIL, keys, size, count)) return(0);
+	} else{
+		unsigned int head, tail;
+		stickyEnds(str, length, &head, &tail);
+		if(!segmentKeys(seq, head, k, wobble, ENDINDEX_HEAD, keys, size, count)
+				|| !segmentKeys(seq + length - tail, tail, k, wobble, ENDINDEX_TAIL, keys, size, count)) return(0);
+	}
+
+	qsort(*keys, *count, sizeof(uint64_t), compareKeys);
+	size_t n = 0;
+	for(size_t i = 0; i < *count; ++i){
+		if(n && ((*keys)[n-1] >> 2) == ((*keys)[i] >> 2)) (*keys)[n-1] |= (*keys)[i] & 3;
+		else (*keys)[n++] = (*keys)[i];
+	}
+	*count = n;
+	return(1);
+}
+
+///  build the sticky end index of a library
+/**
+ * Two passes over the strands: the first counts the postings of every key, the second fills them in, so the postings of a key are ordered by strand. The header is written last, so an index is only valid when complete.
+ *
+ * @param[in] p Library, already folded with foldPool
+ * @param[in] k Length of the k-mers, at most ENDINDEX_MAX_K
+ * @param[in] flags ENDINDEX_WHOLE and ENDINDEX_WOBBLE
+ * @param[in] temperature Of the monomer folds, queries fold at the same temperature
+ * @param[in] path Path of the index
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int buildEndIndex(const struct pool *p, const unsigned int k, const unsigned int flags, const double temperature, const char *path){
+	if(!k || k > ENDINDEX_MAX_K){
+		fprintf(stderr, "ERROR: buildEndIndex: k has to be within 1 and %u\n", ENDINDEX_MAX_K);
+		return(0);
+	}
+	const uint64_t no_keys = 1ULL << (2*k);
+	uint64_t *buckets = (uint64_t*) calloc(no_keys + 1, sizeof(uint64_t));
+	uint64_t *cursor = (uint64_t*) malloc(no_keys * sizeof(uint64_t));
+	uint64_t *keys = NULL;
+	size_t size = 0, count;
+	struct endindex_posting *postings = NULL;
+	int error = !buckets || !cursor;
+
+	// count, then fill
+	for(unsigned int i = 0; i < p->n && !error; ++i){
+		error = !strandKeys(p->seqs[i], p->strs[i], p->length[i], k, flags, &keys, &size, &count);
+		for(size_t j = 0; j < count && !error; ++j) ++buckets[(keys[j] >> 2) + 1];
+	}
+	if(!error){
+		for(uint64_t x = 0; x < no_keys; ++x) buckets[x+1] += buckets[x];
+		memcpy(cursor, buckets, no_keys * sizeof(uint64_t));
+		postings = (struct endindex_posting*) malloc((buckets[no_keys] ? buckets[no_keys] : 1) * sizeof(struct endindex_posting));
+		error = !postings;
+	}
+	for(unsigned int i = 0; i < p->n && !error; ++i){
+		error = !strandKeys(p->seqs[i], p->strs[i], p->length[i], k, flags, &keys, &size, &count);
+		for(size_t j = 0; j < count && !error; ++j){
+			struct endindex_posting *x = postings + cursor[keys[j] >> 2]++;
+			x->entry = i;
+			x->segments = keys[j] & 3;
+		}
+	}
+	free(keys);
+	free(cursor);
+	if(error){
+		fprintf(stderr, "ERROR: buildEndIndex: could not allocate the postings\n");
+		free(buckets);
+		free(postings);
+		return(0);
+	}
+
+	struct endindex_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ENDINDEX_MAGIC, 8);
+	header.k = k;
+	header.flags = flags;
+	header.temperature = temperature;
+	header.no_entries = p->n;
+	header.no_postings = buckets[no_keys];
+	header.buckets = (sizeof(header) + 7) & ~7ULL;
+	header.postings = header.buckets + (no_keys + 1) * sizeof(uint64_t);
+	header.entries = header.postings + header.no_postings * sizeof(struct endindex_posting);
+	header.strings = header.entries + header.no_entries * sizeof(struct endindex_entry);
+
+	FILE *out = fopen(path, "wb");
+	if(!out){
+		fprintf(stderr, "ERROR: buildEndIndex: could not open %s\n", path);
+		free(buckets);
+		free(postings);
+		return(0);
+	}
+	struct endindex_header blank;
+	memset(&blank, 0, sizeof(blank));
+	error = fwrite(&blank, sizeof(blank), 1, out) != 1
+		|| fseeko(out, header.buckets, SEEK_SET)
+		|| fwrite(buckets, sizeof(uint64_t), no_keys + 1, out) != no_keys + 1
+		|| fwrite(postings, sizeof(struct endindex_posting), header.no_postings, out) != header.no_postings;
+
+	// the strands, sequence and structure one after the other
+	uint64_t offset = 0;
+	for(unsigned int i = 0; i < p->n && !error; ++i){
+		const struct endindex_entry e = {offset, (float) p->mfe[i], p->length[i]};
+		error = fwrite(&e, sizeof(e), 1, out) != 1;
+		offset += 2 * ((uint64_t) p->length[i] + 1);
+	}
+	for(unsigned int i = 0; i < p->n && !error; ++i){
+		error = fwrite(p->seqs[i], 1, p->length[i] + 1, out) != p->length[i] + 1
+			|| fwrite(p->strs[i], 1, p->length[i] + 1, out) != p->length[i] + 1;
+	}
+	header.size = offset;
+
+	// header last
+	error = error || fflush(out) || fsync(fileno(out)) || fseeko(out, 0, SEEK_SET)
+		|| fwrite(&header, sizeof(header), 1, out) != 1;
+	if(fclose(out)) error = 1;
+	if(error) fprintf(stderr, "ERROR: buildEndIndex: could not write %s\n", path);
+
+	free(buckets);
+	free(postings);
+	return(!error);
+}
+
+///  map a sticky end index into memory
+/**
+ * The index is mapped read-only and shared, so query processes on the same node use the same page cache. Free it with closeEndIndex.
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int openEndIndex(const char *path, struct endindex *x){
+	const int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		fprintf(stderr, "ERROR: openEndIndex: could not open %s\n", path);
+		return(0);
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) || (size_t) st.st_size < sizeof(struct endindex_header)){
+		fprintf(stderr, "ERROR: openEndIndex: %s is not a sticky end index\n", path);
+		close(fd);
+		return(0);
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		fprintf(stderr, "ERROR: openEndIndex: could not map %s\n", path);
+		return(0);
+	}
+
+	const struct endindex_header *h = (const struct endindex_header*) map;
+	const char *base = (const char*) map;
+	const int valid = !memcmp(h->magic, ENDINDEX_MAGIC, 8) && h->k && h->k <= ENDINDEX_MAX_K
+		&& h->postings == h->buckets + ((1ULL << (2*h->k)) + 1) * sizeof(uint64_t)
+		&& h->entries == h->postings + h->no_postings * sizeof(struct endindex_posting)
+		&& h->strings == h->entries + h->no_entries * sizeof(struct endindex_entry)
+		&& h->strings + h->size <= (uint64_t) st.st_size
+		&& ((const uint64_t*) (base + h->buckets))[1ULL << (2*h->k)] == h->no_postings;
+	if(!valid){
+		fprintf(stderr, "ERROR: openEndIndex: %s is not a valid sticky end index\n", path);
+		munmap(map, st.st_size);
+		return(0);
+	}
+
+	x->header = h;
+	x->buckets = (const uint64_t*) (base + h->buckets);
+	x->postings = (const struct endindex_posting*) (base + h->postings);
+	x->entries = (const struct endindex_entry*) (base + h->entries);
+	x->strings = base + h->strings;
+	x->size = st.st_size;
+	return(1);
+}
+
+void closeEndIndex(struct endindex *x){
+	if(x->header) munmap((void*) x->header, x->size);
+	memset(x, 0, sizeof(struct endindex));
+}
+
+const char* entrySeq(const struct endindex *x, const uint32_t entry){
+	return( x->strings + x->entries[entry].seq );
+}
+
+const char* entryStructure(const struct endindex *x, const uint32_t entry){
+	return( x->strings + x->entries[entry].seq + x->entries[entry].length + 1 );
+}
+
+// queries
+
+int initEndQuery(const struct endindex *x, struct endindex_query *q){
+	memset(q, 0, sizeof(struct endindex_query));
+	const size_t slots = 2 * (size_t) x->header->no_entries;
+	q->hits = (uint16_t*) calloc(slots ? slots : 1, sizeof(uint16_t));
+	q->touched = (uint32_t*) malloc((slots ? slots : 1) * sizeof(uint32_t));
+	if(!q->hits || !q->touched){
+		fprintf(stderr, "ERROR: initEndQuery: could not allocate the counts of %lu strands\n", (unsigned long) x->header->no_entries);
+		freeEndQuery(q);
+		return(0);
+	}
+	return(1);
+}
+
+void freeEndQuery(struct endindex_query *q){
+	free(q->hits);
+	free(q->touched);
+	free(q->keys);
+	memset(q, 0, sizeof(struct endindex_query));
+}
+
+///  add the k-mers of an open end of a query to the ones to be seeded together
+/**
+ * @param[in] segment Open end of the query
+ * @param[in] length Length of the segment
+ * @param[in,out] q Counts of the query, the k-mers are kept in q->keys until seedGathered
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int gatherEnd(const struct endindex *x, const char *segment, const unsigned int length, struct endindex_query *q){
+	const unsigned int k = x->header->k;
+	if(length < k) return(1);
+
+	size_t size = q->keys_size;
+	if(!growKeys(&q->keys, &size, q->no_keys + length - k + 1)){
+		fprintf(stderr, "ERROR: gatherEnd: could not allocate %u k-mers\n", q->no_keys + length - k + 1);
+		return(0);
+	}
+	q->keys_size = size;
+	const uint64_t mask = (1ULL << (2*k)) - 1;
+	uint64_t key = 0;
+	unsigned int valid = 0; // bases of ACGU in a row
+	for(unsigned int i = 0; i < length; ++i){
+		const int b = baseCode(segment[i]);
+		valid = b > 3 ? 0 : valid + 1;
+		key = ((key << 2) | (b & 3)) & mask;
+		if(valid >= k) q->keys[q->no_keys++] = key;
+	}
+	return(1);
+}
+
+///  count the library strands the gathered k-mers can pair with
+/**
+ * Every distinct k-mer gathered since the last call is looked up once, however many of the ends it occurs in, and every strand in its postings with one of the wanted segments gets a hit in the slot.
+ *
+ * @param[in] segments ENDINDEX_HEAD and/or ENDINDEX_TAIL, the segments of the library strands the ends can bind
+ * @param[in] slot 0 or 1, hits of different slots are counted apart (e.g. the two orientations of fn2)
+ * @param[in,out] q Counts of the query, its gathered k-mers are consumed
+ */
+void seedGathered(const struct endindex *x, const unsigned int segments, const unsigned int slot, struct endindex_query *q){
+	qsort(q->keys, q->no_keys, sizeof(uint64_t), compareKeys);
+
+	for(size_t i = 0; i < q->no_keys; ++i){
+		if(i && q->keys[i] == q->keys[i-1]) continue;
+		for(uint64_t j = x->buckets[q->keys[i]]; j < x->buckets[q->keys[i]+1]; ++j){
+			if(!(x->postings[j].segments & segments)) continue;
+			const uint32_t s = 2 * x->postings[j].entry + slot;
+			if(!q->hits[s]) q->touched[q->no_touched++] = s;
+			if(q->hits[s] < UINT16_MAX) ++q->hits[s];
+		}
+	}
+	q->no_keys = 0;
+}
+
+///  count the library strands an open end of a query can pair with, see gatherEnd and seedGathered
+/**
+ * @return 1 on success, 0 if some error happened.
+ */
+int seedEnd(const struct endindex *x, const char *segment, const unsigned int length, const unsigned int segments, const unsigned int slot, struct endindex_query *q){
+	if(!gatherEnd(x, segment, length, q)) return(0);
+	seedGathered(x, segments, slot, q);
+	return(1);
+}
+
+static int compareSlots(const void *a, const void *b){
+	const uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+	return( (x > y) - (x < y) );
+}
+
+///  the strands hit by at least min_hits k-mers, and clear the counts for the next query
+/**
+ * @param[out] candidates strand * 2 + slot, ascending, room for 2 * no_entries
+ *
+ * @return Number of candidates.
+ */
+unsigned int endCandidates(struct endindex_query *q, const unsigned int min_hits, uint32_t *candidates){
+	qsort(q->touched, q->no_touched, sizeof(uint32_t), compareSlots);
+	unsigned int n = 0;
+	for(unsigned int i = 0; i < q->no_touched; ++i){
+		const uint32_t s = q->touched[i];
+		if(q->hits[s] >= min_hits) candidates[n++] = s;
+		q->hits[s] = 0;
+	}
+	q->no_touched = 0;
+	return(n);
+}
+
+// programs
+
+int indexMain(int argc, char** argv){
+	char *input = "-", *output = "library.idx";
+	unsigned int k = 6, flags = 0;
+	int threads = 0;
+	double temperature = VRNA_MODEL_DEFAULT_TEMPERATURE;
+
+	int c;
+	while((c = getopt(argc, argv, "i:o:k:t:T:W")) != -1){
+		switch(c){
+			case 'i': input = optarg; break;
+			case 'o': output = optarg; break;
+			case 'k': k = strtoul(optarg, NULL, 10); break;
+			case 't': threads = atoi(optarg); break;
+			case 'T': temperature = strtod(optarg, NULL); break;
+			case 'W': flags |= ENDINDEX_WHOLE; break;
+			default:
+				fprintf(stderr, "usage: %s [-i library] [-o index] [-k k] [-t threads] [-T temperature] [-W]\n", argv[0]);
+				return(1);
+		}
+	}
+
+	struct context ctx;
+	if(!initContext(temperature, &ctx)) return(1);
+	if(!ctx.md.noGU) flags |= ENDINDEX_WOBBLE;
+
+	struct pool p;
+	memset(&p, 0, sizeof(p));
+	int error = !readPool(input, &p) || !foldPool(&p, threads, &ctx);
+	if(!error) error = !buildEndIndex(&p, k, flags, temperature, output);
+
+	freePool(&p);
+	freeContext(&ctx);
+	return(error);
+}
+
+// a complex of a query with a library strand
+struct query_hit{
+	uint32_t entry;
+	char *seq, *structure; // in the arena
+	float energy, binding;
+};
+
+// a query: its complexes with the candidates, in the arena of the thread
+struct query_result{
+	struct query_hit *hits;
+	unsigned int no_hits;
+	unsigned long int folded, pairs; // candidates, and complexes an exhaustive search would fold
+};
+
+// gather the sticky ends of a duplex strand, they are seeded together against whole library strands
+static int gatherDuplexStrand(const struct endindex *x, const char *seq, const char *str, const unsigned int length, struct endindex_query *q){
+	unsigned int head, tail;
+	stickyEnds(str, length, &head, &tail);
+	if(head == length) return( gatherEnd(x, seq, length, q) );
+	return( gatherEnd(x, seq, head, q) && gatherEnd(x, seq + length - tail, tail, q) );
+}
+
+/// bind a query to the library strands its open ends seed
+/**
+ * A single strand is folded on its own, its 3' end seeds the heads of the library (fn2 query&strand) and its 5' end the tails (fn2 strand&query). A duplex "seq1&seq2 [structure]" (without a structure the best one of fn3) seeds with its four sticky ends, the index has to be of whole strands, and every candidate is bound as the single strand of connect3. Only complexes with a negative binding energy are kept.
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+static int runQuery(const struct endindex *x, char *line, const unsigned int min_hits, struct endindex_query *q, uint32_t *candidates, struct context *ctx, struct query_result *res){
+	struct arena *a = getArena(ctx);
+	res->hits = NULL;
+	res->no_hits = 0;
+	res->folded = res->pairs = 0;
+	if(!a) return(0);
+
+	char *seq = arenaStrdup(a, line);
+	if(!seq) return(0);
+	char *duplex_str = seq + strcspn(seq, " \t");
+	if(*duplex_str){
+		*duplex_str++ = '\0';
+		duplex_str += strspn(duplex_str, " \t");
+	}
+	char *cut = strchr(seq, '&');
+	const unsigned int length = strlen(seq);
+	res->pairs = (cut ? 1UL : 2UL) * x->header->no_entries;
+
+	unsigned int n;
+	float mfe = 0.0f;
+	char *str = NULL;
+	if(!cut){
+		// single strand
+		str = (char*) arenaAlloc(a, length + 1);
+		if(!str) return(0);
+		mfe = foldRNA(seq, str, ctx);
+		unsigned int head, tail;
+		stickyEnds(str, length, &head, &tail);
+		if(!seedEnd(x, seq + length - tail, tail, ENDINDEX_HEAD, 0, q) || !seedEnd(x, seq, head, ENDINDEX_TAIL, 1, q)) return(0);
+	} else{
+		if(!(x->header->flags & ENDINDEX_WHOLE)){
+			fprintf(stderr, "ERROR: runQuery: duplex queries need an index of whole strands (index -W)\n");
+			return(0);
+		}
+		char *full = arenaStrdup(a, seq);
+		if(!full) return(0);
+		*cut = '\0';
+		const unsigned int length1 = cut - seq;
+		if(*duplex_str){
+			// checked before fn4 copies it into buffers of the length of the sequence
+			str = duplex_str;
+			if(strlen(str) != length || str[length1] != '&'){
+				fprintf(stderr, "ERROR: runQuery: %s is not a structure of %s\n", str, full);
+				return(0);
+			}
+			mfe = fn4(full, str, ctx);
+		} else{
+			vrna_subopt_solution_t *d = fn3(seq, cut + 1, ctx);
+			if(!countLength(d)) return(1); // no duplex, nothing to bind to
+			str = d[0].structure;
+			mfe = d[0].energy;
+			if(strlen(str) != length || str[length1] != '&'){
+				fprintf(stderr, "ERROR: runQuery: %s is not a structure of %s\n", str, full);
+				return(0);
+			}
+		}
+		// a k-mer shared by several ends is one seed
+		if(!gatherDuplexStrand(x, seq, str, length1, q) || !gatherDuplexStrand(x, cut + 1, str + length1 + 1, length - length1 - 1, q)){
+			q->no_keys = 0;
+			return(0);
+		}
+		seedGathered(x, ENDINDEX_HEAD | ENDINDEX_TAIL, 0, q);
+	}
+
+	n = endCandidates(q, min_hits, candidates);
+	res->folded = n;
+	res->hits = (struct query_hit*) arenaAlloc(a, (n ? n : 1) * sizeof(struct query_hit));
+	if(!res->hits) return(0);
+
+	for(unsigned int i = 0; i < n; ++i){
+		const uint32_t entry = candidates[i] >> 1;
+		char *lib_seq = (char*) entrySeq(x, entry), *lib_str = (char*) entryStructure(x, entry);
+		struct query_hit *h = res->hits + res->no_hits;
+		h->entry = entry;
+		h->seq = h->structure = NULL;
+		if(!cut){
+			h->energy = candidates[i] & 1
+				? fn2(lib_seq, lib_str, seq, str, &h->seq, &h->structure, ctx)
+				: fn2(seq, str, lib_seq, lib_str, &h->seq, &h->structure, ctx);
+		} else{
+			vrna_subopt_solution_t *t = connect3(seq, cut + 1, str, lib_seq, ctx);
+			const char *single = countLength(t) ? strrchr(t[0].structure, '&') : NULL;
+			if(!single || !strchr(single, ')')) continue; // the strand does not bind
+			h->energy = t[0].energy;
+			h->structure = t[0].structure;
+			h->seq = (char*) arenaAlloc(a, strlen(t[0].structure) + 1);
+			if(h->seq) sprintf(h->seq, "%s&%s&%s", seq, cut + 1, lib_seq);
+		}
+		if(!h->seq || !h->structure) return(0);
+		h->binding = h->energy - mfe - x->entries[entry].mfe;
+		if(h->binding < 0.0f) ++res->no_hits;
+	}
+	return(1);
+}
+
+int queryMain(int argc, char** argv){
+	char *input = "-", *index = NULL;
+	unsigned int min_hits = 1;
+	unsigned long int cache_mb = 0;
+	int threads = 0, ends = 0;
+
+	int c;
+	while((c = getopt(argc, argv, "x:i:m:t:c:E")) != -1){
+		switch(c){
+			case 'x': index = optarg; break;
+			case 'i': input = optarg; break;
+			case 'm': min_hits = strtoul(optarg, NULL, 10); break;
+			case 't': threads = atoi(optarg); break;
+			case 'c': cache_mb = strtoul(optarg, NULL, 10); break;
+			case 'E': ends = 1; break;
+			default:
+				fprintf(stderr, "usage: %s -x index [-i queries] [-m min_hits] [-t threads] [-c cache_MB] [-E]\n", argv[0]);
+				return(1);
+		}
+	}
+	if(!index){
+		fprintf(stderr, "usage: %s -x index [-i queries] [-m min_hits] [-t threads] [-c cache_MB] [-E]\n", argv[0]);
+		return(1);
+	}
+
+	struct endindex x;
+	if(!openEndIndex(index, &x)) return(1);
+
+	// the library was folded at the temperature of the index
+	struct context ctx;
+	if(!initContext(x.header->temperature, &ctx)){
+		closeEndIndex(&x);
+		return(1);
+	}
+	ctx.ends = ends; // fold only the dangling ends, the monomer structures stay
+
+	struct cache cache;
+	if(cache_mb){
+		if(!initCache(cache_mb << 20, 64, &cache)){
+			freeContext(&ctx);
+			closeEndIndex(&x);
+			return(1);
+		}
+		ctx.cache = &cache;
+	}
+
+	struct pool queries;
+	memset(&queries, 0, sizeof(queries));
+	int error = !readPool(input, &queries);
+	unsigned long int folded = 0, pairs = 0;
+
+	if(!error){
+		printf("query\tlibrary\tseq\tstructure\tenergy\tbinding\n");
+
+		#pragma omp parallel num_threads(threads ? threads : omp_get_max_threads())
+		{
+			struct endindex_query q;
+			uint32_t *candidates = (uint32_t*) malloc((2 * x.header->no_entries + 1) * sizeof(uint32_t));
+			const int ready = initEndQuery(&x, &q) && candidates;
+			if(!ready){
+				#pragma omp atomic write
+				error = 1;
+			}
+
+			#pragma omp for ordered schedule(dynamic, 1) reduction(+:folded,pairs)
+			for(unsigned int i = 0; i < queries.n; ++i){
+				struct query_result res = {NULL, 0, 0, 0};
+				const int ok = ready && runQuery(&x, queries.seqs[i], min_hits, &q, candidates, &ctx, &res);
+				folded += res.folded;
+				pairs += res.pairs;
+
+				#pragma omp ordered
+				{
+					if(!ok) error = 1;
+					for(unsigned int h = 0; ok && h < res.no_hits; ++h){
+						printf("%s\t%u\t%s\t%s\t%f\t%f\n", queries.seqs[i], res.hits[h].entry, res.hits[h].seq, res.hits[h].structure, res.hits[h].energy, res.hits[h].binding);
+					}
+				}
+
+				// release the complexes of the query
+				struct arena *a = getArena(&ctx);
+				if(a) resetArena(a);
+			}
+
+			free(candidates);
+			freeEndQuery(&q);
+		}
+
+		fprintf(stderr, "query: %lu of %lu query/library pairs folded (%.4f)\n", folded, pairs, pairs ? (double) folded / pairs : 0.0);
+	}
+
+	freePool(&queries);
+	if(ctx.cache){
+		printCacheStats(ctx.cache, stderr);
+		freeCache(ctx.cache);
+	}
+	freeContext(&ctx);
+	closeEndIndex(&x);
+	return(error);
+}
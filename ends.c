@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "interaction.h"
+#include "ends.h"
+#include "energy.h"
+
+#define ENDS_INF (INT_MAX / 4)
+
+// base at position c of concat
+static inline int baseAt(const char *concat, const unsigned int c){
+	return( encodeBase(concat[c]) );
+}
+
+///  can the complexes of fn2 be folded by hybridizeEnds with these model details
+/**
+ * The energy splits into core and helix only if stems of the exterior loop do not compete for their neighbours (dangles 0 or 2), and the helix may have lonely pairs.
+ */
+int endsApplicable(const vrna_md_t *md){
+	return( (md->dangles == 0 || md->dangles == 2) && !md->noLP && !md->gquad && !md->circ );
+}
+
+///  fold the dangling ends of a fn2 complex, its core fixed
+/**
+ * Same complex as in fn2: the trailing unpaired bases of the left strand (tail) and the leading unpaired bases of the right strand (head) may pair with each other, everything else keeps the monomer structures. The best helix of the two ends is found by a duplex DP over tail x head pairs, interior loops up to MAXLOOP, with the energy parameters of the context. Then the core alone and the core with that helix are scored by evalStructure, and the lower one is returned.
+ *
+ * Left and right may be complexes themselves, then the tail is that of the last strand of left and the head that of the first strand of right. Unlike vrna_mfe_dimer under the fn2 constraint, the pairs of the core are never opened. Check endsApplicable first.
+ *
+ * @param[in] concat Sequences of the strands, left&right
+ * @param[in] left_length Length of left, with its separators
+ * @param[in] left_str Structure of left
+ * @param[in] right_str Structure of right
+ * @param[out] structure Structure of the complex with the separators of concat, strlen(concat)+1 chars
+ * @param[out] mfe Energy of structure
+ * @param[in] ctx Folding context (model details, energy parameters, workspaces)
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int hybridizeEnds(const char *concat, const unsigned int left_length, const char *left_str, const char *right_str, char *structure, float *mfe, struct context *ctx){
+	const unsigned int right_length = strlen(right_str), length = left_length + 1 + right_length;
+	const vrna_param_t *P = ctx->params;
+	const vrna_md_t *md = &ctx->md;
+	const int dangles = md->dangles == 2;
+
+	// free ends, positions in concat
+	unsigned int tail = 0, head = 0;
+	while(tail < left_length && left_str[left_length-1-tail] == '.') ++tail;
+	while(head < right_length && right_str[head] == '.') ++head;
+
+	// DP tables: best helix with (i,j) as its outer pair, and the next pair of that helix
+	struct workspace *ws = getWorkspace(ctx, length);
+	if(!ws) return(0);
+	const size_t cells = (size_t) tail * head;
+	if(ws->ends_size < 2*cells){
+		int *tables = (int*) realloc(ws->ends, 2 * cells * sizeof(int));
+		if(!tables){
+			fprintf(stderr, "ERROR: hybridizeEnds: could not allocate tables of %u x %u\n", tail, head);
+			return(0);
+		}
+		ws->ends = tables;
+		ws->ends_size = 2*cells;
+	}
+	int *F = ws->ends, *next = ws->ends + cells;
+
+	const unsigned int first = left_length - tail, cut = left_length; // first base of the tail, the separator
+	int best = ENDS_INF, best_cell = -1;
+	for(int a = (int) tail - 1; a >= 0; --a){
+		const unsigned int i = first + a;
+		const int si = baseAt(concat, i);
+		for(unsigned int b = 0; b < head; ++b){
+			const unsigned int j = cut + 1 + b, cell = a * head + b;
+			const int sj = baseAt(concat, j);
+			const int type = md->pair[si][sj];
+			F[cell] = ENDS_INF;
+			next[cell] = -1;
+			if(!type) continue;
+
+			// (i,j) is the pair next to the strand break
+			F[cell] = extStemEnergy(md->pair[sj][si],
+					dangles && j > cut + 1 ? baseAt(concat, j-1) : -1,
+					dangles && i < cut - 1 ? baseAt(concat, i+1) : -1,
+					P);
+
+			// or it encloses the next pair (k,l) of the helix
+			for(unsigned int k = i+1; k < cut && k-i-1 <= MAXLOOP; ++k){
+				for(unsigned int l = j-1; l > cut && (k-i-1) + (j-l-1) <= MAXLOOP; --l){
+					const unsigned int inner = (k - first) * head + (l - cut - 1);
+					if(F[inner] >= ENDS_INF) continue;
+					const int e = F[inner] + interiorLoopEnergy(k-i-1, j-l-1, type,
+							md->pair[baseAt(concat, l)][baseAt(concat, k)],
+							baseAt(concat, i+1), baseAt(concat, j-1), baseAt(concat, k-1), baseAt(concat, l+1),
+							P);
+					if(e < F[cell]){
+						F[cell] = e;
+						next[cell] = inner;
+					}
+				}
+			}
+
+			// the outer pair is a stem of the exterior loop too
+			const int e = F[cell] + extStemEnergy(type,
+					dangles && i > 0 && concat[i-1] != '&' ? baseAt(concat, i-1) : -1,
+					dangles && j+1 < length && concat[j+1] != '&' ? baseAt(concat, j+1) : -1,
+					P);
+			if(e < best){
+				best = e;
+				best_cell = cell;
+			}
+		}
+	}
+
+	// the core, with and without the helix
+	sprintf(structure, "%s&%s", left_str, right_str);
+	int core;
+	if(!evalStructure(concat, structure, P, &ws->eval, &core)){
+		fprintf(stderr, "ERROR: hybridizeEnds: could not evaluate %s\n", structure);
+		return(0);
+	}
+	*mfe = core / 100.0;
+
+	if(best_cell >= 0){
+		for(int c = best_cell; c >= 0; c = next[c]){
+			structure[first + c / head] = '(';
+			structure[cut + 1 + c % head] = ')';
+		}
+		int e;
+		if(evalStructure(concat, structure, P, &ws->eval, &e) && e < core) *mfe = e / 100.0;
+		else for(int c = best_cell; c >= 0; c = next[c]){ // the ends stay apart
+			structure[first + c / head] = '.';
+			structure[cut + 1 + c % head] = '.';
+		}
+	}
+
+	return(1);
+}
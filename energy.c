@@ -0,0 +1,510 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <limits.h>
+#include <getopt.h>
+#include <omp.h>
+#include "energy.h"
+
+// loop energies
+
+int encodeBase(const char c){
+	switch(c){
+		case 'A': case 'a': return(1);
+		case 'C': case 'c': return(2);
+		case 'G': case 'g': return(3);
+		case 'U': case 'u': case 'T': case 't': return(4);
+		default: return(0);
+	}
+}
+
+///  stem of type in the exterior loop, n5d and n3d are the neighbouring bases, -1 if there is none or dangles are off
+int extStemEnergy(const int type, const int n5d, const int n3d, const vrna_param_t *P){
+	int e = 0;
+	if(n5d >= 0 && n3d >= 0) e = P->mismatchExt[type][n5d][n3d];
+	else if(n5d >= 0) e = P->dangle5[type][n5d];
+	else if(n3d >= 0) e = P->dangle3[type][n3d];
+	if(type > 2) e += P->TerminalAU;
+	return(e);
+}
+
+///  stem of type in a multiloop, same as extStemEnergy
+int mlStemEnergy(const int type, const int n5d, const int n3d, const vrna_param_t *P){
+	int e = P->MLintern[type];
+	if(n5d >= 0 && n3d >= 0) e += P->mismatchM[type][n5d][n3d];
+	else if(n5d >= 0) e += P->dangle5[type][n5d];
+	else if(n3d >= 0) e += P->dangle3[type][n3d];
+	if(type > 2) e += P->TerminalAU;
+	return(e);
+}
+
+// loop with n unpaired bases, extrapolated beyond MAXLOOP
+static int loopSize(const int *table, const unsigned int n, const vrna_param_t *P){
+	return( n <= MAXLOOP ? table[n] : table[MAXLOOP] + (int) (P->lxc * log((double) n / MAXLOOP)) );
+}
+
+// penalty of an interior loop with nl and ns unpaired bases on its sides
+static int asymmetry(const unsigned int nl, const unsigned int ns, const vrna_param_t *P){
+	const int e = (int) (nl-ns) * P->ninio[2];
+	return( e < P->MAX_NINIO ? e : P->MAX_NINIO );
+}
+
+///  hairpin of size unpaired bases closed by a pair of type
+/**
+ * @param[in] loop Bases of the hairpin with the closing pair, upper case (for the special tri-, tetra- and hexaloops)
+ */
+int hairpinEnergy(const unsigned int size, const int type, const int si1, const int sj1, const char *loop, const vrna_param_t *P){
+	int e = loopSize(P->hairpin, size, P);
+	if(size < 3) return(e);
+
+	if(P->model_details.special_hp){
+		char tl[9];
+		const char *ts;
+		if(size == 4){
+			memcpy(tl, loop, 6);
+			tl[6] = '\0';
+			if((ts = strstr(P->Tetraloops, tl))) return( P->Tetraloop_E[(ts - P->Tetraloops) / 7] );
+		} else if(size == 6){
+			memcpy(tl, loop, 8);
+			tl[8] = '\0';
+			if((ts = strstr(P->Hexaloops, tl))) return( P->Hexaloop_E[(ts - P->Hexaloops) / 9] );
+		} else if(size == 3){
+			memcpy(tl, loop, 5);
+			tl[5] = '\0';
+			if((ts = strstr(P->Triloops, tl))) return( P->Triloop_E[(ts - P->Triloops) / 6] );
+			return( e + (type > 2 ? P->TerminalAU : 0) );
+		}
+	}
+
+	return( e + P->mismatchH[type][si1][sj1] );
+}
+
+///  interior loop of (i,j) enclosing (p,q)
+/**
+ * @param[in] n1 Unpaired bases between i and p
+ * @param[in] n2 Unpaired bases between q and j
+ * @param[in] type Type of (i,j)
+ * @param[in] type_2 Type of (q,p)
+ * @param[in] si1 Base i+1, sj1 base j-1, sp1 base p-1, sq1 base q+1
+ */
+int interiorLoopEnergy(const unsigned int n1, const unsigned int n2, const int type, const int type_2, const int si1, const int sj1, const int sp1, const int sq1, const vrna_param_t *P){
+	const unsigned int nl = n1 > n2 ? n1 : n2, ns = n1 > n2 ? n2 : n1;
+
+	if(!nl) return( P->stack[type][type_2] ); // stack
+
+	if(!ns){ // bulge
+		int e = loopSize(P->bulge, nl, P);
+		if(nl == 1) e += P->stack[type][type_2];
+		else{
+			if(type > 2) e += P->TerminalAU;
+			if(type_2 > 2) e += P->TerminalAU;
+		}
+		return(e);
+	}
+
+	if(ns == 1){
+		if(nl == 1) return( P->int11[type][type_2][si1][sj1] );
+		if(nl == 2){
+			if(n1 == 1) return( P->int21[type][type_2][si1][sq1][sj1] );
+			return( P->int21[type_2][type][sq1][si1][sp1] );
+		}
+		// 1xn
+		int e = loopSize(P->internal_loop, nl+1, P);
+		e += asymmetry(nl, ns, P);
+		return( e + P->mismatch1nI[type][si1][sj1] + P->mismatch1nI[type_2][sq1][sp1] );
+	}
+
+	if(ns == 2){
+		if(nl == 2) return( P->int22[type][type_2][si1][sp1][sq1][sj1] );
+		if(nl == 3) return( P->internal_loop[5] + P->ninio[2] + P->mismatch23I[type][si1][sj1] + P->mismatch23I[type_2][sq1][sp1] );
+	}
+
+	// generic
+	int e = loopSize(P->internal_loop, nl+ns, P);
+	e += asymmetry(nl, ns, P);
+	return( e + P->mismatchI[type][si1][sj1] + P->mismatchI[type_2][sq1][sp1] );
+}
+
+#define BOUND_INF (INT_MAX / 4)
+
+static inline int lower(const int a, const int b){
+	return( a < b ? a : b );
+}
+
+// lowest entry of a mismatch table for one type, over every pair of neighbours
+static int minMismatch(const int table[NBPAIRS+1][5][5], const int type){
+	int e = BOUND_INF;
+	for(int a = 0; a < 5; ++a){
+		for(int b = 0; b < 5; ++b) e = lower(e, table[type][a][b]);
+	}
+	return(e);
+}
+
+///  lower bound of the interior loops enclosing a pair of type_2 with at least min_side unpaired bases on one side
+/**
+ * The minimum of interiorLoopEnergy over the type of the closing pair, the neighbouring bases and the sizes up to MAXLOOP, taken per class of loop (bulges, 1x1, 1x2, 1xn, 2x2, 2x3, generic) straight from the tables.
+ *
+ * @param[in] min_side Smallest larger side of the loops, at least 1 (all loops but stacks)
+ * @param[in] type_2 Type of the enclosed pair (q,p)
+ */
+int interiorLoopBound(const unsigned int min_side, const int type_2, const vrna_param_t *P){
+	// the parts that depend on the closing pair and the bases, at their lowest
+	int stack = BOUND_INF, tau = BOUND_INF, m1n = BOUND_INF, m23 = BOUND_INF, mI = BOUND_INF;
+	int i11 = BOUND_INF, i21 = BOUND_INF, i22 = BOUND_INF;
+	for(int type = 1; type <= NBPAIRS; ++type){
+		stack = lower(stack, P->stack[type][type_2]);
+		tau = lower(tau, type > 2 ? P->TerminalAU : 0);
+		m1n = lower(m1n, minMismatch(P->mismatch1nI, type));
+		m23 = lower(m23, minMismatch(P->mismatch23I, type));
+		mI = lower(mI, minMismatch(P->mismatchI, type));
+		for(int a = 0; a < 5; ++a){
+			for(int b = 0; b < 5; ++b){
+				i11 = lower(i11, P->int11[type][type_2][a][b]);
+				for(int c = 0; c < 5; ++c){
+					i21 = lower(i21, lower(P->int21[type][type_2][a][b][c], P->int21[type_2][type][a][b][c]));
+					for(int d = 0; d < 5; ++d) i22 = lower(i22, P->int22[type][type_2][a][b][c][d]);
+				}
+			}
+		}
+	}
+	const int tau_2 = type_2 > 2 ? P->TerminalAU : 0;
+	m1n += minMismatch(P->mismatch1nI, type_2);
+	m23 += minMismatch(P->mismatch23I, type_2);
+	mI += minMismatch(P->mismatchI, type_2);
+
+	int e = BOUND_INF;
+	for(unsigned int ns = 0; 2*ns <= MAXLOOP; ++ns){
+		for(unsigned int nl = ns > min_side ? ns : min_side; nl + ns <= MAXLOOP; ++nl){
+			int x;
+			if(!ns) x = nl == 1 ? P->bulge[1] + stack : P->bulge[nl] + tau + tau_2;
+			else if(ns == 1 && nl == 1) x = i11;
+			else if(ns == 1 && nl == 2) x = i21;
+			else if(ns == 1) x = loopSize(P->internal_loop, nl+1, P) + asymmetry(nl, 1, P) + m1n;
+			else if(ns == 2 && nl == 2) x = i22;
+			else if(ns == 2 && nl == 3) x = P->internal_loop[5] + P->ninio[2] + m23;
+			else x = loopSize(P->internal_loop, nl+ns, P) + asymmetry(nl, ns, P) + mI;
+			e = lower(e, x);
+		}
+	}
+	return(e);
+}
+
+// evaluation of structures
+
+void initEvaluator(struct evaluator *e){
+	memset(e, 0, sizeof(struct evaluator));
+}
+
+void freeEvaluator(struct evaluator *e){
+	free(e->seq);
+	free(e->S);
+	free(e->pt);
+	free(e->strand);
+	free(e->stack);
+	initEvaluator(e);
+}
+
+static int growEvaluator(struct evaluator *e, const unsigned int length){
+	if(e->size >= length+2) return(1);
+	freeEvaluator(e);
+	e->seq = (char*) malloc(length+2);
+	e->S = (short*) malloc((length+2) * sizeof(short));
+	e->pt = (short*) malloc((length+2) * sizeof(short));
+	e->strand = (unsigned short*) malloc((length+2) * sizeof(unsigned short));
+	e->stack = (unsigned int*) malloc((length+2) * sizeof(unsigned int));
+	if(!e->seq || !e->S || !e->pt || !e->strand || !e->stack){
+		freeEvaluator(e);
+		return(0);
+	}
+	e->size = length+2;
+	return(1);
+}
+
+///  can evalStructure score structures with these model details
+/**
+ * Stems of the exterior and multiloops must not compete for their neighbours (dangles 0 or 2), and there are no G-quadruplexes or circular RNAs.
+ */
+int evalApplicable(const vrna_md_t *md){
+	return( (md->dangles == 0 || md->dangles == 2) && !md->gquad && !md->circ );
+}
+
+// root of the strand in the union-find of the strands
+static unsigned int findStrand(unsigned int *parent, unsigned int s){
+	while(parent[s] != s){
+		parent[s] = parent[parent[s]];
+		s = parent[s];
+	}
+	return(s);
+}
+
+// stems of the loop closed by (i,j), or of the exterior loop if i is 0, scored as exterior or multiloop stems
+static int loopStems(const unsigned int i, const unsigned int j, const int exterior, const unsigned int n, const struct evaluator *e, const vrna_param_t *P){
+	const vrna_md_t *md = &P->model_details;
+	const int dangles = md->dangles == 2;
+	const short *S = e->S, *pt = e->pt;
+	int energy = 0;
+
+	for(unsigned int k = i+1; k < j; ++k){
+		if(!pt[k]) continue;
+		const unsigned int p = k, q = pt[k];
+		const int type = md->pair[S[p]][S[q]];
+		if(exterior) energy += extStemEnergy(type,
+				dangles && p > 1 && e->strand[p-1] == e->strand[p] ? S[p-1] : -1,
+				dangles && q < n && e->strand[q+1] == e->strand[q] ? S[q+1] : -1,
+				P);
+		else energy += mlStemEnergy(type, dangles ? S[p-1] : -1, dangles ? S[q+1] : -1, P);
+		k = q;
+	}
+	return(energy);
+}
+
+///  free energy of a structure of one or more strands
+/**
+ * The loop decomposition sum of the structure, O(length), with the loop rules of RNAlib: a loop with a strand break is scored as exterior loop, and every strand joined to the complex costs DuplexInit. The structure is not folded or checked against constraints, so the result equals the MFE of fn4 only where that MFE is the given structure (canonical pairs, hairpins of at least min_loop_size, interior loops up to MAXLOOP). Check evalApplicable first.
+ *
+ * @param[in] seq Sequence, strands separated by '&'
+ * @param[in] structure Dot-bracket structure, with the separators of seq
+ * @param[in] P Scaled energy parameters, with their model details
+ * @param[in] e Buffers of the calling thread
+ * @param[out] energy Free energy in dcal/mol
+ *
+ * @return 1 on success, 0 if the structure is not valid for the sequence (or memory could not be allocated).
+ */
+int evalStructure(const char *seq, const char *structure, const vrna_param_t *P, struct evaluator *e, int *energy){
+	const vrna_md_t *md = &P->model_details;
+	const int dangles = md->dangles == 2;
+	const unsigned int full = strlen(seq);
+	if(!growEvaluator(e, full) || strlen(structure) != full) return(0);
+
+	// bases, strands and pairs without the separators
+	unsigned int n = 0, strands = 1, depth = 0;
+	for(unsigned int k = 0; k < full; ++k){
+		if(seq[k] == '&'){
+			if(structure[k] != '&') return(0);
+			++strands;
+			continue;
+		}
+		++n;
+		const char c = toupper(seq[k]);
+		e->seq[n] = c == 'T' ? 'U' : c;
+		e->S[n] = encodeBase(c);
+		e->strand[n] = strands-1;
+		e->pt[n] = 0;
+		switch(structure[k]){
+			case '.': break;
+			case '(': e->stack[depth++] = n; break;
+			case ')':
+				if(!depth) return(0);
+				e->pt[n] = e->stack[--depth];
+				e->pt[e->pt[n]] = n;
+				break;
+			default: return(0);
+		}
+	}
+	if(depth) return(0);
+	e->seq[n+1] = '\0';
+	const short *S = e->S, *pt = e->pt;
+
+	// strands joined by pairs, the stack is free again
+	unsigned int *parent = e->stack;
+	for(unsigned int s = 0; s < strands; ++s) parent[s] = s;
+
+	int E = loopStems(0, n+1, 1, n, e, P);
+	for(unsigned int i = 1; i <= n; ++i){
+		if(pt[i] <= (short) i) continue;
+		const unsigned int j = pt[i];
+		const int type = md->pair[S[i]][S[j]];
+		if(!type) return(0);
+
+		// inner stems, unpaired bases and strand breaks of the loop closed by (i,j)
+		unsigned int stems = 0, unpaired = 0, p = 0, q = 0;
+		int nick = 0;
+		for(unsigned int k = i; k < j; ){
+			if(e->strand[k] != e->strand[k+1]) nick = 1;
+			if(k+1 == j) break;
+			if(pt[k+1]){
+				++stems;
+				p = k+1;
+				q = pt[p];
+				k = q;
+			} else{
+				++unpaired;
+				++k;
+			}
+		}
+
+		if(nick){
+			E += extStemEnergy(md->pair[S[j]][S[i]],
+					dangles && e->strand[j-1] == e->strand[j] ? S[j-1] : -1,
+					dangles && e->strand[i+1] == e->strand[i] ? S[i+1] : -1,
+					P);
+			E += loopStems(i, j, 1, n, e, P);
+		} else if(!stems){
+			if(j-i-1 < (unsigned int) md->min_loop_size) return(0);
+			E += hairpinEnergy(j-i-1, type, S[i+1], S[j-1], e->seq + i, P);
+		} else if(stems == 1){
+			const int type_2 = md->pair[S[q]][S[p]];
+			if(!type_2) return(0);
+			E += interiorLoopEnergy(p-i-1, j-q-1, type, type_2, S[i+1], S[j-1], S[p-1], S[q+1], P);
+		} else{
+			E += P->MLclosing + unpaired * P->MLbase;
+			E += mlStemEnergy(md->pair[S[j]][S[i]], dangles ? S[j-1] : -1, dangles ? S[i+1] : -1, P);
+			E += loopStems(i, j, 0, n, e, P);
+		}
+
+		const unsigned int a = findStrand(parent, e->strand[i]), b = findStrand(parent, e->strand[j]);
+		if(a != b) parent[a] = b;
+	}
+
+	// one initiation for every strand joined to a complex
+	for(unsigned int s = 0; s < strands; ++s) if(findStrand(parent, s) != s) E += P->DuplexInit;
+
+	*energy = E;
+	return(1);
+}
+
+///  free energies of many structures at once
+/**
+ * The energy parameters of every temperature are those of the sweep, scaled once for the whole batch. Tuples are spread over OpenMP threads, each with its own buffers. A tuple at a temperature the sweep does not have, or with a structure evalStructure rejects, gets ok = 0.
+ *
+ * @param[in] s Temperatures and their energy parameters
+ * @param[in,out] tuples Sequences, structures and temperatures in, energies out
+ * @param[in] no_tuples Number of tuples
+ * @param[in] threads Number of threads. If 0, the OpenMP default is used.
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int evalBatch(const struct sweep *s, struct eval_tuple *tuples, const size_t no_tuples, const int threads){
+	if(!evalApplicable(&s->md)){
+		fprintf(stderr, "ERROR: evalBatch: dangles %d can not be evaluated stem by stem\n", s->md.dangles);
+		return(0);
+	}
+
+	int ok = 1;
+	#pragma omp parallel num_threads(threads ? threads : omp_get_max_threads())
+	{
+		struct evaluator e;
+		initEvaluator(&e);
+		unsigned int t = 0; // tuples come sorted by temperature more often than not
+
+		#pragma omp for schedule(dynamic, 256)
+		for(size_t k = 0; k < no_tuples; ++k){
+			struct eval_tuple *x = tuples + k;
+			x->ok = 0;
+			if(fabs(s->temperatures[t] - x->temperature) > 1e-9){
+				for(t = 0; t < s->no_temperatures && fabs(s->temperatures[t] - x->temperature) > 1e-9; ++t);
+				if(t == s->no_temperatures){
+					t = 0;
+					continue;
+				}
+			}
+
+			int energy;
+			if(evalStructure(x->seq, x->structure, s->params[t], &e, &energy)){
+				x->energy = energy / 100.0;
+				x->ok = 1;
+			} else if(!e.size){
+				#pragma omp atomic write
+				ok = 0;
+			}
+		}
+
+		freeEvaluator(&e);
+	}
+
+	if(!ok) fprintf(stderr, "ERROR: evalBatch: could not allocate buffers!\n");
+	return(ok);
+}
+
+#define EVAL_BATCH 65536
+
+int evalMain(int argc, char** argv){
+	double from = VRNA_MODEL_DEFAULT_TEMPERATURE, to = VRNA_MODEL_DEFAULT_TEMPERATURE, step = 1.0;
+	const char *input = "-", *output = NULL;
+	int threads = 0;
+
+	int c;
+	while((c = getopt(argc, argv, "a:b:d:t:i:o:")) != -1){
+		switch(c){
+			case 'a': from = strtod(optarg, NULL); break;
+			case 'b': to = strtod(optarg, NULL); break;
+			case 'd': step = strtod(optarg, NULL); break;
+			case 't': threads = atoi(optarg); break;
+			case 'i': input = optarg; break;
+			case 'o': output = optarg; break;
+			default:
+				fprintf(stderr, "usage: %s [-a from] [-b to] [-d step] [-t threads] [-i input] [-o output]\n", argv[0]);
+				fprintf(stderr, "  input lines: sequence<TAB>structure[<TAB>temperature], strands separated by '&'\n");
+				return(1);
+		}
+	}
+	if(to < from) to = from;
+
+	FILE *in = strcmp(input, "-") ? fopen(input, "r") : stdin;
+	FILE *out = output ? fopen(output, "w") : stdout;
+	if(!in || !out){
+		fprintf(stderr, "ERROR: could not open %s\n", !in ? input : output);
+		if(in && in != stdin) fclose(in);
+		return(1);
+	}
+
+	struct sweep s;
+	char **lines = (char**) calloc(EVAL_BATCH, sizeof(char*));
+	size_t *sizes = (size_t*) calloc(EVAL_BATCH, sizeof(size_t));
+	struct eval_tuple *tuples = (struct eval_tuple*) calloc(EVAL_BATCH, sizeof(struct eval_tuple));
+	int error = !lines || !sizes || !tuples;
+	if(error) fprintf(stderr, "ERROR: evalMain: could not allocate a batch of %d\n", EVAL_BATCH);
+	else if(!initSweepRange(from, to, step, &s)) error = 1;
+	if(error){
+		free(lines);
+		free(sizes);
+		free(tuples);
+		if(in != stdin) fclose(in);
+		if(output) fclose(out);
+		return(1);
+	}
+
+	unsigned long int line = 0, invalid = 0;
+	while(!error){
+		// read a batch
+		size_t no_tuples = 0;
+		while(no_tuples < EVAL_BATCH && getline(lines + no_tuples, sizes + no_tuples, in) != -1){
+			++line;
+			char *l = lines[no_tuples], *save = NULL;
+			l[strcspn(l, "\r\n")] = '\0';
+			struct eval_tuple *x = tuples + no_tuples;
+			x->seq = strtok_r(l, "\t", &save);
+			x->structure = strtok_r(NULL, "\t", &save);
+			const char *temperature = strtok_r(NULL, "\t", &save);
+			if(!x->seq || !x->structure){
+				fprintf(stderr, "WARNING: evalMain: skipped line %lu, no structure\n", line);
+				continue;
+			}
+			x->temperature = temperature ? strtod(temperature, NULL) : from;
+			++no_tuples;
+		}
+		if(!no_tuples) break;
+
+		error = !evalBatch(&s, tuples, no_tuples, threads);
+		for(size_t k = 0; k < no_tuples && !error; ++k){
+			const struct eval_tuple *x = tuples + k;
+			if(x->ok) fprintf(out, "%s\t%s\t%g\t%.2f\n", x->seq, x->structure, x->temperature, x->energy);
+			else{
+				fprintf(out, "%s\t%s\t%g\tNA\n", x->seq, x->structure, x->temperature);
+				++invalid;
+			}
+		}
+	}
+	if(invalid) fprintf(stderr, "WARNING: evalMain: %lu structures could not be evaluated\n", invalid);
+
+	for(unsigned int k = 0; k < EVAL_BATCH; ++k) free(lines[k]);
+	free(lines);
+	free(sizes);
+	free(tuples);
+	freeSweep(&s);
+	if(in != stdin) fclose(in);
+	if(output) fclose(out);
+	return(error);
+}
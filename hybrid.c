@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <omp.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "interaction.h"
+#include "hybrid.h"
+#include "energy.h"
+#include "stream.h"
+
+// kernels, see hybrid_kernel.h
+
+#if defined(__x86_64__)
+#define KERNEL_NAME hybridAvx512
+#define KERNEL_TARGET __attribute__((target("avx512f")))
+#define V __m512i
+#define VLANES 16
+#define VLOAD(p) _mm512_load_si512((const void*) (p))
+#define VSTORE(p, x) _mm512_store_si512((void*) (p), x)
+#define VADD(x, y) _mm512_add_epi32(x, y)
+#define VMIN(x, y) _mm512_min_epi32(x, y)
+#define VSET1(x) _mm512_set1_epi32(x)
+#define VGATHER(base, idx) _mm512_i32gather_epi32(idx, (const void*) (base), 4)
+#include "hybrid_kernel.h"
+#undef KERNEL_NAME
+#undef KERNEL_TARGET
+#undef V
+#undef VLANES
+#undef VLOAD
+#undef VSTORE
+#undef VADD
+#undef VMIN
+#undef VSET1
+#undef VGATHER
+
+#define KERNEL_NAME hybridAvx2
+#define KERNEL_TARGET __attribute__((target("avx2")))
+#define V __m256i
+#define VLANES 8
+#define VLOAD(p) _mm256_load_si256((const __m256i*) (p))
+#define VSTORE(p, x) _mm256_store_si256((__m256i*) (p), x)
+#define VADD(x, y) _mm256_add_epi32(x, y)
+#define VMIN(x, y) _mm256_min_epi32(x, y)
+#define VSET1(x) _mm256_set1_epi32(x)
+#define VGATHER(base, idx) _mm256_i32gather_epi32((const int*) (base), idx, 4)
+#include "hybrid_kernel.h"
+#undef KERNEL_NAME
+#undef KERNEL_TARGET
+#undef V
+#undef VLANES
+#undef VLOAD
+#undef VSTORE
+#undef VADD
+#undef VMIN
+#undef VSET1
+#undef VGATHER
+#endif
+
+// one lane at a time, for other machines and to check the vector kernels against
+#define KERNEL_NAME hybridScalar
+#define KERNEL_TARGET
+#define V int32_t
+#define VLANES 1
+#define VLOAD(p) (*(p))
+#define VSTORE(p, x) (*(p) = (x))
+#define VADD(x, y) ((x) + (y))
+#define VMIN(x, y) ((x) < (y) ? (x) : (y))
+#define VSET1(x) ((int32_t) (x))
+#define VGATHER(base, idx) ((base)[idx])
+#include "hybrid_kernel.h"
+#undef KERNEL_NAME
+#undef KERNEL_TARGET
+#undef V
+#undef VLANES
+#undef VLOAD
+#undef VSTORE
+#undef VADD
+#undef VMIN
+#undef VSET1
+#undef VGATHER
+
+// the widest kernel the CPU runs, HYBRID_KERNEL=scalar|avx2|avx512 picks a narrower one
+static hybrid_kernel pickKernel(const char **name){
+	const char *force = getenv("HYBRID_KERNEL");
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if((!force || !strcmp(force, "avx512")) && __builtin_cpu_supports("avx512f")){
+		*name = "avx512";
+		return(hybridAvx512);
+	}
+	if((!force || strcmp(force, "scalar")) && __builtin_cpu_supports("avx2")){
+		*name = "avx2";
+		return(hybridAvx2);
+	}
+#endif
+	(void) force;
+	*name = "scalar";
+	return(hybridScalar);
+}
+
+///  instruction set of the kernel hybridBatch folds with these parameters
+const char* hybridKernelName(const struct hybrid_params *k){
+	return(k->kernel_name);
+}
+
+// parameters
+
+///  can the duplexes of fn3 be folded by hybridBatch with these model details
+/**
+ * The same as for hybridizeEnds: stems of the exterior loop do not compete for their neighbours (dangles 0 or 2), lonely pairs are allowed, no G-quadruplexes or circular RNAs.
+ */
+int hybridApplicable(const vrna_md_t *md){
+	return( (md->dangles == 0 || md->dangles == 2) && !md->noLP && !md->gquad && !md->circ );
+}
+
+///  lay out a set of energy parameters for hybridBatch
+/**
+ * @param[in] P Energy parameters, they have to outlive k
+ * @param[out] k The parameters of the kernel
+ */
+void initHybrid(const vrna_param_t *P, struct hybrid_params *k){
+	const vrna_md_t *md = &P->model_details;
+	const int dangles = md->dangles == 2;
+	memset(k, 0, sizeof(struct hybrid_params));
+	k->applicable = hybridApplicable(md);
+	k->P = P;
+	k->kernel = pickKernel(&k->kernel_name);
+
+	for(int type = 0; type <= NBPAIRS; ++type){
+		for(int x = 0; x < 6; ++x){
+			for(int y = 0; y < 6; ++y) k->ext[type][x][y] = type ? extStemEnergy(type, dangles && x ? x-1 : -1, dangles && y ? y-1 : -1, P) : 0;
+		}
+		k->au[type] = type > 2 ? P->TerminalAU : 0;
+	}
+
+	for(unsigned int n1 = 0; n1 <= MAXLOOP; ++n1){
+		for(unsigned int n2 = 0; n1 + n2 <= MAXLOOP; ++n2){
+			const unsigned int nl = n1 > n2 ? n1 : n2, ns = n1 > n2 ? n2 : n1;
+			unsigned char kind;
+			int e = 0;
+			if(!nl) kind = LOOP_STACK;
+			else if(!ns){
+				kind = nl == 1 ? LOOP_BULGE1 : LOOP_BULGE;
+				e = P->bulge[nl];
+			} else if(ns == 1 && nl == 1) kind = LOOP_INT11;
+			else if(ns == 1 && nl == 2) kind = n1 == 1 ? LOOP_INT21A : LOOP_INT21B;
+			else if(ns == 1){
+				kind = LOOP_INT1N;
+				e = P->internal_loop[nl+1] + ((int) (nl-ns) * P->ninio[2] < P->MAX_NINIO ? (int) (nl-ns) * P->ninio[2] : P->MAX_NINIO);
+			} else if(ns == 2 && nl == 2) kind = LOOP_INT22;
+			else if(ns == 2 && nl == 3){
+				kind = LOOP_INT23;
+				e = P->internal_loop[5] + P->ninio[2];
+			} else {
+				kind = LOOP_GENERIC;
+				e = P->internal_loop[nl+ns] + ((int) (nl-ns) * P->ninio[2] < P->MAX_NINIO ? (int) (nl-ns) * P->ninio[2] : P->MAX_NINIO);
+			}
+			k->kind[n1][n2] = kind;
+			k->loop[n1][n2] = e;
+		}
+	}
+}
+
+// workspace
+
+void initHybridWorkspace(struct hybrid_workspace *w){
+	memset(w, 0, sizeof(struct hybrid_workspace));
+}
+
+void freeHybridWorkspace(struct hybrid_workspace *w){
+	free(w->cells);
+	free(w->items);
+	free(w->bases);
+	initHybridWorkspace(w);
+}
+
+static int compareItems(const void *a, const void *b){
+	const struct hybrid_item *x = (const struct hybrid_item*) a, *y = (const struct hybrid_item*) b;
+	if(x->length1 != y->length1) return( x->length1 < y->length1 ? -1 : 1 );
+	if(x->length2 != y->length2) return( x->length2 < y->length2 ? -1 : 1 );
+	return( x->index < y->index ? -1 : (x->index > y->index) );
+}
+
+// the terms of every cell of a group of lanes, rna1 padded at its 5' end and rna2 at its 3' end to length1 x length2
+static void fillCells(char **rna1, char **rna2, const struct hybrid_item *items, const unsigned int lanes, const unsigned int length1, const unsigned int length2,
+		const struct hybrid_params *k, struct hybrid_workspace *w){
+	const vrna_param_t *P = k->P;
+	const vrna_md_t *md = &P->model_details;
+	const size_t stride = HYBRID_PLANES * HYBRID_LANES;
+	// bases of a lane with an empty one on either side, as indices of k->ext: 0 for none (padding), else the base + 1
+	unsigned char *s1 = w->bases, *s2 = w->bases + length1 + 2;
+
+	for(unsigned int l = 0; l < HYBRID_LANES; ++l){
+		memset(w->bases, 0, length1 + length2 + 4);
+		if(l < lanes){
+			const unsigned int offset = length1 - items[l].length1;
+			for(unsigned int a = 0; a < items[l].length1; ++a) s1[offset + a + 1] = encodeBase(rna1[items[l].index][a]) + 1;
+			for(unsigned int j = 0; j < items[l].length2; ++j) s2[j + 1] = encodeBase(rna2[items[l].index][j]) + 1;
+		}
+
+		for(unsigned int a = 0; a < length1; ++a){
+			// the base and its neighbours as encoded by RNAlib, no base as 0
+			const int sa = s1[a+1] ? s1[a+1] - 1 : 0, sa5 = s1[a] ? s1[a] - 1 : 0, sa3 = s1[a+2] ? s1[a+2] - 1 : 0;
+			for(unsigned int j = 0; j < length2; ++j){
+				const int sb = s2[j+1] ? s2[j+1] - 1 : 0, sb5 = s2[j] ? s2[j] - 1 : 0, sb3 = s2[j+2] ? s2[j+2] - 1 : 0;
+				const int type = md->pair[sa][sb], rtype = md->pair[sb][sa];
+				int32_t *c = w->cells + (a * length2 + j) * stride + l;
+#define SET(plane, x) (c[(plane) * HYBRID_LANES] = (x))
+				SET(HP_F, HYBRID_INF);
+				SET(HP_INIT, type ? P->DuplexInit + k->ext[type][s1[a]][s2[j+2]] : 0);
+				SET(HP_TINF, type ? 0 : HYBRID_INF);
+				SET(HP_CUT, rtype ? k->ext[rtype][s2[j]][s1[a+2]] : HYBRID_INF);
+				// (a,j) as the outer pair of a loop, with the mismatch a+1, j-1, as indices into the tables of the kernel
+				SET(HP_STACK_O, type * (NBPAIRS+1));
+				SET(HP_AU_O, k->au[type]);
+				SET(HP_M1N_O, P->mismatch1nI[type][sa3][sb5]);
+				SET(HP_M23_O, P->mismatch23I[type][sa3][sb5]);
+				SET(HP_MI_O, P->mismatchI[type][sa3][sb5]);
+				SET(HP_I11_O, type * (NBPAIRS+1) * 25 + sa3 * 5 + sb5);
+				SET(HP_I21A_O, type * (NBPAIRS+1) * 125 + sa3 * 25 + sb5);
+				SET(HP_I21B_O, type * 125 + sa3 * 5);
+				SET(HP_I22_O, type * (NBPAIRS+1) * 625 + sa3 * 125 + sb5);
+				// as the inner pair, (j,a) with the mismatch j+1, a-1
+				SET(HP_STACK_I, rtype);
+				SET(HP_AU_I, k->au[rtype]);
+				SET(HP_M1N_I, P->mismatch1nI[rtype][sb3][sa5]);
+				SET(HP_M23_I, P->mismatch23I[rtype][sb3][sa5]);
+				SET(HP_MI_I, P->mismatchI[rtype][sb3][sa5]);
+				SET(HP_I11_I, rtype * 25);
+				SET(HP_I21A_I, rtype * 125 + sb3 * 5);
+				SET(HP_I21B_I, rtype * (NBPAIRS+1) * 125 + sb3 * 25 + sa5);
+				SET(HP_I22_I, rtype * 625 + sa5 * 25 + sb3 * 5);
+#undef SET
+			}
+		}
+	}
+}
+
+///  MFE of many pairs of strands under the fn3 constraint, in SIMD lanes
+/**
+ * The pairs are sorted by their lengths and folded HYBRID_LANES at a time, each group padded to its longest strands. Energies are summed in dcal/mol as RNAlib does, so the result is the MFE of vrna_mfe_dimer under the fn3 constraint, if k->applicable. O(length1 * length2 * MAXLOOP^2) per group.
+ *
+ * @param[in] rna1 First strands
+ * @param[in] rna2 Second strands
+ * @param[in] n Number of pairs
+ * @param[in] k Parameters, see initHybrid
+ * @param[in] w Scratch memory of the calling thread
+ * @param[out] mfe MFE of every pair in kcal/mol, 0 where no duplex forms
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int hybridBatch(char **rna1, char **rna2, const size_t n, const struct hybrid_params *k, struct hybrid_workspace *w, float *mfe){
+	if(!k->applicable){
+		fprintf(stderr, "ERROR: hybridBatch: the model details do not allow the kernel\n");
+		return(0);
+	}
+	hybrid_kernel fold = k->kernel;
+
+	if(w->no_items < n){
+		struct hybrid_item *items = (struct hybrid_item*) realloc(w->items, n * sizeof(struct hybrid_item));
+		if(!items){
+			fprintf(stderr, "ERROR: hybridBatch: could not allocate %zu items\n", n);
+			return(0);
+		}
+		w->items = items;
+		w->no_items = n;
+	}
+	for(size_t i = 0; i < n; ++i){
+		w->items[i].length1 = strlen(rna1[i]);
+		w->items[i].length2 = strlen(rna2[i]);
+		w->items[i].index = i;
+	}
+	qsort(w->items, n, sizeof(struct hybrid_item), compareItems);
+
+	int32_t best[HYBRID_LANES] __attribute__((aligned(64)));
+	for(size_t g = 0; g < n; g += HYBRID_LANES){
+		const struct hybrid_item *items = w->items + g;
+		const unsigned int lanes = n - g < HYBRID_LANES ? n - g : HYBRID_LANES;
+		unsigned int length1 = items[lanes-1].length1, length2 = 0;
+		for(unsigned int l = 0; l < lanes; ++l) if(items[l].length2 > length2) length2 = items[l].length2;
+
+		const size_t cells = (size_t) length1 * length2, bases = length1 + length2 + 4;
+		if(w->no_cells < cells){
+			void *c = NULL;
+			if(posix_memalign(&c, 64, cells * HYBRID_PLANES * HYBRID_LANES * sizeof(int32_t))){
+				fprintf(stderr, "ERROR: hybridBatch: could not allocate cells of %u x %u\n", length1, length2);
+				return(0);
+			}
+			free(w->cells);
+			w->cells = (int32_t*) c;
+			w->no_cells = cells;
+		}
+		if(w->no_bases < bases){
+			unsigned char *b = (unsigned char*) realloc(w->bases, bases);
+			if(!b){
+				fprintf(stderr, "ERROR: hybridBatch: could not allocate bases of %u x %u\n", length1, length2);
+				return(0);
+			}
+			w->bases = b;
+			w->no_bases = bases;
+		}
+
+		fillCells(rna1, rna2, items, lanes, length1, length2, k, w);
+		fold(k, w->cells, length1, length2, best);
+		for(unsigned int l = 0; l < lanes; ++l) mfe[items[l].index] = best[l] / 100.0;
+	}
+	return(1);
+}
+
+// command line
+
+#define HYBRID_BATCH 65536
+#define HYBRID_CHUNK 1024 // pairs of a thread at a time
+
+int hybridMain(int argc, char** argv){
+	double temperature = 37.0;
+	const char *input = "-", *output = NULL;
+	int threads = 0;
+
+	int c;
+	while((c = getopt(argc, argv, "i:o:t:T:")) != -1){
+		switch(c){
+			case 'i': input = optarg; break;
+			case 'o': output = optarg; break;
+			case 't': threads = atoi(optarg); break;
+			case 'T': temperature = strtod(optarg, NULL); break;
+			default:
+				fprintf(stderr, "usage: %s [-i input] [-o output] [-t threads] [-T temperature]\n", argv[0]);
+				fprintf(stderr, "  input: rna1<TAB>rna2 lines, or FASTA entries of two strands\n");
+				fprintf(stderr, "  output lines: rna1<TAB>rna2<TAB>Eduplex, the MFE under the fn3 constraint\n");
+				return(1);
+		}
+	}
+	if(threads > 0) omp_set_num_threads(threads);
+
+	struct context ctx;
+	if(!initContext(temperature, &ctx)) return(1);
+	if(!ctx.hybrid.applicable) fprintf(stderr, "WARNING: hybridMain: the model details do not allow the kernel, folding one by one\n");
+	else fprintf(stderr, "hybrid: %s kernel\n", hybridKernelName(&ctx.hybrid));
+
+	struct reader r;
+	struct batch b;
+	FILE *out = output ? fopen(output, "w") : stdout;
+	char **rna1 = (char**) malloc(HYBRID_BATCH * sizeof(char*)), **rna2 = (char**) malloc(HYBRID_BATCH * sizeof(char*));
+	float *mfe = (float*) malloc(HYBRID_BATCH * sizeof(float));
+	if(!out) fprintf(stderr, "ERROR: could not open %s\n", output);
+	int error = !out || !rna1 || !rna2 || !mfe;
+	if(!error && !openReader(input, &r)) error = 1;
+	else if(!error && !initBatch(1 << 20, HYBRID_BATCH, &b)){
+		closeReader(&r);
+		error = 1;
+	}
+	if(error){
+		if(out && output) fclose(out);
+		free(rna1);
+		free(rna2);
+		free(mfe);
+		freeContext(&ctx);
+		return(1);
+	}
+
+	unsigned long int skipped = 0;
+	while(!error && fillBatch(&r, &b)){
+		size_t n = 0;
+		for(unsigned int i = 0; i < b.no_records; ++i){
+			const struct stream_record *rec = b.records + i;
+			if(rec->no_strands != 2){
+				++skipped;
+				continue;
+			}
+			rna1[n] = b.data + rec->strand[0];
+			rna2[n++] = b.data + rec->strand[1];
+		}
+
+		#pragma omp parallel for schedule(dynamic,1) reduction(|:error)
+		for(size_t from = 0; from < n; from += HYBRID_CHUNK){
+			const size_t count = n - from < HYBRID_CHUNK ? n - from : HYBRID_CHUNK;
+			if(!fn3Batch(rna1 + from, rna2 + from, count, mfe + from, &ctx)) error = 1;
+		}
+
+		for(size_t i = 0; i < n && !error; ++i) fprintf(out, "%s\t%s\t%.2f\n", rna1[i], rna2[i], mfe[i]);
+	}
+	if(skipped) fprintf(stderr, "WARNING: hybridMain: skipped %lu records without two strands\n", skipped);
+	if(r.skipped) fprintf(stderr, "WARNING: hybridMain: skipped %lu malformed records\n", r.skipped);
+
+	freeBatch(&b);
+	closeReader(&r);
+	if(output) fclose(out);
+	free(rna1);
+	free(rna2);
+	free(mfe);
+	freeContext(&ctx);
+	return(error);
+}
@@ -0,0 +1,945 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ViennaRNA/fold.h>
+#include <ViennaRNA/constraints/hard.h>
+#include <ViennaRNA/subopt/wuchty.h>
+#include <ViennaRNA/utils/basic.h>
+#include <ViennaRNA/utils/strings.h>
+#include "interaction.h"
+#include "probe.h"
+#include "ends.h"
+
+// context
+
+static void freeWorkspace(struct workspace *ws){
+	free(ws->constraint);
+	free(ws->concat);
+	free(ws->structure);
+	free(ws->key);
+	free(ws->ends);
+	free(ws->bound);
+	freeHybridWorkspace(&ws->hybrid);
+	freeEvaluator(&ws->eval);
+	freeCompiled(&ws->hc);
+	freeCompiled(&ws->hc_swap);
+	freeArena(&ws->arena);
+	free(ws);
+}
+
+///  init a folding context for a given temperature
+/**
+ * Model details and energy parameters are set up once here, instead of in every call of fn2, fn3, connect3 and fn4. The context can be shared between threads, every thread gets its own workspace on demand. Free it with freeContext.
+ *
+ * @param[in] temperature Temperature of binding in Celsius degrees
+ * @param[out] ctx The context to init
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int initContext(const double temperature, struct context *ctx){
+	/* create a new model details structure to store the Model Settings */
+	vrna_md_set_default(&ctx->md);
+	ctx->md.uniq_ML = 1; // keep stuff for suboptim
+	ctx->md.compute_bpp = 0; // sampling needs the partition function only
+	
+	// set temperature in celsius degrees. The default is 37 Celsius
+	ctx->md.temperature = temperature;
+
+	// scale energy parameters to the temperature
+	ctx->params = vrna_params(&ctx->md);
+	if(!ctx->params){
+		fprintf(stderr, "ERROR: initContext: could not get energy parameters!\n");
+		return(0);
+	}
+
+	ctx->workspaces = NULL;
+	ctx->cache = NULL;
+	ctx->table = NULL;
+	ctx->limits.top_k = 0; // no limits: every structure up to 0 kcal/mol
+	ctx->limits.window = -1;
+	ctx->limits.max_count = 0;
+	ctx->limits.samples = 0;
+	ctx->dot_bracket = 0;
+	ctx->ends = 0;
+	ctx->prefilter = 0;
+	initBound(ctx->params, &ctx->bound);
+	initHybrid(ctx->params, &ctx->hybrid);
+	if(pthread_key_create(&ctx->key, NULL) || pthread_mutex_init(&ctx->lock, NULL)){
+		fprintf(stderr, "ERROR: initContext: could not init thread data!\n");
+		free(ctx->params);
+		return(0);
+	}
+
+	return(1);
+}
+
+void freeContext(struct context *ctx){
+	while(ctx->workspaces){
+		struct workspace *next = ctx->workspaces->next;
+		freeWorkspace(ctx->workspaces);
+		ctx->workspaces = next;
+	}
+	pthread_key_delete(ctx->key);
+	pthread_mutex_destroy(&ctx->lock);
+	free(ctx->params);
+	ctx->params = NULL;
+}
+
+///  get the workspace of the calling thread
+/**
+ * @param[in] ctx The context
+ * @param[in] length Length of the longest string (without terminator) the caller will put in the buffers
+ *
+ * @return Workspace with buffers of at least length+1 chars, or NULL if memory could not be allocated.
+ */
+struct workspace* getWorkspace(struct context *ctx, const unsigned int length){
+	struct workspace *ws = (struct workspace*) pthread_getspecific(ctx->key);
+
+	if(!ws){
+		ws = (struct workspace*) calloc(1, sizeof(struct workspace));
+		if(!ws){
+			fprintf(stderr, "ERROR: getWorkspace: could not allocate workspace!\n");
+			return(NULL);
+		}
+		initArena(1 << 16, &ws->arena);
+		initHybridWorkspace(&ws->hybrid);
+		initCompiled(&ws->hc);
+		initCompiled(&ws->hc_swap);
+		pthread_setspecific(ctx->key, ws);
+
+		pthread_mutex_lock(&ctx->lock);
+		ws->next = ctx->workspaces;
+		ctx->workspaces = ws;
+		pthread_mutex_unlock(&ctx->lock);
+	}
+
+	if(ws->size < length+1){
+		// grow to the longest seen so far
+		char *constraint = (char*) realloc(ws->constraint, (length+1) * sizeof(char));
+		if(constraint) ws->constraint = constraint;
+		char *concat = (char*) realloc(ws->concat, (length+1) * sizeof(char));
+		if(concat) ws->concat = concat;
+		char *structure = (char*) realloc(ws->structure, (length+1) * sizeof(char));
+		if(structure) ws->structure = structure;
+		char *key = (char*) realloc(ws->key, cacheKeyLength(length) * sizeof(char));
+		if(key) ws->key = key;
+
+		if(!constraint || !concat || !structure || !key){
+			fprintf(stderr, "ERROR: getWorkspace: could not allocate buffers in size %d\n", length+1);
+			return(NULL);
+		}
+		ws->size = length+1;
+	}
+
+	return(ws);
+}
+
+///  get the arena of the calling thread
+/**
+ * Results of fn2, fn3 and connect3 are allocated here. They stay valid until the caller releases them all at once with resetArena, typically after every job.
+ */
+struct arena* getArena(struct context *ctx){
+	struct workspace *ws = getWorkspace(ctx, 0);
+	return( ws ? &ws->arena : NULL );
+}
+
+///  duplexes the prefilter of fn3 checked and rejected, summed over the threads
+void getPrefilterStats(struct context *ctx, struct prefilter_stats *stats){
+	stats->tested = stats->rejected = 0;
+	pthread_mutex_lock(&ctx->lock);
+	for(struct workspace *ws = ctx->workspaces; ws; ws = ws->next){
+		stats->tested += ws->prefilter.tested;
+		stats->rejected += ws->prefilter.rejected;
+	}
+	pthread_mutex_unlock(&ctx->lock);
+}
+
+void printPrefilterStats(struct context *ctx, FILE *out){
+	struct prefilter_stats stats;
+	getPrefilterStats(ctx, &stats);
+	fprintf(out, "prefilter: %lu of %lu duplexes rejected before folding (rejection rate %.3f)\n",
+			stats.rejected, stats.tested, stats.tested ? (double) stats.rejected / stats.tested : 0.0);
+}
+
+///  create a fold compound with the model details of the context
+vrna_fold_compound_t* newFoldCompound(const char *seq, struct context *ctx){
+	return( vrna_fold_compound(seq,
+                                   &ctx->md,//&(opt->md),
+                                   VRNA_OPTION_DEFAULT | VRNA_OPTION_HYBRID) );
+}
+
+// the suboptimal lists depend on the limits too
+static void appendLimitsKey(char *key, const struct subopt_limits *limits){
+	sprintf(key + strlen(key), ":%u/%d/%u/%u", limits->top_k, limits->window, limits->max_count, limits->samples);
+}
+
+///  fold a single RNA
+/**
+ * Same as vrna_fold, but with the model details of the context. Short sequences are looked up in the precomputed table of the context, others in the cache of the context if there is one.
+ *
+ * @param[in] seq Sequence of the RNA
+ * @param[out] structure MFE structure, has to have space for strlen(seq)+1 chars. If NULL no output will be written.
+ * @param[in] ctx Folding context (temperature, model details, workspaces, cache, table)
+ *
+ * @return MFE of the RNA
+ */
+float foldRNA(const char *seq, char *structure, struct context *ctx){
+	float mfe;
+	if(ctx->table && ctx->table->header->temperature == ctx->md.temperature && lookupTable(ctx->table, seq, &mfe, structure)) return(mfe);
+
+	const unsigned int length = strlen(seq);
+	struct workspace *ws = getWorkspace(ctx, length);
+	if(!ws) return(1.0);
+
+	if(ctx->cache){
+		char *cached = NULL;
+		cacheKey(ws->key, 'M', ctx->md.temperature, seq, NULL);
+		if(cacheGet(ctx->cache, ws->key, &ws->arena, &mfe, structure ? &cached : NULL, NULL)){
+			if(structure) strcpy(structure, cached);
+			return(mfe);
+		}
+	}
+
+	vrna_fold_compound_t *fc;
+	PROBE_TIME(STAGE_FOLD_COMPOUND, fc = vrna_fold_compound(seq, &ctx->md, VRNA_OPTION_DEFAULT));
+	if(!fc){
+		fprintf(stderr, "ERROR: foldRNA: could not create fold compound of %s\n", seq);
+		ws->error = 1;
+		return(1.0);
+	}
+	PROBE_TIME(STAGE_MFE, mfe = vrna_mfe(fc, ws->structure));
+	vrna_fold_compound_free(fc);
+
+	if(ctx->cache) cachePut(ctx->cache, ws->key, mfe, ws->structure, NULL);
+	if(structure) strcpy(structure, ws->structure);
+
+	return(mfe);
+}
+
+// constraints of the functions
+
+///  constraint of fn2: the left 5' and the right 3' dangling ends are sticky, the rest keeps its structure
+/**
+ * @param[in] left_str Structure of the left RNA
+ * @param[in] left_length Length of the left RNA
+ * @param[in] right_str Structure of the right RNA
+ * @param[in] right_length Length of the right RNA
+ * @param[out] constraint Buffer of left_length + right_length + 2 chars
+ *
+ * @return constraint
+ */
+char* fn2Constraint(const char *left_str, const unsigned int left_length, const char *right_str, const unsigned int right_length, char *constraint){
+	{ // left 5' dangling end
+		int i = left_length-1;
+		for(; i != -1 && left_str[i] == '.'; --i){
+			constraint[i] = 'e';
+		}
+		for(; i != -1; --i){
+			if(left_str[i] == '.') constraint[i] = 'x';
+			else constraint[i] = left_str[i];
+		}
+	}
+
+	constraint[left_length] = '&'; // separator
+
+	{ // right 3' dangling end 
+		unsigned int i = 0;
+		const unsigned int start = left_length+1;
+		for(; i != right_length && right_str[i] == '.'; ++i){
+			constraint[start+i] = 'e';
+		}
+		for(; i != right_length; ++i){
+			if(right_str[i] == '.') constraint[start+i] = 'x';
+			else constraint[start+i] = right_str[i];
+		}
+	}
+
+	constraint[left_length + right_length + 1] = '\0'; // do not forget about terminator character 
+	return(constraint);
+}
+
+///  constraint of fn3: both strands bind only in the exterior loop
+char* fn3Constraint(const unsigned int length1, const unsigned int length2, char *constraint){
+	const unsigned int length = length1 + length2 + 1;
+	memset(constraint, 'e', length);
+	constraint[length1]='&';
+	constraint[length]='\0';
+	return(constraint);
+}
+
+///  constraint of connect3: the duplex keeps its structure except its sticky ends, the single strand is all sticky
+/**
+ * @param[in] duplex_str Structure of the duplex, with separator
+ * @param[in] duplex1_length Length of the first member of the duplex
+ * @param[in] single_length Length of the single RNA
+ * @param[out] constraint Buffer of strlen(duplex_str) + single_length + 2 chars
+ *
+ * @return constraint
+ */
+char* connect3Constraint(const char *duplex_str, const unsigned int duplex1_length, const unsigned int single_length, char *constraint){
+	const unsigned int duplex_length = strlen(duplex_str);
+	const unsigned int constraint_length = duplex_length + single_length + 2;
+
+	strcpy(constraint, duplex_str);
+	constraint[duplex_length] = '&';
+	memset(constraint + duplex_length + 1, 'e', single_length);
+	constraint[constraint_length-1] = '\0';
+
+	// make ends sticky
+	makeStickyEnds(constraint, constraint + duplex1_length); // make sticky ends for the first part of the duplex
+	makeStickyEnds(constraint + duplex1_length + 1, constraint + duplex_length); // make sticky ends for the second part of the duplex
+							      //
+	// makeStickyEnds(constraint, end-1); // make sticky ends for the first part of the duplex
+	// makeStickyEnds(end+1, constraint + duplex_length -1); // make sticky ends for the second part of the duplex
+	// makeStickyEnds(constraint + duplex_length + 1, constraint + constraint_length - 1); // make single ends sticky
+
+	return(constraint);
+}
+
+///  constraint of fn4: the structure is enforced, unpaired bases stay unpaired
+char* fn4Constraint(const char *str, char *constraint){
+	strcpy(constraint, str);
+	for(char* base = constraint; *base != '\0'; ++base){
+		if(*base == '.') *base='x';
+	}
+	return(constraint);
+}
+
+// functions - you need this!
+
+///  binding left 5' dangling end to right 3' dangling end
+/**
+ * Function that computes the MFE of two RNA-s binding with their 5' and 3' ends. The first RNA binds with its 5' end to the 3' end of the second. Binding energy can be calculated with the substraction of structure MFEs from the MFE returned from this function. Please note, if you request the output of complex sequence and structure, those are allocated in the arena of the calling thread (getArena), and are released with it!
+ *
+ * With ctx->ends set (and endsApplicable) only the dangling ends are folded, around the monomer structures kept as they are, see hybridizeEnds. That costs the product of the end lengths instead of the cube of the complex.
+ *
+ * @param[in] left_seq Pointer to the sequence of the RNA, whose 5' dangling end assotiaties
+ * @param[in] left_str Pointer to the dot-bracket 2D structure of the RNA, whose 5' dangling end assotiaties.
+ * @param[in] right_seq Pointer to the sequence of the RNA, whose 3' dangling end assotiaties
+ * @param[in] right_str Pointer to the dot-bracket 2D structure of the RNA, whose 3' dangling end assotiaties.
+ * @param[out] compl_seq Sequence of the complex. If NULL no output will be written.
+ * @param[out] compl_str 2D stucture of the complex. If NULL no output will be written.
+ * @param[in] ctx Folding context (temperature, model details, workspaces)
+ *
+ * @return MFE of the composit. If it is positive, some error happened.
+ */
+double fn2(
+		char *left_seq, char *left_str,
+		char *right_seq, char *right_str,
+		char **compl_seq, char **compl_str,
+		struct context *ctx)
+{
+	const unsigned int left_length = strlen(left_seq), right_length = strlen(right_seq);
+
+	// init dynamic data
+	unsigned int constraint_length = left_length + right_length + 2;
+	struct workspace *ws = getWorkspace(ctx, constraint_length);
+	if( !ws ){
+		fprintf(stderr, "ERROR: Could not initialise arrays in size %d\n", constraint_length);
+		return(1.0);
+	}
+	char *constraint = ws->constraint;
+	char *concat     = ws->concat;
+	char *concatstr = ws->structure;
+	memset(concatstr, '\0', constraint_length);
+
+	// create concatenated string
+	strcpy(concat, left_seq);
+	concat[left_length] = '&';
+	strcpy(concat + left_length + 1, right_seq);
+	concat[constraint_length-1] = '\0';
+	if(compl_seq) *compl_seq = arenaStrdup(&ws->arena, concat);
+
+	// look it up, the constraint follows from the structures
+	float mfe;
+	const int ends = ctx->ends && endsApplicable(&ctx->md);
+	if(ctx->cache){
+		char *cached = NULL;
+		sprintf(constraint, "%s&%s", left_str, right_str);
+		cacheKey(ws->key, ends ? 'E' : 'B', ctx->md.temperature, concat, constraint);
+		if(cacheGet(ctx->cache, ws->key, &ws->arena, &mfe, compl_str ? &cached : NULL, NULL)){
+			if(compl_str) *compl_str = cached;
+			return(mfe);
+		}
+	}
+
+	if(ends){
+		// only the dangling ends are free, fold them alone
+		int ok;
+		PROBE_TIME(STAGE_MFE, ok = hybridizeEnds(concat, left_length, left_str, right_str, concatstr, &mfe, ctx));
+		if(!ok){
+			fprintf(stderr, "ERROR: fn2: could not fold the ends of %s&%s\n", left_str, right_str);
+			ws->error = 1;
+			return(1.0);
+		}
+	} else {
+		// create fold compound
+		vrna_fold_compound_t *fc;
+		PROBE_TIME(STAGE_FOLD_COMPOUND, fc = newFoldCompound(concat, ctx));
+
+		// add hard constraint
+		if(ctx->dot_bracket){
+			PROBE_TIME(STAGE_CONSTRAINT, fn2Constraint(left_str, left_length, right_str, right_length, constraint));
+			PROBE_TIME(STAGE_CONSTRAINTS_ADD, vrna_constraints_add(fc, constraint, FN2_CONSTRAINT));
+		} else {
+			int ok;
+			PROBE_TIME(STAGE_CONSTRAINT, ok = compileFn2(left_str, left_length, right_str, right_length, &ws->hc));
+			ws->hc_fn3[0] = ws->hc_fn3[1] = 0;
+			PROBE_TIME(STAGE_CONSTRAINTS_ADD, ok = ok && applyConstraint(fc, &ws->hc));
+			if(!ok){
+				fprintf(stderr, "ERROR: fn2: could not add constraint of %s&%s\n", left_str, right_str);
+				ws->error = 1;
+				vrna_fold_compound_free(fc);
+				return(1.0);
+			}
+		}
+	
+		// compute dimer structure
+		PROBE_TIME(STAGE_MFE, mfe = vrna_mfe_dimer(fc, concatstr));
+		vrna_fold_compound_free(fc);
+	}
+	PROBE_SIZE(SIZE_STRUCTURE, constraint_length - 1);
+      	
+	// get string with the separators
+	char *outstr = (char*) arenaAlloc(&ws->arena, constraint_length);
+	if(outstr){
+		if(ends) strcpy(outstr, concatstr); // hybridizeEnds keeps the separators
+		else PROBE_TIME(STAGE_CUT_POINTS, insertCutPoints(concat, concatstr, outstr));
+		if(ctx->cache) cachePut(ctx->cache, ws->key, mfe, outstr, NULL);
+	}
+
+	// write out structure
+	if(compl_str) *compl_str = outstr;
+
+	return(mfe);
+}
+
+float fn4(char *seq, char *str, struct context *ctx){
+	// create fold compound
+	vrna_fold_compound_t *fc;
+	PROBE_TIME(STAGE_FOLD_COMPOUND, fc = newFoldCompound(seq, ctx));
+
+	// alloc space for modified constraint
+	const unsigned int length = strlen(seq);
+	struct workspace *ws = getWorkspace(ctx, length);
+	if(!ws){
+		vrna_fold_compound_free(fc);
+		return(1.0);
+	}
+	// tell them binding has to be external binding
+	if(ctx->dot_bracket){
+		char *constraint;
+		PROBE_TIME(STAGE_CONSTRAINT, constraint = fn4Constraint(str, ws->constraint));
+		PROBE_TIME(STAGE_CONSTRAINTS_ADD, vrna_constraints_add(fc, constraint, FN4_CONSTRAINT));
+	} else {
+		int ok;
+		PROBE_TIME(STAGE_CONSTRAINT, ok = compileFn4(str, &ws->hc));
+		ws->hc_fn3[0] = ws->hc_fn3[1] = 0;
+		PROBE_TIME(STAGE_CONSTRAINTS_ADD, ok = ok && applyConstraint(fc, &ws->hc));
+		if(!ok){
+			fprintf(stderr, "ERROR: fn4: could not add constraint %s\n", str);
+			ws->error = 1;
+			vrna_fold_compound_free(fc);
+			return(1.0);
+		}
+	}
+
+	// compute dimer structure
+	// char *estr= (char*) calloc(length+1, sizeof(char));
+	// float mfe = vrna_mfe_dimer(fc, estr);
+	// printf("%s (%f)\n", estr, mfe);
+	// free(estr);
+
+	float mfe;
+	PROBE_TIME(STAGE_MFE, mfe = vrna_mfe_dimer(fc, NULL));
+	PROBE_SIZE(SIZE_STRUCTURE, length);
+	
+	// free
+	vrna_fold_compound_free(fc);
+
+	return( mfe );
+}
+
+// fold compound of rna1&rna2 in ws->concat with the constraint of fn3, NULL on error
+static vrna_fold_compound_t* fn3Compound(const char *concatenated, const unsigned int length1, const unsigned int length2, struct workspace *ws, struct context *ctx){
+	vrna_fold_compound_t *fc;
+	PROBE_TIME(STAGE_FOLD_COMPOUND, fc = newFoldCompound(concatenated, ctx));
+
+	// tell them binding has to be external binding
+	if(ctx->dot_bracket){
+		char* constraint;
+		PROBE_TIME(STAGE_CONSTRAINT, constraint = fn3Constraint(length1, length2, ws->constraint));
+		PROBE_TIME(STAGE_CONSTRAINTS_ADD, vrna_constraints_add(fc, constraint, FN3_CONSTRAINT));
+	} else {
+		// the same for every pair of strands of these lengths
+		int ok = ws->hc_fn3[0] == length1 && ws->hc_fn3[1] == length2;
+		if(!ok){
+			PROBE_TIME(STAGE_CONSTRAINT, ok = compileFn3(length1, length2, &ws->hc));
+			ws->hc_fn3[0] = ok ? length1 : 0;
+			ws->hc_fn3[1] = ok ? length2 : 0;
+		}
+		PROBE_TIME(STAGE_CONSTRAINTS_ADD, ok = ok && applyConstraint(fc, &ws->hc));
+		if(!ok){
+			fprintf(stderr, "ERROR: fn3: could not add constraint of %s\n", concatenated);
+			ws->error = 1;
+			vrna_fold_compound_free(fc);
+			return(NULL);
+		}
+	}
+	return(fc);
+}
+
+vrna_subopt_solution_t* fn3(char *rna1, char *rna2, struct context *ctx){
+	// concatenated string in the workspace of the thread
+	const unsigned int length1=strlen(rna1), length2=strlen(rna2);
+	const unsigned int length=length1+length2+1;
+	
+	struct workspace *ws = getWorkspace(ctx, length);
+	if(!ws){
+		fprintf(stderr, "could not allocate memory is size sizeof(char) * %d\n", length+1);
+		return(NULL);
+	}
+	char *concatenated = ws->concat;
+	char *cstr = ws->structure; // while the doc says that it does not need it, vrna_dimer still uses this memory
+	strcpy(concatenated, rna1);
+	concatenated[length1] = '&';
+	strcpy(concatenated + length1 + 1, rna2);	
+
+	// no duplex if even the bound of its energy is not negative, see duplexBound
+	if(ctx->prefilter && ctx->bound.applicable){
+		const size_t cells = (size_t) length1 * length2;
+		if(ws->bound_size < 2*cells){
+			int *tables = (int*) realloc(ws->bound, 2 * cells * sizeof(int));
+			if(!tables){
+				fprintf(stderr, "ERROR: fn3: could not allocate tables of %u x %u\n", length1, length2);
+				ws->error = 1;
+				return(NULL);
+			}
+			ws->bound = tables;
+			ws->bound_size = 2*cells;
+		}
+		++ws->prefilter.tested;
+		if(duplexBound(rna1, length1, rna2, length2, &ctx->bound, ctx->params, ws->bound) >= 0){
+			++ws->prefilter.rejected;
+			return(NULL);
+		}
+	}
+
+	// look it up, the constraint follows from the lengths
+	vrna_subopt_solution_t *subopts = NULL;
+	if(ctx->cache){
+		cacheKey(ws->key, 'D', ctx->md.temperature, concatenated, NULL);
+		appendLimitsKey(ws->key, &ctx->limits);
+		if(cacheGet(ctx->cache, ws->key, &ws->arena, NULL, NULL, &subopts)) return(subopts);
+	}
+
+	// create fold compound, binding has to be external binding
+	vrna_fold_compound_t *fc = fn3Compound(concatenated, length1, length2, ws, ctx);
+	if(!fc) return(NULL);
+
+	// compute dimer structure
+	float mfe;
+	PROBE_TIME(STAGE_MFE, mfe = vrna_mfe_dimer(fc, cstr));
+	PROBE_SIZE(SIZE_STRUCTURE, length);
+	if(mfe >= 0.0) {
+		vrna_fold_compound_free(fc);
+		if(ctx->cache) cachePut(ctx->cache, ws->key, mfe, NULL, NULL);
+		return(NULL);
+	}
+
+	// collect suboptimal structures, up to 0 kcal/mol within the limits of the context, or draw a fixed number of them
+	PROBE_TIME(STAGE_SUBOPT, subopts = ctx->limits.samples ? sampledSubopt(fc, mfe, &ctx->limits, &ws->arena) : boundedSubopt(fc, mfe, &ctx->limits, &ws->arena));
+	PROBE_SIZE(SIZE_SUBOPT, countLength(subopts));
+
+	// free
+	vrna_fold_compound_free(fc);
+
+	if(ctx->cache) cachePut(ctx->cache, ws->key, mfe, NULL, subopts);
+
+	return( subopts );
+}
+
+///  MFE of many duplexes under the constraint of fn3
+/**
+ * The same MFE as the duplexes of fn3, without their structures and suboptimal lists. If the model details of the context allow it (see hybridApplicable) the duplexes are folded in SIMD lanes by hybridBatch, else one by one by RNAlib. Neither the cache nor the prefilter of the context is used.
+ *
+ * @param[in] rna1 First strands
+ * @param[in] rna2 Second strands
+ * @param[in] n Number of pairs of strands
+ * @param[out] mfe MFE of every pair in kcal/mol, 0 where no duplex forms
+ * @param[in] ctx The context
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int fn3Batch(char **rna1, char **rna2, const size_t n, float *mfe, struct context *ctx){
+	struct workspace *ws = getWorkspace(ctx, 0);
+	if(!ws) return(0);
+	if(ctx->hybrid.applicable) return( hybridBatch(rna1, rna2, n, &ctx->hybrid, &ws->hybrid, mfe) );
+
+	for(size_t i = 0; i < n; ++i){
+		const unsigned int length1 = strlen(rna1[i]), length2 = strlen(rna2[i]);
+		ws = getWorkspace(ctx, length1 + length2 + 1);
+		if(!ws) return(0);
+		strcpy(ws->concat, rna1[i]);
+		ws->concat[length1] = '&';
+		strcpy(ws->concat + length1 + 1, rna2[i]);
+
+		vrna_fold_compound_t *fc = fn3Compound(ws->concat, length1, length2, ws, ctx);
+		if(!fc) return(0);
+		const float e = vrna_mfe_dimer(fc, ws->structure);
+		vrna_fold_compound_free(fc);
+		mfe[i] = e < 0.0 ? e : 0.0;
+	}
+	return(1);
+}
+
+void freeSubopt(vrna_subopt_solution_t *l){
+      	for (unsigned int i = 0; l[i].structure; i++) free(l[i].structure);
+	free(l);
+}
+
+///  move a suboptimal list into an arena
+/**
+ * @param[in] l List allocated by ViennaRNA, it is freed
+ * @param[in] a The arena
+ *
+ * @return The list in the arena, or NULL if l was NULL or the arena could not grow.
+ */
+vrna_subopt_solution_t* arenaSubopt(vrna_subopt_solution_t *l, struct arena *a){
+	if(!l) return(NULL);
+
+	unsigned int n = 0;
+	while(l[n].structure) ++n;
+
+	vrna_subopt_solution_t *copy = (vrna_subopt_solution_t*) arenaAlloc(a, (n+1) * sizeof(vrna_subopt_solution_t));
+	if(copy){
+		for(unsigned int i = 0; i < n; ++i){
+			copy[i].energy = l[i].energy;
+			copy[i].structure = arenaStrdup(a, l[i].structure);
+			if(!copy[i].structure){
+				copy = NULL;
+				break;
+			}
+		}
+	}
+	if(copy){
+		copy[n].energy = 0.0;
+		copy[n].structure = NULL;
+	}
+
+	freeSubopt(l);
+	return(copy);
+}
+
+///  write a structure with the strand separators of its sequence
+/**
+ * @param[in] seq Sequence of the complex, strands separated by '&'
+ * @param[in] structure Structure without separators, as written by vrna_mfe_dimer
+ * @param[out] out Buffer of strlen(seq)+1 chars
+ *
+ * @return out
+ */
+char* insertCutPoints(const char *seq, const char *structure, char *out){
+	char *o = out;
+	for(; *seq; ++seq, ++o){
+		*o = (*seq == '&') ? '&' : *structure++;
+	}
+	*o = '\0';
+	return(out);
+}
+
+unsigned int countLength(vrna_subopt_solution_t* x){
+	if(!x) return(0);
+	unsigned int length=0;
+	while(x[length].structure && x[length].energy<0.0) {++length;}
+	return(length);
+}
+
+void makeStickyEnds(char* begin, char* end){
+	if(!begin || !end || begin >= end) {
+		fprintf(stderr, "ERROR: non valid begin and end pointers supplied for makeStickyEnds!\n");
+		return;
+	}
+
+	char *c = begin; // iterator from first char
+	// 3' dangling end 
+	for(; c != end && *c == '.'; ++c){
+		*c = 'e';
+	}
+	
+	if(c != end){
+		char *e = end-1; // iterator from last char
+		// 5' dangling end
+		for(; *e == '.'; --e){ // no need to guard begin, as there is structure in the beginning
+			*e = 'e';
+		}
+
+		// inner part
+		for(; c != e; ++c){
+			if(*c == '.') *c = 'x';
+		}
+	}
+
+}
+
+// fold the triplex in ws->concat, whose duplex part has the structure duplex_str; the constraint is compiled from it if hc is NULL
+static vrna_subopt_solution_t* foldTriplex(
+		struct workspace *ws,
+		const char *duplex_str,
+		const unsigned int duplex1_length,
+		const unsigned int single_length,
+		struct compiled_constraint *hc,
+		struct context *ctx)
+{
+	const char *concat = ws->concat;
+
+	// look it up, the constraint follows from the structure of the duplex
+	vrna_subopt_solution_t *subopts = NULL;
+	if(ctx->cache){
+		cacheKey(ws->key, 'T', ctx->md.temperature, concat, duplex_str);
+		appendLimitsKey(ws->key, &ctx->limits);
+		if(cacheGet(ctx->cache, ws->key, &ws->arena, NULL, NULL, &subopts)) return(subopts);
+	}
+
+	// create fold compound
+	vrna_fold_compound_t *fc;
+	PROBE_TIME(STAGE_FOLD_COMPOUND, fc = newFoldCompound(concat, ctx));
+
+	// add hard constraint with sticky ends
+	if(ctx->dot_bracket){
+		PROBE_TIME(STAGE_CONSTRAINT, connect3Constraint(duplex_str, duplex1_length, single_length, ws->constraint));
+		PROBE_TIME(STAGE_CONSTRAINTS_ADD, vrna_constraints_add(fc, ws->constraint, CONNECT3_CONSTRAINT));
+	} else {
+		int ok = 1;
+		if(!hc){
+			PROBE_TIME(STAGE_CONSTRAINT, ok = compileConnect3(duplex_str, duplex1_length, single_length, &ws->hc));
+			ws->hc_fn3[0] = ws->hc_fn3[1] = 0;
+			hc = &ws->hc;
+		}
+		PROBE_TIME(STAGE_CONSTRAINTS_ADD, ok = ok && applyConstraint(fc, hc));
+		if(!ok){
+			fprintf(stderr, "ERROR: connect3: could not add constraint of %s\n", duplex_str);
+			ws->error = 1;
+			vrna_fold_compound_free(fc);
+			return(NULL);
+		}
+	}
+	
+	// compute dimer structure
+	float mfe;
+	PROBE_TIME(STAGE_MFE, mfe = vrna_mfe_dimer(fc, NULL));
+	PROBE_SIZE(SIZE_STRUCTURE, strlen(concat));
+	if(mfe >= 0.0) {
+		vrna_fold_compound_free(fc);
+		if(ctx->cache) cachePut(ctx->cache, ws->key, mfe, NULL, NULL);
+		return(NULL);
+	}
+      	
+	// collect suboptimal structures, up to 0 kcal/mol within the limits of the context, or draw a fixed number of them
+	PROBE_TIME(STAGE_SUBOPT, subopts = ctx->limits.samples ? sampledSubopt(fc, mfe, &ctx->limits, &ws->arena) : boundedSubopt(fc, mfe, &ctx->limits, &ws->arena));
+	PROBE_SIZE(SIZE_SUBOPT, countLength(subopts));
+
+	// free stuff
+	vrna_fold_compound_free(fc);
+
+	if(ctx->cache) cachePut(ctx->cache, ws->key, mfe, NULL, subopts);
+
+	return( subopts );
+}
+
+///  binding a single sequence to the 4 possible dangling ends of a cofolded duplex
+/**
+ * Function that computes the MFE of a duplex and a simplex RNA-s binding with their 5' and 3' ends. In this orientation the single strand follows the second member of the duplex, so it can reach the 3' end of duplex2 and the 5' end of duplex1; see connect3Ends for the other two. Binding energy can be calculated with the substraction of structure MFEs from the MFE returned from this function. Please note, the returned list is allocated in the arena of the calling thread (getArena), and is released with it!
+ *
+ * @param[in] duplex1_seq Pointer to the sequence of the first member of the cofolded duplex RNA
+ * @param[in] duplex2_seq Pointer to the sequence of the second member of the cofolded duplex RNA
+ * @param[in] duplex_str Pointer to the dot-bracket 2D structure of the duplex RNA
+ * @param[in] single_seq Pointer to the sequence of the unfolded, single RNA
+ * @param[in] ctx Folding context (temperature, model details, workspaces)
+ *
+ * @return MFE of the composit. If it is positive, some error happened.
+ */
+vrna_subopt_solution_t* connect3(
+		char *duplex1_seq, 
+		char *duplex2_seq, 
+		char *duplex_str,
+		char *single_seq,
+		struct context *ctx
+)
+{
+	const unsigned int duplex1_length = strlen(duplex1_seq);
+	const unsigned int duplex_length = strlen(duplex_str);
+	const unsigned int single_length = strlen(single_seq);
+
+	// init dynamic data
+	const unsigned int constraint_length = duplex_length + single_length + 2;
+	struct workspace *ws = getWorkspace(ctx, constraint_length);
+	if( !ws ){
+		fprintf(stderr, "ERROR: Could not initialise arrays in size %d\n", constraint_length);
+		return(NULL);
+	}
+	char *concat     = ws->concat;
+
+	// create concatenated string
+	strcpy(concat, duplex1_seq);
+	concat[duplex1_length] = '&';
+	strcpy(concat + duplex1_length + 1, duplex2_seq);
+	concat[duplex_length] = '&';
+	strcpy(concat + duplex_length + 1, single_seq);
+	concat[constraint_length-1] = '\0';
+
+	return( foldTriplex(ws, duplex_str, duplex1_length, single_length, NULL, ctx) );
+}
+
+// ends of the duplex strands (end flags in ends, 5' and 3' of each) the single strand of a triplex pairs with
+static unsigned int boundEnds(const char *structure, const char *duplex_str, const unsigned int length1, const unsigned int length2, const unsigned int ends[4], struct arena *a){
+	// sticky spans of the duplex strands, in the order of the structure
+	const unsigned int length[2] = {length1, length2};
+	const char *str[2] = {duplex_str, duplex_str + length1 + 1};
+	unsigned int head[2], tail[2];
+	for(unsigned int s = 0; s < 2; ++s){
+		for(head[s] = 0; head[s] < length[s] && str[s][head[s]] == '.'; ++head[s]);
+		for(tail[s] = 0; tail[s] < length[s] && str[s][length[s]-1-tail[s]] == '.'; ++tail[s]);
+	}
+
+	unsigned int *stack = (unsigned int*) arenaAlloc(a, strlen(structure) * sizeof(unsigned int));
+	if(!stack) return(0);
+
+	// the single strand is the last one, so it closes the pairs it has with the duplex
+	unsigned int bound = 0, depth = 0, pos = 0;
+	for(const char *c = structure; *c; ++c){
+		if(*c == '&') continue;
+		if(*c == '(') stack[depth++] = pos;
+		else if(*c == ')' && depth){
+			const unsigned int i = stack[--depth];
+			if(i < length1 + length2 && pos >= length1 + length2){
+				const unsigned int s = i < length1 ? 0 : 1, k = s ? i - length1 : i;
+				if(k < head[s]) bound |= ends[2*s];
+				if(k >= length[s] - tail[s]) bound |= ends[2*s+1];
+			}
+		}
+		++pos;
+	}
+	return(bound);
+}
+
+///  binding a single sequence to all 4 dangling ends of a cofolded duplex in one call
+/**
+ * The single strand is folded after the duplex in both orders of its strands: duplex1&duplex2&single reaches the 3' end of duplex2 and the 5' end of duplex1, duplex2&duplex1&single the other two. The strand layout and the compiled constraint are made once, the constraint of the second order is a permutation of the first, and both orders share the cache with connect3. Everything is allocated in the arena of the calling thread (getArena).
+ *
+ * @param[in] duplex1_seq Sequence of the first member of the cofolded duplex RNA
+ * @param[in] duplex2_seq Sequence of the second member of the cofolded duplex RNA
+ * @param[in] duplex_str Dot-bracket 2D structure of the duplex RNA, with separator
+ * @param[in] single_seq Sequence of the single RNA
+ * @param[out] res Suboptimal triplexes of both orders, and the best one for every end
+ * @param[in] ctx Folding context (temperature, model details, workspaces)
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int connect3Ends(
+		char *duplex1_seq,
+		char *duplex2_seq,
+		char *duplex_str,
+		char *single_seq,
+		struct triplex_ends *res,
+		struct context *ctx)
+{
+	const unsigned int length1 = strlen(duplex1_seq), length2 = strlen(duplex2_seq), length3 = strlen(single_seq);
+	const unsigned int length = length1 + length2 + length3 + 2;
+
+	memset(res, 0, sizeof(struct triplex_ends));
+	res->best = -1;
+	if(strlen(duplex_str) != length1 + length2 + 1 || duplex_str[length1] != '&'){
+		fprintf(stderr, "ERROR: connect3Ends: %s is not a structure of %s&%s\n", duplex_str, duplex1_seq, duplex2_seq);
+		return(0);
+	}
+
+	struct workspace *ws = getWorkspace(ctx, length);
+	if(!ws) return(0);
+
+	// both orders of the duplex, sequences and structures
+	char *seq[2], *str[2];
+	seq[0] = (char*) arenaAlloc(&ws->arena, length+1);
+	seq[1] = (char*) arenaAlloc(&ws->arena, length+1);
+	str[1] = (char*) arenaAlloc(&ws->arena, length1 + length2 + 2);
+	if(!seq[0] || !seq[1] || !str[1]){
+		fprintf(stderr, "ERROR: connect3Ends: could not allocate strands of %u nt\n", length);
+		return(0);
+	}
+	str[0] = duplex_str;
+	sprintf(seq[0], "%s&%s&%s", duplex1_seq, duplex2_seq, single_seq);
+	sprintf(seq[1], "%s&%s&%s", duplex2_seq, duplex1_seq, single_seq);
+	memcpy(str[1], duplex_str + length1 + 1, length2);
+	str[1][length2] = '&';
+	memcpy(str[1] + length2 + 1, duplex_str, length1);
+	str[1][length1 + length2 + 1] = '\0';
+
+	// the constraint of the second order is the first one with the duplex strands swapped
+	struct compiled_constraint *hc[2] = {NULL, NULL};
+	if(!ctx->dot_bracket){
+		const unsigned int swap[3] = {1, 0, 2};
+		int ok;
+		PROBE_TIME(STAGE_CONSTRAINT, ok = compileConnect3(duplex_str, length1, length3, &ws->hc) && permuteStrands(&ws->hc, swap, &ws->hc_swap));
+		ws->hc_fn3[0] = ws->hc_fn3[1] = 0;
+		if(!ok){
+			fprintf(stderr, "ERROR: connect3Ends: could not compile constraint of %s\n", duplex_str);
+			return(0);
+		}
+		hc[0] = &ws->hc;
+		hc[1] = &ws->hc_swap;
+	}
+
+	// end flags of the strands in the order of each orientation
+	const unsigned int ends[2][4] = {
+		{TRIPLEX_END1_5, TRIPLEX_END1_3, TRIPLEX_END2_5, TRIPLEX_END2_3},
+		{TRIPLEX_END2_5, TRIPLEX_END2_3, TRIPLEX_END1_5, TRIPLEX_END1_3}
+	};
+	const unsigned int first_length[2] = {length1, length2};
+
+	for(unsigned int o = 0; o < 2; ++o){
+		struct triplex_orientation *t = res->orientation + o;
+		t->seq = seq[o];
+		strcpy(ws->concat, seq[o]);
+		t->triplexes = foldTriplex(ws, str[o], first_length[o], length3, hc[o], ctx);
+
+		// the best triplex of every end the single strand binds to
+		const unsigned int n = countLength(t->triplexes);
+		for(unsigned int i = 0; i < n; ++i){
+			const unsigned int bound = boundEnds(t->triplexes[i].structure, str[o], first_length[o], first_length[!o], ends[o], &ws->arena);
+			if(!i) t->ends = bound;
+			for(unsigned int e = 0; e < 4; ++e){
+				if(!(bound & (1U << e)) || (res->structure[e] && res->energy[e] <= t->triplexes[i].energy)) continue;
+				res->energy[e] = t->triplexes[i].energy;
+				res->structure[e] = t->triplexes[i].structure;
+				res->end_orientation[e] = o;
+			}
+		}
+		if(n && (res->best < 0 || t->triplexes[0].energy < res->orientation[res->best].triplexes[0].energy)) res->best = o;
+	}
+
+	return(1);
+}
+
+char* invertSeq(char* str, struct context *ctx){
+	unsigned int length = strlen(str); // length of the sequence with separator (length1 + length2 + 1)
+	struct workspace *ws = getWorkspace(ctx, length);
+	if(!ws){
+		fprintf(stderr, "invertSeq: Could not allocate memory!\n");
+		return(NULL);
+	}
+	char *newseq = ws->concat;
+
+	// find & separating first and second part of duplex - if it has none it is undefined behaviour!
+	unsigned int sep = 0; // there wont be a separator at the 0th position (assumably...)
+	while(str[++sep] != '&');
+	const unsigned int length2 = length - sep - 1; // length of second part (length1 = sep)
+
+	strcpy(newseq, str + sep + 1); // copy second part
+	newseq[length2] = '&'; // write separator
+	memcpy(newseq + length2 + 1, str, sep); // copy first part
+	newseq[length] = '\0';
+
+	strcpy(str, newseq); // copy back original
+
+	return(str);
+}
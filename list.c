@@ -1,392 +1,389 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <ViennaRNA/fold.h>
 #include <ViennaRNA/subopt/wuchty.h>  
-#include <ViennaRNA/utils/basic.h>
-#include <ViennaRNA/utils/strings.h>
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_randist.h>
-
-gsl_rng * r;
-float fn4(char *seq, char *str, double temperature){
-	/* create a new model details structure to store the Model Settings */
-	vrna_md_t md;
-	vrna_md_set_default(&md); 
-	
-	// set temperature in celsius degrees. The default is 37 Celsius
-	md.temperature = temperature;
-	
-	// create fold compound
-	vrna_fold_compound_t *fc = vrna_fold_compound(seq,
-                                                &md,//&(opt->md),
-                                                VRNA_OPTION_DEFAULT | VRNA_OPTION_HYBRID);
-
-	// alloc space for modified constraint
-	const unsigned int length = strlen(seq);
-	char *constraint = (char*) calloc(length+1, sizeof(char));
-	strcpy(constraint, str);
-	for(char* base = constraint; *base != '\0'; ++base){
-		if(*base == '.') *base='x';
-	}
-
-	// tell them binding has to be external binding
-	vrna_constraints_add(fc, constraint,
-			//VRNA_CONSTRAINT_DB | 
-			VRNA_CONSTRAINT_DB_X | 
-			VRNA_CONSTRAINT_DB_INTERMOL |
-			//VRNA_CONSTRAINT_DB_INTRAMOL |
-			VRNA_CONSTRAINT_DB_DEFAULT |
-			VRNA_CONSTRAINT_DB_ENFORCE_BP |
-			VRNA_CONSTRAINT_DB_PIPE
-			);
-
-	// compute dimer structure
-	// char *estr= (char*) calloc(length+1, sizeof(char));
-	// float mfe = vrna_mfe_dimer(fc, estr);
-	// printf("%s (%f)\n", estr, mfe);
-	// free(estr);
-
-	float mfe = vrna_mfe_dimer(fc, NULL);
-	
-	// free
-	vrna_fold_compound_free(fc);
-	free(constraint);
-
-	return( mfe );
-}
-vrna_subopt_solution_t* fn3(char *rna1, char *rna2, const double temperature){
-	// dynamic allocation for concatenated string
-	const unsigned int length1=strlen(rna1), length2=strlen(rna2);
-	const unsigned int length=length1+length2+1;
+#include <getopt.h>
+#include <omp.h>
+#include "interaction.h"
+#include "pool.h"
+#include "sweep.h"
+#include "stream.h"
+#include "results.h"
+#include "energy.h"
+#include "assembly.h"
+#include "shard.h"
+#include "endindex.h"
+#include "server.h"
+#include "hybrid.h"
+#include "summary.h"
+
+char* getRandomSeq(gsl_rng *r, unsigned int length, struct arena *a){
+	const char bases[4] = {'A', 'U', 'G', 'C'};
+	char *seq = (char*) arenaAlloc(a, (length+1) * sizeof(char));
 	
-	char *concatenated = (char*) calloc(length+1, sizeof(char));
-	if(!concatenated){
-		printf("could not allocate memory is size sizeof(char) * %d\n", length+1);
-		return(NULL);
-	}
-	char *cstr = (char*) calloc(length+1, sizeof(char)); // while the doc says that it does not need it, vrna_dimer still uses this memory
-	if(!cstr){
-		printf("could not allocate memory is size sizeof(char) * %d\n", length+1);
-		free(concatenated);
-		return(NULL);
-	}
-	strcpy(concatenated, rna1);
-	concatenated[length1] = '&';
-	strcat(concatenated + length1 + 1, rna2);	
-
-	/* initialize random number generator */
-	vrna_init_rand();
-
-	char* constraint = (char*) calloc(length+1, sizeof(char));
-	if(!constraint){
-		printf("could not allocate memory is size sizeof(char) * %d\n", length+1);
-		free(concatenated);
-		free(cstr);
+	if(!seq) {
+		fprintf(stderr, "Could not allocate memory for sequence of length %d.\n", length);
 		return(NULL);
 	}
 	
-	// create constraint
-	memset(constraint, 'e', length);
-	constraint[length1]='&';
-
-	//printf("%s\n", constraint);
-	//printf("%s\n", concatenated);
-
-	/* create a new model details structure to store the Model Settings */
-	vrna_md_t md;
-	vrna_md_set_default(&md); 
-	md.uniq_ML = 1; // keep stuff for suboptim
-	
-	// set temperature in celsius degrees. The default is 37 Celsius
-	md.temperature = temperature;
-	
-	// create fold compound
-	vrna_fold_compound_t *fc = vrna_fold_compound(concatenated,
-                                                &md,//&(opt->md),
-                                                VRNA_OPTION_DEFAULT | VRNA_OPTION_HYBRID);
-
-	// tell them binding has to be external binding
-	vrna_constraints_add(fc, constraint,
-			//VRNA_CONSTRAINT_DB | 
-			VRNA_CONSTRAINT_DB_X | 
-			VRNA_CONSTRAINT_DB_INTERMOL |
-			//VRNA_CONSTRAINT_DB_INTRAMOL |
-			VRNA_CONSTRAINT_DB_DEFAULT |
-			VRNA_CONSTRAINT_DB_ENFORCE_BP |
-			VRNA_CONSTRAINT_DB_PIPE
-			);
-
-	// compute dimer structure
-	float mfe = vrna_mfe_dimer(fc, cstr);
-	if(mfe >= 0.0) {
-		vrna_fold_compound_free(fc);
-		free(constraint);
-		free(concatenated);
-		free(cstr);
-		return(NULL);
-	}
-
-	// collect suboptimal structures
-	int delta = (int)(-mfe*100.0)+1; // the range of subopt structures calculated around the optimal: delta * 0.01 kcal/mol 
-	vrna_subopt_solution_t *subopts = vrna_subopt(fc, delta, 1, NULL); 
-
-	// free
-	vrna_fold_compound_free(fc);
-	free(constraint);
-	free(concatenated);
-	free(cstr);
-
-	return( subopts );
-}
+	seq[length] = '\0';
+	while(length){seq[--length] = bases[gsl_rng_uniform_int(r, 4)];}
 
-void freeSubopt(vrna_subopt_solution_t *l){
-      	for (unsigned int i = 0; l[i].structure; i++) free(l[i].structure);
-	free(l);
+	return(seq);
 }
 
-unsigned int countLength(vrna_subopt_solution_t* x){
-	if(!x) return(0);
-	unsigned int length=0;
-	while(x[length].structure && x[length].energy<0.0) {++length;}
-	return(length);
+/// derive the seed of one iteration of the screening loop
+/**
+ * Every iteration gets its own random stream, seeded from the run seed and the index of the iteration (splitmix64 finaliser). This way the rows do not depend on which thread computed them, so a run is the same with any number of threads.
+ *
+ * @param[in] seed Seed of the whole run
+ * @param[in] iteration Index of the iteration
+ *
+ * @return Seed for the random stream of the iteration
+ */
+unsigned long int screenSeed(const unsigned long int seed, const unsigned long int iteration){
+	unsigned long long int z = (unsigned long long int) seed + 0x9E3779B97F4A7C15ULL * ((unsigned long long int) iteration + 1);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return( (unsigned long int) (z ^ (z >> 31)) );
 }
 
-void makeStickyEnds(char* begin, char* end){
-	if(!begin || !end || begin >= end) {
-		fprintf(stderr, "ERROR: non valid begin and end pointers supplied for makeStickyEnds!\n");
-		return;
-	}
+// one row of the screening output
+struct triplet{
+	char *rna1, *rna2, *rna3;
+	vrna_subopt_solution_t *duplexes;
+	vrna_subopt_solution_t *triplexes;
+};
 
-	char *c = begin; // iterator from first char
-	// 3' dangling end 
-	for(; c != end && *c == '.'; ++c){
-		*c = 'e';
-	}
-	
-	if(c != end){
-		char *e = end-1; // iterator from last char
-		// 5' dangling end
-		for(; *e == '.'; --e){ // no need to guard begin, as there is structure in the beginning
-			*e = 'e';
-		}
-
-		// inner part
-		for(; c != e; ++c){
-			if(*c == '.') *c = 'x';
-		}
+/// draw three random strands and bind them as a duplex and then a triplex
+/**
+ * @param[in] r Random number generator of the calling thread, already seeded for this iteration
+ * @param[in] ctx Folding context (temperature, model details, workspaces)
+ * @param[out] t The drawn sequences and the computed complexes. t->triplexes is NULL if no triplex was formed. Everything is in the arena of the calling thread.
+ */
+void screenTriplet(gsl_rng *r, struct context *ctx, struct triplet *t){
+	struct arena *a = getArena(ctx);
+	t->rna1 = t->rna2 = t->rna3 = NULL;
+	t->duplexes = NULL;
+	t->triplexes = NULL;
+	if(!a) return;
+
+	// get random sequences
+	t->rna1 = getRandomSeq(r, gsl_rng_uniform_int(r, 9)+4, a);
+	t->rna2 = getRandomSeq(r, gsl_rng_uniform_int(r, 9)+4, a);
+	t->rna3 = getRandomSeq(r, gsl_rng_uniform_int(r, 9)+4, a);
+	t->duplexes = NULL;
+	t->triplexes = NULL;
+	if(!t->rna1 || !t->rna2 || !t->rna3) return;
+
+	t->duplexes = fn3(t->rna1, t->rna2, ctx);
+
+	// check if there was any - this one checks if no str with 0 energy (separate strands) is considered
+	if(countLength(t->duplexes) > 0){
+		t->triplexes = connect3(
+				t->rna1, t->rna2, // the seq of the 1st and 2nd member of the cofolded complex
+				t->duplexes[0].structure, // structure of the cofolded complex
+				t->rna3, // the single rna to bind to the complex
+				ctx); // temperature and workspaces
 	}
+}
 
+// add an iteration to the summary of the thread
+static int addSummary(struct summary *s, const unsigned long int iteration, const struct triplet *t){
+	const int duplex = countLength(t->duplexes) > 0, triplex = countLength(t->triplexes) > 0;
+	return( addTriplet(s, iteration, t->rna1, t->rna2, t->rna3,
+			duplex ? t->duplexes[0].structure : NULL, triplex ? t->triplexes[0].structure : NULL,
+			duplex ? t->duplexes[0].energy : 0.0, triplex ? t->triplexes[0].energy : 0.0) );
 }
 
-///  binding a single sequence to the 4 possible dangling ends of a cofolded duplex
+///  screening random triplets for triplex formation
 /**
- * Function that computes the MFE of a duplex and a simplex RNA-s binding with their 5' and 3' ends. Binding energy can be calculated with the substraction of structure MFEs from the MFE returned from this function. Please note, if you request the output of complex sequence and structure, those will have to be freed at the end, as they are allocated during the run of the function!
+ * Draws random triplets, binds the first two as a duplex (fn3) and the third one to its sticky ends (connect3) and writes a TSV row (without the header) for every formed triplex. Iterations are spread over OpenMP threads, but rows are written in the order of the iterations, so the output depends only on the seed and the iterations, and a run can be cut into slices (see shard.h).
  *
- * @param[in] duplex1_seq Pointer to the sequence of the first member of the cofolded duplex RNA
- * @param[in] duplex2_seq Pointer to the sequence of the second member of the cofolded duplex RNA
- * @param[in] duplex_str Pointer to the dot-bracket 2D structure of the duplex RNA
- * @param[in] single_seq Pointer to the sequence of the unfolded, single RNA
- * @param[in] temperature Temperature of binding in Celsius degrees
+ * @param[in] seed Seed of the run
+ * @param[in] first First iteration
+ * @param[in] last Iterations [first, last) are done
+ * @param[in] threads Number of threads. If 0, the OpenMP default is used.
+ * @param[in] ctx Folding context (temperature, model details, workspaces)
+ * @param[in] out Stream to write the rows to, if bin is NULL. If both are NULL no rows are written, and the iterations are not kept in order.
+ * @param[in] bin Result file to write the rows to instead of TSV, can be NULL
+ * @param[in] cp Written every cp->interval iterations, can be NULL
+ * @param[in] summaries Summary of every thread (see summary.h) every iteration is added to, can be NULL. Merge them when this returns.
  *
- * @return MFE of the composit. If it is positive, some error happened.
+ * @return 0 on success, 1 if some error happened.
  */
-vrna_subopt_solution_t* connect3(
-		char *duplex1_seq, 
-		char *duplex2_seq, 
-		char *duplex_str,
-		char *single_seq,
-		const double temperature
-)
-{
-	const unsigned int duplex1_length = strlen(duplex1_seq);
-	const unsigned int duplex_length = strlen(duplex_str);
-	const unsigned int single_length = strlen(single_seq);
-
-	// init dynamic data
-	const unsigned int constraint_length = duplex_length + single_length + 2;
-	char *constraint = (char*) calloc(constraint_length, sizeof(char));
-	if( !constraint ){
-		fprintf(stderr, "ERROR: Could not initialise arrays in size %d\n", constraint_length);
-		return(NULL);
-	}
-	char *concat     = (char*) calloc(constraint_length, sizeof(char));
-	if( !concat ){
-		fprintf(stderr, "ERROR: Could not initialise arrays in size %d\n", constraint_length);
-		free(constraint);
-		return(NULL);
-	}	
-
-	// create concatenated string
-	strcpy(concat, duplex1_seq);
-	concat[duplex1_length] = '&';
-	strcpy(concat + duplex1_length + 1, duplex2_seq);
-	concat[duplex_length] = '&';
-	strcpy(concat + duplex_length + 1, single_seq);
-	concat[constraint_length-1] = '\0';
-
-	strcpy(constraint, duplex_str);
-	constraint[duplex_length] = '&';
-	memset(constraint + duplex_length + 1, 'e', single_length);
-	constraint[constraint_length-1] = '\0';
-
-	
-	// make ends sticky
-	makeStickyEnds(constraint, constraint + duplex1_length); // make sticky ends for the first part of the duplex
-	makeStickyEnds(constraint + duplex1_length + 1, constraint + duplex_length); // make sticky ends for the second part of the duplex
-							      //
-	// makeStickyEnds(constraint, end-1); // make sticky ends for the first part of the duplex
-	// makeStickyEnds(end+1, constraint + duplex_length -1); // make sticky ends for the second part of the duplex
-	// makeStickyEnds(constraint + duplex_length + 1, constraint + constraint_length - 1); // make single ends sticky
-
-	// printf("constraint: %s\n", constraint);
+int screen(const unsigned long int seed, const unsigned long int first, const unsigned long int last, const int threads, struct context *ctx, FILE *out, struct results_writer *bin, struct checkpoint *cp, struct summary *summaries){
+	int error = 0;
+
+	#pragma omp parallel num_threads(threads ? threads : omp_get_max_threads())
+	{
+		struct summary *summary = summaries ? summaries + omp_get_thread_num() : NULL;
+
+		// init random gen of the thread
+		gsl_rng *r = gsl_rng_alloc(gsl_rng_mt19937);
+		if(!r){
+			fprintf(stderr, "ERROR: screen: could not allocate random number generator!\n");
+			#pragma omp atomic write
+			error = 1;
+		}
 
+		// only aggregated: no order to keep
+		if(!out && !bin){
+			#pragma omp for schedule(dynamic, 16)
+			for(unsigned long int i = first; i < last; ++i){
+				struct triplet t = {NULL, NULL, NULL, NULL, NULL};
+				if(r){
+					gsl_rng_set(r, screenSeed(seed, i));
+					screenTriplet(r, ctx, &t);
+				}
+				if(summary && !addSummary(summary, i, &t)){
+					#pragma omp atomic write
+					error = 1;
+				}
+
+				struct arena *a = getArena(ctx);
+				if(a) resetArena(a);
+			}
+		} else {
+			#pragma omp for ordered schedule(dynamic, 1)
+			for(unsigned long int i = first; i < last; ++i){
+				struct triplet t = {NULL, NULL, NULL, NULL, NULL};
+				if(r){
+					gsl_rng_set(r, screenSeed(seed, i));
+					screenTriplet(r, ctx, &t);
+				}
+				if(summary && !addSummary(summary, i, &t)){
+					#pragma omp atomic write
+					error = 1;
+				}
+
+				#pragma omp ordered
+				{
+					if(t.triplexes && bin){
+						if(!addResult(bin, t.rna1, t.rna2, t.rna3, t.duplexes[0].structure, t.triplexes[0].structure, t.duplexes[0].energy, t.triplexes[0].energy)) error = 1;
+					} else if(t.triplexes){
+						fprintf(out, "%s\t%s\t%s\t%s\t%s\t%f\t%f\n", t.rna1, t.rna2, t.rna3, t.duplexes[0].structure, t.triplexes[0].structure, t.duplexes[0].energy, t.triplexes[0].energy);
+					}
+
+					// every row before i+1 is written
+					if(cp && !error && (i + 1 - first) % cp->interval == 0 && i + 1 < last && !checkpointOutput(cp, i + 1, out, bin)) error = 1;
+				}
+
+				// release the strands and complexes of the iteration
+				struct arena *a = getArena(ctx);
+				if(a) resetArena(a);
+			}
+		}
 
-	/* create a new model details structure to store the Model Settings */
-	vrna_md_t md;
-	vrna_md_set_default(&md); 
-	
-	// set temperature in celsius degrees
-	md.temperature = temperature;
-	
-	// create fold compound
-	vrna_fold_compound_t *fc = vrna_fold_compound(concat,
-                                                &md,//&(opt->md),
-                                                VRNA_OPTION_DEFAULT | VRNA_OPTION_HYBRID);
-
-	// add hard constraint
-	vrna_constraints_add(fc, constraint,
-			VRNA_CONSTRAINT_DB | 
-			VRNA_CONSTRAINT_DB_X | 
-			VRNA_CONSTRAINT_DB_INTERMOL |
-			//VRNA_CONSTRAINT_DB_INTRAMOL |
-			//VRNA_CONSTRAINT_DB_DEFAULT |
-			VRNA_CONSTRAINT_DB_ENFORCE_BP //|
-			//VRNA_CONSTRAINT_DB_PIPE
-			);
-	
-	// compute dimer structure
-	float mfe = vrna_mfe_dimer(fc, NULL);
-	if(mfe >= 0.0) {
-		vrna_fold_compound_free(fc);
-		free(constraint);
-		free(concat);
-		return(NULL);
+		if(r) gsl_rng_free(r);
 	}
-      	
-	// collect suboptimal structures
-	int delta = (int)(-mfe*100.0)+1; // the range of subopt structures calculated around the optimal: delta * 0.01 kcal/mol 
-	vrna_subopt_solution_t *subopts = vrna_subopt(fc, delta, 1, NULL); 
-
-	// free stuff
-	vrna_fold_compound_free(fc);
-	free(constraint);
-	free(concat);
 
-	return( subopts );
+	return(error);
 }
 
-char* getRandomSeq(unsigned int length){
-	const char bases[4] = {'A', 'U', 'G', 'C'};
-	char *seq = (char*) calloc(length+1, sizeof(char));
-	
-	if(!seq) {
-		fprintf(stderr, "Could not allocate memory for sequence of length %d.\n", length);
-		return(NULL);
+int screenMain(int argc, char** argv){
+	unsigned long int seed = 2, iterations = 10000, cache_mb = 0;
+	unsigned long int shard = 0, no_shards = 1, interval = 100000;
+	int threads = 0;
+	const char *binary = NULL, *output = NULL, *checkpoint = NULL, *aggregate = NULL;
+	int dot_bracket = 0, prefilter = 1;
+	unsigned int top_size = 100;
+	struct subopt_limits limits = {1, -1, 0, 0}; // only the best duplex and triplex are written
+
+	static struct option long_options[] = {
+		{"seed",       required_argument, 0, 's'},
+		{"iterations", required_argument, 0, 'n'},
+		{"threads",    required_argument, 0, 't'},
+		{"cache",      required_argument, 0, 'c'},
+		{"top-k",      required_argument, 0, 'k'},
+		{"window",     required_argument, 0, 'w'},
+		{"max-count",  required_argument, 0, 'm'},
+		{"samples",    required_argument, 0, 'S'},
+		{"binary",     required_argument, 0, 'b'},
+		{"output",     required_argument, 0, 'o'},
+		{"shard",      required_argument, 0, 'P'},
+		{"checkpoint", required_argument, 0, 'C'},
+		{"checkpoint-every", required_argument, 0, 'e'},
+		{"dot-bracket", no_argument,      0, 'D'},
+		{"no-prefilter", no_argument,     0, 'N'},
+		{"aggregate",  required_argument, 0, 'A'},
+		{"top",        required_argument, 0, 'T'},
+		{0, 0, 0, 0}
+	};
+
+	int c;
+	while((c = getopt_long(argc, argv, "s:n:t:c:k:w:m:S:b:o:P:C:e:DNA:T:", long_options, NULL)) != -1){
+		switch(c){
+			case 's': seed = strtoul(optarg, NULL, 10); break;
+			case 'n': iterations = strtoul(optarg, NULL, 10); break;
+			case 't': threads = atoi(optarg); break;
+			case 'c': cache_mb = strtoul(optarg, NULL, 10); break;
+			case 'k': limits.top_k = strtoul(optarg, NULL, 10); break;
+			case 'w': limits.window = atoi(optarg); break;
+			case 'm': limits.max_count = strtoul(optarg, NULL, 10); break;
+			case 'S': limits.samples = strtoul(optarg, NULL, 10); break;
+			case 'b': binary = optarg; break;
+			case 'o': output = optarg; break;
+			case 'P':
+				if(parseShard(optarg, &shard, &no_shards)) break;
+				fprintf(stderr, "ERROR: %s is not a shard i/N\n", optarg);
+				return(1);
+			case 'C': checkpoint = optarg; break;
+			case 'e': interval = strtoul(optarg, NULL, 10); break;
+			case 'D': dot_bracket = 1; break;
+			case 'N': prefilter = 0; break;
+			case 'A': aggregate = optarg; break;
+			case 'T': top_size = strtoul(optarg, NULL, 10); break;
+			default:
+				fprintf(stderr, "usage: %s [-s seed] [-n iterations] [-t threads] [-c cache_MB] [-k top_k] [-w window] [-m max_count] [-S samples] [-b results.bin | -o output.tsv] [-P shard/shards] [-C checkpoint] [-e checkpoint_every] [-D] [-N] [-A summary.tsv] [-T top]\n", argv[0]);
+				fprintf(stderr, "  with -A only the summary is written, and the rows only if -o or -b is given\n");
+				return(1);
+		}
 	}
-	
-	seq[length] = '\0';
-	while(length){seq[--length] = bases[gsl_rng_uniform_int(r, 4)];}
-
-	return(seq);
-}
-
-char* invertSeq(char* str){
-	unsigned int length = strlen(str); // length of the sequence with separator (length1 + length2 + 1)
-	char *newseq = (char*) calloc(length, sizeof(char));
-	if(!newseq){
-		fprintf(stderr, "invertSeq: Could not allocate memory!\n");
-		return(NULL);
+	if(aggregate && checkpoint){
+		fprintf(stderr, "ERROR: the summary of a run (-A) is not checkpointed, run shards instead\n");
+		return(1);
 	}
 
-	// find & separating first and second part of duplex - if it has none it is undefined behaviour!
-	unsigned int sep = 0; // there wont be a separator at the 0th position (assumably...)
-	while(str[++sep] != '&');
-	const unsigned int length2 = length - sep - 1; // length of second part (length1 = sep)
-
-	strcpy(newseq, str + sep + 1); // copy second part
-	newseq[length2] = '&'; // write separator
-	strncpy(newseq + length2 + 1, str, sep); // copy first part
-
-	strcpy(str, newseq); // copy back original
-
-	free(newseq);
-	return(str);
-}
-
-int main(int argc, char** argv){
-	/*
-	// init random gen
-	r = (gsl_rng *) gsl_rng_alloc (gsl_rng_mt19937);
-	gsl_rng_set(r, 2);
-
-	// print header
-	printf("rna1\trna2\trna3\tstr_duplex\tstr_triplex\tEduplex\tEtriplex\n");
-
-	for(int i = 10000;i--;){
-		// get random sequences
-		//const double mu = 10;
-		char *rna1 = getRandomSeq(gsl_rng_uniform_int(r, 9)+4);
-		char *rna2 = getRandomSeq(gsl_rng_uniform_int(r, 9)+4);
-		char *rna3 = getRandomSeq(gsl_rng_uniform_int(r, 9)+4);
-
-		vrna_subopt_solution_t *subopts = fn3(rna1, rna2, VRNA_MODEL_DEFAULT_TEMPERATURE );
-
-		// check if there was any
-		if(subopts) {
-			const unsigned int no_duplexes = countLength(subopts);
-			if(no_duplexes > 0){ // this one checks if no str with 0 energy (separate strands) is considered
-				//vrna_subopt_solution_t duplex = subopts[gsl_rng_uniform_int(r, no_duplexes)];
-				vrna_subopt_solution_t duplex = subopts[0];
-
-
-				vrna_subopt_solution_t *triplexes1 = connect3(
-						rna1, rna2, // the seq of the 1st and 2nd member of the cofolded complex
-						duplex.structure, // structure of the cofolded complex
-						rna3, // the single rna to bind to the complex
-						VRNA_MODEL_DEFAULT_TEMPERATURE); // temperature
+	// the slice of this shard, and where a checkpoint left it
+	unsigned long int first, last;
+	shardRange(iterations, shard, no_shards, &first, &last);
+	struct checkpoint cp = {checkpoint, interval ? interval : 1, seed, iterations, shard, no_shards, first, 0};
+	int resume = 0;
+	if(checkpoint){
+		if(!binary && !output){
+			fprintf(stderr, "ERROR: a checkpointed run needs an output file (-o or -b)\n");
+			return(1);
+		}
+		struct checkpoint saved = cp;
+		if(!loadCheckpoint(&saved, &resume)) return(1);
+		if(resume && (saved.seed != seed || saved.iterations != iterations || saved.shard != shard || saved.no_shards != no_shards || saved.next < first || saved.next > last)){
+			fprintf(stderr, "ERROR: %s is the checkpoint of another run\n", checkpoint);
+			return(1);
+		}
+		if(resume && saved.next == last){
+			fprintf(stderr, "shard %lu/%lu is complete\n", shard, no_shards);
+			return(0);
+		}
+		if(resume){
+			cp.next = saved.next;
+			cp.offset = saved.offset;
+			fprintf(stderr, "resuming shard %lu/%lu at iteration %lu\n", shard, no_shards, cp.next);
+		}
+	}
 
-				if(!triplexes1) continue;
+	struct context ctx;
+	if(!initContext(VRNA_MODEL_DEFAULT_TEMPERATURE, &ctx)) return(1);
+	ctx.limits = limits;
+	ctx.dot_bracket = dot_bracket; // reference path, for checking the compiled constraints
+	ctx.prefilter = prefilter; // most triplets form no duplex, skip those that provably can not
+
+	// memoize duplexes and triplexes, as short strands recur often
+	struct cache cache;
+	if(cache_mb){
+		if(!initCache(cache_mb << 20, 64, &cache)){
+			freeContext(&ctx);
+			return(1);
+		}
+		ctx.cache = &cache;
+	}
 
-				printf("%s\t%s\t%s\t%s\t%s\t%f\t%f\n", rna1, rna2, rna3, duplex.structure, triplexes1[0].structure, duplex.energy, triplexes1[0].energy);
+	// distributions instead of rows, one summary per thread, see summary.h
+	const int no_threads = threads > 0 ? threads : omp_get_max_threads();
+	struct summary *summaries = NULL;
+	int error = 0, no_summaries = 0;
+	if(aggregate){
+		summaries = (struct summary*) calloc(no_threads, sizeof(struct summary));
+		if(!summaries) fprintf(stderr, "ERROR: could not allocate %d summaries\n", no_threads);
+		for(; summaries && no_summaries < no_threads && initSummary(top_size, summaries + no_summaries); ++no_summaries);
+		error = no_summaries < no_threads;
+	}
 
-				freeSubopt(triplexes1);
+	// packed, columnar rows instead of TSV, see results.h; a resumed output is cut back to the checkpoint
+	struct results_writer bin;
+	FILE *out = binary || (aggregate && !output) ? NULL : stdout; // with -A, rows only to a file
+	if(!error && binary) error = resume ? !resumeResultsWriter(binary, cp.offset, &bin) : !openResultsWriter(binary, 0, &bin);
+	else if(!error && output){
+		out = fopen(output, resume ? "r+" : "w");
+		if(!out || (resume && (ftruncate(fileno(out), cp.offset) || fseeko(out, cp.offset, SEEK_SET)))){
+			fprintf(stderr, "ERROR: could not open %s\n", output);
+			if(out) fclose(out);
+			out = NULL;
+			error = 1;
+		}
+	}
+	if(error){
+		for(int k = 0; k < no_summaries; ++k) freeSummary(summaries + k);
+		free(summaries);
+		if(ctx.cache) freeCache(ctx.cache);
+		freeContext(&ctx);
+		return(1);
+	}
+	if(out && !resume) fprintf(out, "rna1\trna2\trna3\tstr_duplex\tstr_triplex\tEduplex\tEtriplex\n");
 
-				//vrna_subopt_solution_t *triplexes2 = connect3(
-				//		rna2, rna1, // the seq of the 1st and 2nd member of the cofolded complex
-				//		invertStructure(duplex.structure), // structure of the cofolded complex
-				//		rna3, // the single rna to bind to the complex
-				//		VRNA_MODEL_DEFAULT_TEMPERATURE); // temperature
-				//
-			}
+	error = screen(seed, cp.next, last, threads, &ctx, out, binary ? &bin : NULL, checkpoint ? &cp : NULL, summaries);
+	if(binary && !closeResultsWriter(&bin)) error = 1;
+	if(output && !binary && fflush(out)) error = 1;
 
-			freeSubopt(subopts);
+	// the shard is done, a restart has nothing left to do
+	if(!error && checkpoint){
+		cp.next = last;
+		cp.offset = binary ? 0 : (uint64_t) ftello(out);
+		if(!saveCheckpoint(&cp)) error = 1;
+	}
+	if(output && !binary && fclose(out)) error = 1;
+
+	// merged once every thread is done
+	if(summaries){
+		for(int k = 1; k < no_summaries; ++k) mergeSummary(summaries, summaries + k);
+		FILE *sout = strcmp(aggregate, "-") ? fopen(aggregate, "w") : stdout;
+		if(!sout){
+			fprintf(stderr, "ERROR: could not open %s\n", aggregate);
+			error = 1;
+		} else {
+			if(!writeSummary(summaries, sout)) error = 1;
+			if(sout != stdout ? fclose(sout) : fflush(sout)) error = 1;
 		}
+		for(int k = 0; k < no_summaries; ++k) freeSummary(summaries + k);
+		free(summaries);
+	}
 
-		free(rna1);
-		free(rna2);
-		free(rna3);
+	if(ctx.prefilter && ctx.bound.applicable) printPrefilterStats(&ctx, stderr);
+	if(ctx.cache){
+		printCacheStats(ctx.cache, stderr);
+		freeCache(ctx.cache);
 	}
+	freeContext(&ctx);
+	return(error);
+}
 
-	// free and return
-	gsl_rng_free(r);
-	*/
+int main(int argc, char** argv){
+	if(argc > 1 && !strcmp(argv[1], "screen")) return( screenMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "pool")) return( poolMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "stream")) return( streamMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "convert")) return( convertMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "sweep")) return( sweepMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "eval")) return( evalMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "assemble")) return( assemblyMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "merge")) return( mergeMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "index")) return( indexMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "query")) return( queryMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "serve")) return( serverMain(argc-1, argv+1) );
+	if(argc > 1 && !strcmp(argv[1], "hybrid")) return( hybridMain(argc-1, argv+1) );
 
 	char seq[]={"AAAAGGGGGGUUUUU&UUCCCAAAA"};
 	char str[]={".....(((.......&..)))...."};
 
-	printf("energy: %f\n", fn4(seq, str, VRNA_MODEL_DEFAULT_TEMPERATURE));
+	struct context ctx;
+	if(!initContext(VRNA_MODEL_DEFAULT_TEMPERATURE, &ctx)) return(1);
+
+	printf("energy: %f\n", fn4(seq, str, &ctx));
+
+	freeContext(&ctx);
 
 	return 0;
 }
-
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mfetable.h"
+
+///  pack a sequence in 2 bits per base
+/**
+ * @param[in] seq Sequence of A, C, G, U (T is read as U), lower case is accepted
+ * @param[in] length Length of the sequence, at most 32
+ * @param[out] index The packed sequence, first base in the highest bits
+ *
+ * @return 1 on success, 0 if the sequence has other characters.
+ */
+int packSeq(const char *seq, const unsigned int length, uint64_t *index){
+	uint64_t idx = 0;
+	for(unsigned int i = 0; i < length; ++i){
+		uint64_t b;
+		switch(seq[i]){
+			case 'A': case 'a': b = 0; break;
+			case 'C': case 'c': b = 1; break;
+			case 'G': case 'g': b = 2; break;
+			case 'U': case 'u': case 'T': case 't': b = 3; break;
+			default: return(0);
+		}
+		idx = (idx << 2) | b;
+	}
+	*index = idx;
+	return(1);
+}
+
+void unpackSeq(uint64_t index, const unsigned int length, char *seq){
+	const char bases[4] = {'A', 'C', 'G', 'U'};
+	seq[length] = '\0';
+	for(unsigned int i = length; i--; index >>= 2) seq[i] = bases[index & 3];
+}
+
+uint32_t encodeStructure(const char *structure, const unsigned int length){
+	uint32_t code = 0;
+	for(unsigned int i = 0; i < length; ++i){
+		if(structure[i] == '(') code |= 1U << (2*i);
+		else if(structure[i] == ')') code |= 2U << (2*i);
+	}
+	return(code);
+}
+
+void decodeStructure(uint32_t code, const unsigned int length, char *structure){
+	const char symbols[4] = {'.', '(', ')', '.'};
+	for(unsigned int i = 0; i < length; ++i, code >>= 2) structure[i] = symbols[code & 3];
+	structure[length] = '\0';
+}
+
+///  map a precomputed MFE table into memory
+/**
+ * The table is mapped read-only and shared, so processes on the same node use the same page cache. Free it with closeTable.
+ *
+ * @param[in] path Path of the table made by mktable
+ * @param[out] t The mapped table
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int openTable(const char *path, struct mfetable *t){
+	const int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		fprintf(stderr, "ERROR: openTable: could not open %s\n", path);
+		return(0);
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) || (size_t) st.st_size < sizeof(struct mfetable_header)){
+		fprintf(stderr, "ERROR: openTable: %s is not an MFE table\n", path);
+		close(fd);
+		return(0);
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		fprintf(stderr, "ERROR: openTable: could not map %s\n", path);
+		return(0);
+	}
+
+	const struct mfetable_header *h = (const struct mfetable_header*) map;
+	if(memcmp(h->magic, MFETABLE_MAGIC, 8) || h->max_length > MFETABLE_MAX_LENGTH || h->record_size != sizeof(struct mfetable_record)
+			|| h->offset[h->max_length] + (sizeof(struct mfetable_record) << (2*h->max_length)) > (size_t) st.st_size){
+		fprintf(stderr, "ERROR: openTable: %s is not a valid MFE table\n", path);
+		munmap(map, st.st_size);
+		return(0);
+	}
+
+	t->header = h;
+	t->size = st.st_size;
+	return(1);
+}
+
+void closeTable(struct mfetable *t){
+	if(t->header) munmap((void*) t->header, t->size);
+	t->header = NULL;
+	t->size = 0;
+}
+
+///  look up the MFE and structure of a short sequence
+/**
+ * @param[in] t The mapped table
+ * @param[in] seq Sequence of a single strand
+ * @param[out] mfe MFE of the sequence
+ * @param[out] structure MFE structure, has to have space for strlen(seq)+1 chars. If NULL no output will be written.
+ *
+ * @return 1 if the sequence is in the table, 0 if it is too long or has non ACGU characters.
+ */
+int lookupTable(const struct mfetable *t, const char *seq, float *mfe, char *structure){
+	const unsigned int length = strlen(seq);
+	uint64_t index;
+	if(!length || length > t->header->max_length || !packSeq(seq, length, &index)) return(0);
+
+	const struct mfetable_record *rec = (const struct mfetable_record*) ((const char*) t->header + t->header->offset[length]) + index;
+	*mfe = rec->mfe / 100.0f;
+	if(structure) decodeStructure(rec->structure, length, structure);
+
+	return(1);
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <ViennaRNA/fold.h>
+#include "interaction.h"
+#include "mfetable.h"
+
+///  fold every sequence up to a length and write the results in a flat table
+/**
+ * Records of length l start at header->offset[l] and are indexed by the 2 bit packed sequence (see packSeq). The file is written through a shared mapping, the lengths one after the other, the sequences of a length in parallel.
+ *
+ * @param[in] path Path of the table
+ * @param[in] max_length Longest sequences to fold
+ * @param[in] ctx Folding context (temperature, model details, workspaces)
+ *
+ * @return 0 on success, 1 if some error happened.
+ */
+int makeTable(const char *path, const unsigned int max_length, struct context *ctx){
+	struct mfetable_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MFETABLE_MAGIC, 8);
+	header.max_length = max_length;
+	header.record_size = sizeof(struct mfetable_record);
+	header.temperature = ctx->md.temperature;
+
+	// records of each length are page aligned
+	uint64_t offset = (sizeof(header) + 4095) & ~4095ULL;
+	for(unsigned int l = 1; l <= max_length; ++l){
+		header.offset[l] = offset;
+		offset += (((uint64_t) sizeof(struct mfetable_record) << (2*l)) + 4095) & ~4095ULL;
+	}
+
+	const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0){
+		fprintf(stderr, "ERROR: makeTable: could not open %s\n", path);
+		return(1);
+	}
+	if(ftruncate(fd, offset)){
+		fprintf(stderr, "ERROR: makeTable: could not resize %s to %lu bytes\n", path, (unsigned long) offset);
+		close(fd);
+		return(1);
+	}
+	char *map = (char*) mmap(NULL, offset, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		fprintf(stderr, "ERROR: makeTable: could not map %s\n", path);
+		return(1);
+	}
+
+	for(unsigned int l = 1; l <= max_length; ++l){
+		struct mfetable_record *records = (struct mfetable_record*) (map + header.offset[l]);
+		const uint64_t count = 1ULL << (2*l);
+
+		#pragma omp parallel
+		{
+			char seq[MFETABLE_MAX_LENGTH+1], str[MFETABLE_MAX_LENGTH+1];
+
+			#pragma omp for schedule(dynamic, 4096)
+			for(uint64_t index = 0; index < count; ++index){
+				unpackSeq(index, l, seq);
+				const float mfe = foldRNA(seq, str, ctx);
+				records[index].mfe = (int32_t) lroundf(mfe * 100.0f);
+				records[index].structure = encodeStructure(str, l);
+			}
+		}
+
+		fprintf(stderr, "length %u: %lu sequences\n", l, (unsigned long) count);
+	}
+
+	// header last, so a table is only valid when complete
+	memcpy(map, &header, sizeof(header));
+
+	msync(map, offset, MS_SYNC);
+	munmap(map, offset);
+	return(0);
+}
+
+int main(int argc, char** argv){
+	unsigned int max_length = 12;
+	double temperature = VRNA_MODEL_DEFAULT_TEMPERATURE;
+	char *path = "mfe.table";
+
+	int c;
+	while((c = getopt(argc, argv, "l:T:o:")) != -1){
+		switch(c){
+			case 'l': max_length = strtoul(optarg, NULL, 10); break;
+			case 'T': temperature = strtod(optarg, NULL); break;
+			case 'o': path = optarg; break;
+			default:
+				fprintf(stderr, "usage: %s [-l max_length] [-T temperature] [-o table]\n", argv[0]);
+				return(1);
+		}
+	}
+	if(!max_length || max_length > MFETABLE_MAX_LENGTH){
+		fprintf(stderr, "ERROR: max_length has to be between 1 and %d\n", MFETABLE_MAX_LENGTH);
+		return(1);
+	}
+
+	struct context ctx;
+	if(!initContext(temperature, &ctx)) return(1);
+
+	const int error = makeTable(path, max_length, &ctx);
+
+	freeContext(&ctx);
+	return(error);
+}
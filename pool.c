@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <omp.h>
+#include <ViennaRNA/fold.h>
+#include "pool.h"
+#include "scheduler.h"
+
+///  add a strand to a pool
+/**
+ * @return 1 on success, 0 if some error happened.
+ */
+int addPool(const char *seq, struct pool *p){
+	if(!(p->n & (p->n - 1))){ // grow at powers of 2
+		const unsigned int capacity = p->n ? 2 * p->n : 1;
+		char **seqs = (char**) realloc(p->seqs, capacity * sizeof(char*));
+		if(seqs) p->seqs = seqs;
+		if(!seqs){
+			fprintf(stderr, "ERROR: addPool: could not grow pool to %u strands\n", capacity);
+			return(0);
+		}
+	}
+
+	p->seqs[p->n] = strdup(seq);
+	if(!p->seqs[p->n]){
+		fprintf(stderr, "ERROR: addPool: could not allocate strand!\n");
+		return(0);
+	}
+	++p->n;
+	return(1);
+}
+
+///  read a pool of strands
+/**
+ * One sequence per line, empty lines and lines starting with '#' or '>' are skipped.
+ *
+ * @param[in] path Path of the file, "-" for stdin
+ * @param[out] p The pool, has to be zero initialised
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int readPool(const char *path, struct pool *p){
+	FILE *in = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	if(!in){
+		fprintf(stderr, "ERROR: readPool: could not open %s\n", path);
+		return(0);
+	}
+
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t length;
+	int ok = 1;
+	while(ok && (length = getline(&line, &size, in)) != -1){
+		while(length && isspace((unsigned char) line[length-1])) line[--length] = '\0';
+		if(!length || line[0] == '#' || line[0] == '>') continue;
+		ok = addPool(line, p);
+	}
+
+	free(line);
+	if(in != stdin) fclose(in);
+	return(ok);
+}
+
+void freePool(struct pool *p){
+	for(unsigned int i = 0; i < p->n; ++i){
+		free(p->seqs[i]);
+		if(p->strs) free(p->strs[i]);
+	}
+	free(p->seqs);
+	free(p->strs);
+	free(p->mfe);
+	free(p->length);
+	memset(p, 0, sizeof(struct pool));
+}
+
+///  fold every strand of a pool on its own
+/**
+ * @return 1 on success, 0 if some error happened.
+ */
+int foldPool(struct pool *p, const int threads, struct context *ctx){
+	p->strs = (char**) calloc(p->n, sizeof(char*));
+	p->mfe = (double*) calloc(p->n, sizeof(double));
+	p->length = (unsigned int*) calloc(p->n, sizeof(unsigned int));
+	if(!p->strs || !p->mfe || !p->length){
+		fprintf(stderr, "ERROR: foldPool: could not allocate %u folds\n", p->n);
+		return(0);
+	}
+
+	int ok = 1;
+	#pragma omp parallel for schedule(dynamic, 64) num_threads(threads ? threads : omp_get_max_threads())
+	for(unsigned int i = 0; i < p->n; ++i){
+		p->length[i] = strlen(p->seqs[i]);
+		p->strs[i] = (char*) calloc(p->length[i]+1, sizeof(char));
+		if(!p->strs[i]){
+			#pragma omp atomic write
+			ok = 0;
+			continue;
+		}
+		p->mfe[i] = foldRNA(p->seqs[i], p->strs[i], ctx);
+	}
+
+	if(!ok) fprintf(stderr, "ERROR: foldPool: could not allocate structures\n");
+	return(ok);
+}
+
+// one matrix job
+struct matrix_job{
+	struct pool *p;
+	struct context *ctx;
+	float *m;
+	unsigned int tile, no_blocks;
+	int error; // some fn2 call failed
+};
+
+static void matrixTile(const unsigned long int task, const int worker, void *arg){
+	struct matrix_job *job = (struct matrix_job*) arg;
+	struct pool *p = job->p;
+	const unsigned int n = p->n;
+	const unsigned int l0 = (task / job->no_blocks) * job->tile, r0 = (task % job->no_blocks) * job->tile;
+	const unsigned int l1 = (l0 + job->tile < n) ? l0 + job->tile : n, r1 = (r0 + job->tile < n) ? r0 + job->tile : n;
+
+	struct workspace *ws = getWorkspace(job->ctx, 0);
+	for(unsigned int l = l0; l < l1; ++l){
+		for(unsigned int r = r0; r < r1; ++r){
+			// fn2 returns 1.0 on errors, which would pass for an energy
+			if(ws) ws->error = 0;
+			const double mfe_comp = fn2(p->seqs[l], p->strs[l], p->seqs[r], p->strs[r], NULL, NULL, job->ctx);
+			if(!ws || ws->error){
+				job->m[(size_t) l * n + r] = NAN;
+				__atomic_store_n(&job->error, 1, __ATOMIC_RELAXED);
+				continue;
+			}
+			job->m[(size_t) l * n + r] = (float) (mfe_comp - p->mfe[l] - p->mfe[r]); // binding energy
+		}
+	}
+
+	// the tile is done, release its complexes
+	struct arena *a = getArena(job->ctx);
+	if(a) resetArena(a);
+}
+
+///  estimated cost of a tile: sum of (len_l+len_r)^3 over its pairs
+static double tileCost(const struct pool *p, const unsigned int l0, const unsigned int l1, const unsigned int r0, const unsigned int r1){
+	double sl[4] = {0.0, 0.0, 0.0, 0.0}, sr[4] = {0.0, 0.0, 0.0, 0.0}; // power sums of the lengths
+	for(unsigned int l = l0; l < l1; ++l){
+		const double x = p->length[l];
+		sl[0] += 1.0; sl[1] += x; sl[2] += x*x; sl[3] += x*x*x;
+	}
+	for(unsigned int r = r0; r < r1; ++r){
+		const double x = p->length[r];
+		sr[0] += 1.0; sr[1] += x; sr[2] += x*x; sr[3] += x*x*x;
+	}
+	// (a+b)^3 = a^3 + 3a^2b + 3ab^2 + b^3
+	return( sl[3]*sr[0] + 3.0*sl[2]*sr[1] + 3.0*sl[1]*sr[2] + sl[0]*sr[3] );
+}
+
+///  binding energy of every ordered pair of a pool
+/**
+ * Computes the fn2 binding energy (complex MFE minus both monomer MFEs) of every ordered pair of strands, the left strand binding with its 5' dangling end to the 3' dangling end of the right one. Pairs are cut into tile x tile work units, that are run on a work stealing pool ordered by their estimated O((len_l+len_r)^3) cost. The result is written as a dense float matrix after a matrix_header, through a shared mapping, so it can be mapped again by the readers.
+ *
+ * @param[in] p Pool, already folded with foldPool
+ * @param[in] tile Side of the work units
+ * @param[in] threads Number of workers. If 0, the OpenMP default is used.
+ * @param[in] ctx Folding context (temperature, model details, workspaces, cache)
+ * @param[in] path Path of the matrix file
+ *
+ * @return 0 on success, 1 if some error happened.
+ */
+int poolMatrix(struct pool *p, const unsigned int tile, const int threads, struct context *ctx, const char *path){
+	struct matrix_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MATRIX_MAGIC, 8);
+	header.n = p->n;
+	header.tile = tile ? tile : 1;
+	header.temperature = ctx->md.temperature;
+	header.offset = (sizeof(header) + 4095) & ~4095ULL;
+	const size_t size = header.offset + (size_t) p->n * p->n * sizeof(float);
+
+	const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0){
+		fprintf(stderr, "ERROR: poolMatrix: could not open %s\n", path);
+		return(1);
+	}
+	if(ftruncate(fd, size)){
+		fprintf(stderr, "ERROR: poolMatrix: could not resize %s to %zu bytes\n", path, size);
+		close(fd);
+		return(1);
+	}
+	char *map = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		fprintf(stderr, "ERROR: poolMatrix: could not map %s\n", path);
+		return(1);
+	}
+
+	struct matrix_job job = {p, ctx, (float*) (map + header.offset), header.tile, (p->n + header.tile - 1) / header.tile, 0};
+	const unsigned long int no_tasks = (unsigned long int) job.no_blocks * job.no_blocks;
+	double *cost = (double*) malloc((no_tasks ? no_tasks : 1) * sizeof(double));
+	if(!cost){
+		fprintf(stderr, "ERROR: poolMatrix: could not allocate %lu tiles\n", no_tasks);
+		munmap(map, size);
+		return(1);
+	}
+	for(unsigned long int t = 0; t < no_tasks; ++t){
+		const unsigned int l0 = (t / job.no_blocks) * job.tile, r0 = (t % job.no_blocks) * job.tile;
+		cost[t] = tileCost(p, l0, (l0 + job.tile < p->n) ? l0 + job.tile : p->n, r0, (r0 + job.tile < p->n) ? r0 + job.tile : p->n);
+	}
+
+	int error = runTasks(no_tasks, cost, threads, &matrixTile, &job);
+	if(job.error){
+		fprintf(stderr, "ERROR: poolMatrix: some pairs could not be folded, they are NaN in %s\n", path);
+		error = 1;
+	}
+
+	// header last, so a matrix is only valid when complete
+	if(!error) memcpy(map, &header, sizeof(header));
+
+	free(cost);
+	msync(map, size, MS_SYNC);
+	munmap(map, size);
+	return(error);
+}
+
+int poolMain(int argc, char** argv){
+	char *input = "-", *output = "matrix.bin";
+	unsigned int tile = 32;
+	unsigned long int cache_mb = 0;
+	int threads = 0, ends = 0;
+	double temperature = VRNA_MODEL_DEFAULT_TEMPERATURE;
+
+	int c;
+	while((c = getopt(argc, argv, "i:o:b:t:c:T:E")) != -1){
+		switch(c){
+			case 'i': input = optarg; break;
+			case 'o': output = optarg; break;
+			case 'b': tile = strtoul(optarg, NULL, 10); break;
+			case 't': threads = atoi(optarg); break;
+			case 'c': cache_mb = strtoul(optarg, NULL, 10); break;
+			case 'T': temperature = strtod(optarg, NULL); break;
+			case 'E': ends = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-i pool] [-o matrix] [-b tile] [-t threads] [-c cache_MB] [-T temperature] [-E]\n", argv[0]);
+				return(1);
+		}
+	}
+
+	struct context ctx;
+	if(!initContext(temperature, &ctx)) return(1);
+	ctx.ends = ends; // fold only the dangling ends, the monomer structures stay
+
+	struct cache cache;
+	if(cache_mb){
+		if(!initCache(cache_mb << 20, 64, &cache)){
+			freeContext(&ctx);
+			return(1);
+		}
+		ctx.cache = &cache;
+	}
+
+	struct pool p;
+	memset(&p, 0, sizeof(p));
+	int error = !readPool(input, &p) || !foldPool(&p, threads, &ctx);
+	if(!error) error = poolMatrix(&p, tile, threads, &ctx, output);
+
+	freePool(&p);
+	if(ctx.cache){
+		printCacheStats(ctx.cache, stderr);
+		freeCache(ctx.cache);
+	}
+	freeContext(&ctx);
+	return(error);
+}
@@ -0,0 +1,149 @@
+#include "probe.h"
+
+#ifdef PROBES
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static const char *stage_names[NO_STAGES] = {"constraint", "fold_compound", "constraints_add", "mfe", "subopt", "cut_points"};
+static const char *size_names[NO_SIZES] = {"structure_length", "subopt_length"};
+
+// counters of one thread, only that thread writes them
+struct probe_counters{
+	unsigned long int calls[NO_STAGES];
+	uint64_t ticks[NO_STAGES];
+	unsigned long int sizes[NO_SIZES][PROBE_BUCKETS];
+	struct probe_counters *next;
+};
+
+static __thread struct probe_counters *local = NULL;
+static struct probe_counters *threads = NULL; // counters of every thread that ever probed
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t requested = 0; // a dump was asked for with SIGUSR1
+
+///  ticks of the cycle counter, or nanoseconds where there is none
+uint64_t probeClock(void){
+#if defined(__x86_64__) || defined(__i386__)
+	return( __rdtsc() );
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return( (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec );
+#endif
+}
+
+static void dumpAtExit(void){
+	probeDump(stderr);
+}
+
+// only sets a flag, the next probe of any thread dumps
+static void onSignal(int sig){
+	(void) sig;
+	requested = 1;
+}
+
+// counters of the calling thread, the first one also sets up dumping at exit and on SIGUSR1
+static struct probe_counters* getCounters(void){
+	if(local) return(local);
+
+	local = (struct probe_counters*) calloc(1, sizeof(struct probe_counters));
+	if(!local) return(NULL);
+
+	pthread_mutex_lock(&lock);
+	if(!threads){
+		atexit(dumpAtExit);
+		struct sigaction old;
+		if(!sigaction(SIGUSR1, NULL, &old) && old.sa_handler == SIG_DFL){
+			struct sigaction sa;
+			memset(&sa, 0, sizeof(sa));
+			sa.sa_handler = onSignal;
+			sa.sa_flags = SA_RESTART;
+			sigemptyset(&sa.sa_mask);
+			sigaction(SIGUSR1, &sa, NULL);
+		}
+	}
+	local->next = threads;
+	threads = local;
+	pthread_mutex_unlock(&lock);
+
+	return(local);
+}
+
+void probeStage(const enum probe_stage stage, const uint64_t ticks){
+	struct probe_counters *c = getCounters();
+	if(!c) return;
+	++c->calls[stage];
+	c->ticks[stage] += ticks;
+
+	if(requested){
+		requested = 0;
+		probeDump(stderr);
+	}
+}
+
+void probeSize(const enum probe_size size, const unsigned long int value){
+	struct probe_counters *c = getCounters();
+	if(!c) return;
+
+	// bucket b holds [2^(b-1), 2^b), bucket 0 holds 0
+	unsigned int b = value ? 64 - __builtin_clzl(value) : 0;
+	if(b >= PROBE_BUCKETS) b = PROBE_BUCKETS - 1;
+	++c->sizes[size][b];
+}
+
+///  write the counters of all threads summed up
+/**
+ * Called at exit, and by the next probe after a SIGUSR1. Counters of running threads are read without stopping them, so a dump during a run is a close estimate, not a snapshot.
+ *
+ * @param[in] out Stream to write to
+ */
+void probeDump(FILE *out){
+	struct probe_counters sum;
+	memset(&sum, 0, sizeof(sum));
+	unsigned int no_threads = 0;
+
+	pthread_mutex_lock(&lock);
+	for(struct probe_counters *c = threads; c; c = c->next, ++no_threads){
+		for(unsigned int s = 0; s < NO_STAGES; ++s){
+			sum.calls[s] += c->calls[s];
+			sum.ticks[s] += c->ticks[s];
+		}
+		for(unsigned int s = 0; s < NO_SIZES; ++s){
+			for(unsigned int b = 0; b < PROBE_BUCKETS; ++b) sum.sizes[s][b] += c->sizes[s][b];
+		}
+	}
+	pthread_mutex_unlock(&lock);
+
+	uint64_t total = 0;
+	for(unsigned int s = 0; s < NO_STAGES; ++s) total += sum.ticks[s];
+
+#if defined(__x86_64__) || defined(__i386__)
+	const char *unit = "cycles";
+#else
+	const char *unit = "ns";
+#endif
+	fprintf(out, "probes of %u threads\n", no_threads);
+	fprintf(out, "stage\tcalls\t%s\t%s/call\tshare\n", unit, unit);
+	for(unsigned int s = 0; s < NO_STAGES; ++s){
+		fprintf(out, "%s\t%lu\t%llu\t%.0f\t%.1f%%\n", stage_names[s], sum.calls[s], (unsigned long long int) sum.ticks[s],
+				sum.calls[s] ? (double) sum.ticks[s] / sum.calls[s] : 0.0,
+				total ? 100.0 * sum.ticks[s] / total : 0.0);
+	}
+
+	for(unsigned int s = 0; s < NO_SIZES; ++s){
+		fprintf(out, "%s", size_names[s]);
+		for(unsigned int b = 0; b < PROBE_BUCKETS; ++b){
+			if(sum.sizes[s][b]) fprintf(out, "\t<%lu:%lu", 1UL << b, sum.sizes[s][b]);
+		}
+		fprintf(out, "\n");
+	}
+	fflush(out);
+}
+
+#endif
@@ -0,0 +1,535 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "results.h"
+
+// columns
+
+static int reserveColumn(struct results_column *c, const size_t size){
+	if(c->used + size <= c->size) return(1);
+
+	size_t new_size = c->size ? c->size : 4096;
+	while(c->used + size > new_size) new_size *= 2;
+	unsigned char *data = (unsigned char*) realloc(c->data, new_size);
+	if(!data){
+		fprintf(stderr, "ERROR: reserveColumn: could not grow column to %zu bytes\n", new_size);
+		return(0);
+	}
+	c->data = data;
+	c->size = new_size;
+	return(1);
+}
+
+static int appendColumn(struct results_column *c, const void *data, const size_t size){
+	if(!reserveColumn(c, size)) return(0);
+	memcpy(c->data + c->used, data, size);
+	c->used += size;
+	return(1);
+}
+
+static int baseCode(const char c){
+	switch(c){
+		case 'A': case 'a': return(0);
+		case 'C': case 'c': return(1);
+		case 'G': case 'g': return(2);
+		case 'U': case 'u': case 'T': case 't': return(3);
+		default: return(-1);
+	}
+}
+
+static int structureCode(const char c){
+	switch(c){
+		case '.': return(0);
+		case '(': return(1);
+		case ')': return(2);
+		default: return(-1);
+	}
+}
+
+// pack length symbols of s, skipping strand breaks, 4 per byte
+static int packColumn(struct results_column *c, const char *s, const unsigned int length, int (*code)(const char)){
+	const size_t bytes = (length + 3) / 4;
+	if(!reserveColumn(c, bytes)) return(0);
+
+	unsigned char *out = c->data + c->used;
+	memset(out, 0, bytes);
+	for(unsigned int i = 0; i < length; ++s){
+		if(*s == '&') continue;
+		const int x = *s ? code(*s) : -1;
+		if(x < 0) return(0);
+		out[i / 4] |= x << (2 * (i % 4));
+		++i;
+	}
+	c->used += bytes;
+	return(1);
+}
+
+static void unpackColumn(const unsigned char *in, const unsigned int length, const char *symbols, char *out){
+	for(unsigned int i = 0; i < length; ++i) out[i] = symbols[(in[i / 4] >> (2 * (i % 4))) & 3];
+}
+
+// writer
+
+///  open a result file for writing
+/**
+ * Rows are collected column by column and written a block at a time. Close it with closeResultsWriter, which also writes the index.
+ *
+ * @param[in] path Path of the file, "-" for stdout
+ * @param[in] block_rows Most rows in a block, 0 for RESULTS_BLOCK_ROWS
+ * @param[out] w The writer to init
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int openResultsWriter(const char *path, const unsigned int block_rows, struct results_writer *w){
+	memset(w, 0, sizeof(struct results_writer));
+	w->block_rows = block_rows ? block_rows : RESULTS_BLOCK_ROWS;
+	w->out = strcmp(path, "-") ? fopen(path, "wb") : stdout;
+	if(!w->out){
+		fprintf(stderr, "ERROR: openResultsWriter: could not open %s\n", path);
+		return(0);
+	}
+
+	struct results_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, RESULTS_MAGIC, 8);
+	h.block_rows = w->block_rows;
+	if(fwrite(&h, sizeof(h), 1, w->out) != 1){
+		fprintf(stderr, "ERROR: openResultsWriter: could not write %s\n", path);
+		if(w->out != stdout) fclose(w->out);
+		return(0);
+	}
+	w->offset = sizeof(h);
+	return(1);
+}
+
+static int flushBlock(struct results_writer *w){
+	if(!w->rows) return(1);
+
+	if(w->no_blocks == w->index_size){
+		const uint64_t size = w->index_size ? 2 * w->index_size : 64;
+		struct results_index_entry *index = (struct results_index_entry*) realloc(w->index, size * sizeof(struct results_index_entry));
+		if(!index){
+			fprintf(stderr, "ERROR: flushBlock: could not grow index\n");
+			return(0);
+		}
+		w->index = index;
+		w->index_size = size;
+	}
+
+	struct results_block_header h;
+	memset(&h, 0, sizeof(h));
+	h.no_rows = w->rows;
+	h.sequence_bytes = w->sequences.used;
+	h.structure_bytes = w->structures.used;
+
+	const int ok = fwrite(&h, sizeof(h), 1, w->out) == 1
+		&& fwrite(w->flags.data, 1, w->flags.used, w->out) == w->flags.used
+		&& fwrite(w->lengths.data, 1, w->lengths.used, w->out) == w->lengths.used
+		&& fwrite(w->energies.data, 1, w->energies.used, w->out) == w->energies.used
+		&& fwrite(w->sequences.data, 1, w->sequences.used, w->out) == w->sequences.used
+		&& fwrite(w->structures.data, 1, w->structures.used, w->out) == w->structures.used;
+	if(!ok){
+		fprintf(stderr, "ERROR: flushBlock: could not write block %lu\n", (unsigned long int) w->no_blocks);
+		return(0);
+	}
+
+	struct results_index_entry *e = w->index + w->no_blocks++;
+	e->offset = w->offset;
+	e->first_row = w->no_rows - w->rows;
+	e->no_rows = w->rows;
+	e->size = sizeof(h) + w->flags.used + w->lengths.used + w->energies.used + w->sequences.used + w->structures.used;
+	w->offset += e->size;
+
+	w->rows = 0;
+	w->flags.used = w->lengths.used = w->energies.used = w->sequences.used = w->structures.used = 0;
+	return(1);
+}
+
+///  write the rows collected so far as a block and flush the file, e.g. before a checkpoint
+/**
+ * @param[in] w The writer
+ * @param[out] offset Bytes of the file written so far, where resumeResultsWriter can go on
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int syncResultsWriter(struct results_writer *w, uint64_t *offset){
+	if(!flushBlock(w) || fflush(w->out) || (w->out != stdout && fsync(fileno(w->out)))){
+		fprintf(stderr, "ERROR: syncResultsWriter: could not flush the result file\n");
+		return(0);
+	}
+	*offset = w->offset;
+	return(1);
+}
+
+///  open a result file written up to offset by syncResultsWriter, to add more rows
+/**
+ * The blocks before offset are walked to rebuild the index, anything after it (a partial block, or the index of a finished file) is cut off.
+ *
+ * @param[in] path Path of the file
+ * @param[in] offset Offset returned by syncResultsWriter
+ * @param[out] w The writer to init
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int resumeResultsWriter(const char *path, const uint64_t offset, struct results_writer *w){
+	memset(w, 0, sizeof(struct results_writer));
+	w->out = fopen(path, "r+b");
+	if(!w->out){
+		fprintf(stderr, "ERROR: resumeResultsWriter: could not open %s\n", path);
+		return(0);
+	}
+
+	struct results_header h;
+	int ok = fread(&h, sizeof(h), 1, w->out) == 1 && !memcmp(h.magic, RESULTS_MAGIC, 8) && h.block_rows;
+	w->block_rows = h.block_rows;
+	w->offset = sizeof(h);
+	while(ok && w->offset < offset){
+		struct results_block_header b;
+		ok = fseeko(w->out, w->offset, SEEK_SET) == 0 && fread(&b, sizeof(b), 1, w->out) == 1;
+		if(!ok) break;
+
+		if(w->no_blocks == w->index_size){
+			const uint64_t size = w->index_size ? 2 * w->index_size : 64;
+			struct results_index_entry *index = (struct results_index_entry*) realloc(w->index, size * sizeof(struct results_index_entry));
+			if(!index){
+				ok = 0;
+				break;
+			}
+			w->index = index;
+			w->index_size = size;
+		}
+		struct results_index_entry *e = w->index + w->no_blocks++;
+		e->offset = w->offset;
+		e->first_row = w->no_rows;
+		e->no_rows = b.no_rows;
+		e->size = sizeof(b) + (uint64_t) b.no_rows * (1 + 3 * sizeof(uint16_t) + 2 * sizeof(int16_t)) + b.sequence_bytes + b.structure_bytes;
+		w->offset += e->size;
+		w->no_rows += b.no_rows;
+	}
+	ok = ok && w->offset == offset && ftruncate(fileno(w->out), offset) == 0 && fseeko(w->out, offset, SEEK_SET) == 0;
+	if(!ok){
+		fprintf(stderr, "ERROR: resumeResultsWriter: %s does not end in a block at %lu\n", path, (unsigned long int) offset);
+		fclose(w->out);
+		free(w->index);
+		memset(w, 0, sizeof(struct results_writer));
+		return(0);
+	}
+	return(1);
+}
+
+static int16_t fixedEnergy(const float e){
+	const long int x = lroundf(e * 100.0f);
+	return( x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x) );
+}
+
+///  add a row of the screening output
+/**
+ * @param[in] w The writer
+ * @param[in] rna1 First strand
+ * @param[in] rna2 Second strand
+ * @param[in] rna3 Third strand, can be NULL or empty
+ * @param[in] str_duplex Structure of rna1&rna2, NULL or empty if no duplex was formed
+ * @param[in] str_triplex Structure of rna1&rna2&rna3, NULL or empty if no triplex was formed
+ * @param[in] e_duplex Energy of the duplex, stored in 0.01 kcal/mol
+ * @param[in] e_triplex Energy of the triplex, stored in 0.01 kcal/mol
+ *
+ * @return 1 on success, 0 if some error happened (e.g. a base or structure symbol that can not be packed).
+ */
+int addResult(struct results_writer *w, const char *rna1, const char *rna2, const char *rna3, const char *str_duplex, const char *str_triplex, const float e_duplex, const float e_triplex){
+	const size_t length1 = strlen(rna1), length2 = strlen(rna2), length3 = rna3 ? strlen(rna3) : 0;
+	if(length1 > UINT16_MAX || length2 > UINT16_MAX || length3 > UINT16_MAX){
+		fprintf(stderr, "ERROR: addResult: strands longer than %u nt can not be stored\n", UINT16_MAX);
+		return(0);
+	}
+
+	uint8_t flags = 0;
+	if(length3) flags |= RESULT_RNA3;
+	if(str_duplex && *str_duplex) flags |= RESULT_DUPLEX;
+	if(str_triplex && *str_triplex && length3) flags |= RESULT_TRIPLEX;
+	const uint16_t lengths[3] = {length1, length2, length3};
+	const int16_t energies[2] = {flags & RESULT_DUPLEX ? fixedEnergy(e_duplex) : 0, flags & RESULT_TRIPLEX ? fixedEnergy(e_triplex) : 0};
+
+	// the sequence and structure columns are rolled back if a symbol can not be packed
+	const size_t sequences = w->sequences.used, structures = w->structures.used;
+	int ok = packColumn(&w->sequences, rna1, length1, baseCode)
+		&& packColumn(&w->sequences, rna2, length2, baseCode)
+		&& (!length3 || packColumn(&w->sequences, rna3, length3, baseCode))
+		&& (!(flags & RESULT_DUPLEX) || packColumn(&w->structures, str_duplex, length1 + length2, structureCode))
+		&& (!(flags & RESULT_TRIPLEX) || packColumn(&w->structures, str_triplex, length1 + length2 + length3, structureCode));
+	if(ok) ok = appendColumn(&w->flags, &flags, sizeof(flags)) && appendColumn(&w->lengths, lengths, sizeof(lengths)) && appendColumn(&w->energies, energies, sizeof(energies));
+	if(!ok){
+		fprintf(stderr, "ERROR: addResult: could not store row %s %s %s\n", rna1, rna2, rna3 ? rna3 : "");
+		w->sequences.used = sequences;
+		w->structures.used = structures;
+		return(0);
+	}
+
+	++w->no_rows;
+	if(++w->rows == w->block_rows) return( flushBlock(w) );
+	return(1);
+}
+
+///  write the last block, the index and the trailer, and close the file
+/**
+ * @return 1 on success, 0 if some error happened.
+ */
+int closeResultsWriter(struct results_writer *w){
+	int ok = flushBlock(w);
+
+	struct results_trailer t;
+	memset(&t, 0, sizeof(t));
+	memcpy(t.magic, RESULTS_INDEX_MAGIC, 8);
+	t.index_offset = w->offset;
+	t.no_blocks = w->no_blocks;
+	t.no_rows = w->no_rows;
+	if(ok && ((w->no_blocks && fwrite(w->index, sizeof(struct results_index_entry), w->no_blocks, w->out) != w->no_blocks) || fwrite(&t, sizeof(t), 1, w->out) != 1)){
+		fprintf(stderr, "ERROR: closeResultsWriter: could not write index\n");
+		ok = 0;
+	}
+
+	if(w->out == stdout){
+		if(fflush(w->out)) ok = 0;
+	} else if(fclose(w->out)) ok = 0;
+
+	free(w->flags.data);
+	free(w->lengths.data);
+	free(w->energies.data);
+	free(w->sequences.data);
+	free(w->structures.data);
+	free(w->index);
+	memset(w, 0, sizeof(struct results_writer));
+	return(ok);
+}
+
+// reader
+
+///  map a result file into memory
+/**
+ * Blocks can be read in any order through the index at the end of the file. Free it with closeResults.
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int openResults(const char *path, struct results_file *f){
+	memset(f, 0, sizeof(struct results_file));
+	const int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		fprintf(stderr, "ERROR: openResults: could not open %s\n", path);
+		return(0);
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) || (size_t) st.st_size < sizeof(struct results_header) + sizeof(struct results_trailer)){
+		fprintf(stderr, "ERROR: openResults: %s is not a result file\n", path);
+		close(fd);
+		return(0);
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		fprintf(stderr, "ERROR: openResults: could not map %s\n", path);
+		return(0);
+	}
+	f->map = (const unsigned char*) map;
+	f->size = st.st_size;
+	f->trailer = (const struct results_trailer*) (f->map + f->size - sizeof(struct results_trailer));
+
+	if(memcmp(f->map, RESULTS_MAGIC, 8) || memcmp(f->trailer->magic, RESULTS_INDEX_MAGIC, 8)
+			|| f->trailer->index_offset > f->size - sizeof(struct results_trailer)
+			|| f->trailer->no_blocks > (f->size - sizeof(struct results_trailer) - f->trailer->index_offset) / sizeof(struct results_index_entry)){
+		fprintf(stderr, "ERROR: openResults: %s is not a complete result file\n", path);
+		closeResults(f);
+		return(0);
+	}
+	f->index = (const struct results_index_entry*) (f->map + f->trailer->index_offset);
+	return(1);
+}
+
+void closeResults(struct results_file *f){
+	if(f->map) munmap((void*) f->map, f->size);
+	memset(f, 0, sizeof(struct results_file));
+}
+
+///  decode the rows of a block
+/**
+ * @param[in] f The result file
+ * @param[in] block Index of the block
+ * @param[in] fn Called for every row, in order, with the strands and structures as screen writes them (empty if not there); it returns 0 to stop
+ * @param[in] arg Passed to fn
+ *
+ * @return 1 on success, 0 if the block is corrupt or fn failed.
+ */
+int readBlockRows(const struct results_file *f, const uint64_t block, row_f fn, void *arg){
+	if(block >= f->trailer->no_blocks) return(0);
+	const struct results_index_entry *e = f->index + block;
+	if(e->offset + e->size > f->trailer->index_offset) return(0);
+
+	const unsigned char *p = f->map + e->offset;
+	struct results_block_header h;
+	memcpy(&h, p, sizeof(h));
+	const unsigned char *flags = p + sizeof(h);
+	const unsigned char *lengths = flags + h.no_rows;
+	const unsigned char *energies = lengths + 3 * sizeof(uint16_t) * h.no_rows;
+	const unsigned char *sequences = energies + 2 * sizeof(int16_t) * h.no_rows;
+	const unsigned char *structures = sequences + h.sequence_bytes;
+	const unsigned char *end = structures + h.structure_bytes;
+	if(end > p + e->size) return(0);
+
+	char *row = NULL;
+	size_t row_size = 0;
+	int ok = 1;
+	for(uint32_t i = 0; i < h.no_rows && ok; ++i){
+		uint16_t l[3];
+		int16_t en[2];
+		memcpy(l, lengths + 3 * sizeof(uint16_t) * i, sizeof(l));
+		memcpy(en, energies + 2 * sizeof(int16_t) * i, sizeof(en));
+
+		// rna1 rna2 rna3 str_duplex str_triplex, each terminated, structures with their strand breaks
+		const size_t size = 3 * ((size_t) l[0] + l[1] + l[2]) + 16;
+		if(size > row_size){
+			free(row);
+			row = (char*) malloc(size);
+			row_size = row ? size : 0;
+			if(!row){
+				ok = 0;
+				break;
+			}
+		}
+		char *field[5];
+		char *r = row;
+		for(unsigned int s = 0; s < 3; ++s){
+			if(sequences + (l[s] + 3) / 4 > structures){
+				ok = 0;
+				break;
+			}
+			field[s] = r;
+			unpackColumn(sequences, l[s], "ACGU", r);
+			sequences += (l[s] + 3) / 4;
+			r += l[s];
+			*r++ = '\0';
+		}
+		for(unsigned int s = 0; s < 2 && ok; ++s){
+			field[3+s] = r;
+			if(!(flags[i] & (s ? RESULT_TRIPLEX : RESULT_DUPLEX))){
+				*r++ = '\0';
+				continue;
+			}
+			const unsigned int no_strands = s ? 3 : 2, length = l[0] + l[1] + (s ? l[2] : 0);
+			if(structures + (length + 3) / 4 > end){
+				ok = 0;
+				break;
+			}
+			char *str = r + no_strands - 1; // room for the breaks
+			unpackColumn(structures, length, ".()", str);
+			structures += (length + 3) / 4;
+			for(unsigned int k = 0; k < no_strands; ++k){
+				memmove(r, str, l[k]);
+				r += l[k];
+				str += l[k];
+				*r++ = k + 1 < no_strands ? '&' : '\0';
+			}
+		}
+		if(!ok) break;
+
+		ok = fn(field[0], field[1], field[2], field[3], field[4], en[0] / 100.0, en[1] / 100.0, arg);
+	}
+
+	free(row);
+	return(ok);
+}
+
+static int printRowTsv(const char *rna1, const char *rna2, const char *rna3, const char *str_duplex, const char *str_triplex, const double e_duplex, const double e_triplex, void *arg){
+	fprintf((FILE*) arg, "%s\t%s\t%s\t%s\t%s\t%f\t%f\n", rna1, rna2, rna3, str_duplex, str_triplex, e_duplex, e_triplex);
+	return(1);
+}
+
+///  write the rows of a block as TSV, in the format of screen
+/**
+ * @param[in] f The result file
+ * @param[in] block Index of the block
+ * @param[in] out Stream to write to
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int writeBlockTsv(const struct results_file *f, const uint64_t block, FILE *out){
+	return( readBlockRows(f, block, &printRowTsv, out) );
+}
+
+///  convert a result file back to the TSV of screen
+/**
+ * @return 1 on success, 0 if some error happened.
+ */
+int resultsToTsv(const char *path, FILE *out){
+	struct results_file f;
+	if(!openResults(path, &f)) return(0);
+
+	fprintf(out, "rna1\trna2\trna3\tstr_duplex\tstr_triplex\tEduplex\tEtriplex\n");
+	int ok = 1;
+	for(uint64_t b = 0; b < f.trailer->no_blocks && ok; ++b){
+		ok = writeBlockTsv(&f, b, out);
+		if(!ok) fprintf(stderr, "ERROR: resultsToTsv: block %lu of %s is corrupt\n", (unsigned long int) b, path);
+	}
+
+	closeResults(&f);
+	return(ok);
+}
+
+static int addRow(const char *rna1, const char *rna2, const char *rna3, const char *str_duplex, const char *str_triplex, const double e_duplex, const double e_triplex, void *arg){
+	return( addResult((struct results_writer*) arg, rna1, rna2, rna3, str_duplex, str_triplex, e_duplex, e_triplex) );
+}
+
+///  concatenate the rows of result files into one
+/**
+ * The rows are added again, in the order of the files, so the blocks are cut as if they had been written by one run (with the block size of the first file).
+ *
+ * @param[in] paths Result files, complete (closed by closeResultsWriter)
+ * @param[in] no_paths Number of files
+ * @param[in] output Path of the merged file
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int mergeResults(const char **paths, const unsigned int no_paths, const char *output){
+	struct results_writer w;
+	int ok = 1, opened = 0;
+	for(unsigned int k = 0; k < no_paths && ok; ++k){
+		struct results_file f;
+		if(!openResults(paths[k], &f)){
+			ok = 0;
+			break;
+		}
+		if(!opened){
+			struct results_header h;
+			memcpy(&h, f.map, sizeof(h));
+			ok = opened = openResultsWriter(output, h.block_rows, &w);
+		}
+		for(uint64_t b = 0; b < f.trailer->no_blocks && ok; ++b){
+			ok = readBlockRows(&f, b, &addRow, &w);
+			if(!ok) fprintf(stderr, "ERROR: mergeResults: block %lu of %s is corrupt\n", (unsigned long int) b, paths[k]);
+		}
+		closeResults(&f);
+	}
+	if(opened && !closeResultsWriter(&w)) ok = 0;
+	return(ok);
+}
+
+int convertMain(int argc, char** argv){
+	if(argc < 2 || argc > 3){
+		fprintf(stderr, "usage: %s results.bin [output.tsv]\n", argv[0]);
+		return(1);
+	}
+
+	FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+	if(!out){
+		fprintf(stderr, "ERROR: could not open %s\n", argv[2]);
+		return(1);
+	}
+
+	int error = !resultsToTsv(argv[1], out);
+	if(out != stdout && fclose(out)) error = 1;
+	return(error);
+}
@@ -0,0 +1,183 @@
+#define _GNU_SOURCE // qsort_r
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <omp.h>
+#include "scheduler.h"
+
+// tasks of one worker, most expensive first
+struct deque{
+	pthread_mutex_t lock;
+	unsigned long int *tasks;
+	unsigned long int front, back; // tasks[front..back) are left
+	double remaining; // estimated cost of the tasks left
+};
+
+struct scheduler{
+	struct deque *deques;
+	const double *cost;
+	int threads;
+	task_f fn;
+	void *arg;
+};
+
+struct worker{
+	struct scheduler *s;
+	int id;
+};
+
+// the owner takes the most expensive of its own tasks
+static int popFront(struct deque *d, const double *cost, unsigned long int *task){
+	int found = 0;
+	pthread_mutex_lock(&d->lock);
+	if(d->front < d->back){
+		*task = d->tasks[d->front++];
+		d->remaining -= cost[*task];
+		found = 1;
+	}
+	pthread_mutex_unlock(&d->lock);
+	return(found);
+}
+
+// a thief takes the cheapest task of the victim, to fill its idle time without taking away large chunks
+static int popBack(struct deque *d, const double *cost, unsigned long int *task){
+	int found = 0;
+	pthread_mutex_lock(&d->lock);
+	if(d->front < d->back){
+		*task = d->tasks[--d->back];
+		d->remaining -= cost[*task];
+		found = 1;
+	}
+	pthread_mutex_unlock(&d->lock);
+	return(found);
+}
+
+static int steal(struct scheduler *s, const int thief, unsigned long int *task){
+	for(;;){
+		// victim: the worker with the most work left
+		int victim = -1;
+		double most = 0.0;
+		for(int w = 0; w < s->threads; ++w){
+			if(w == thief) continue;
+			pthread_mutex_lock(&s->deques[w].lock);
+			const int left = s->deques[w].front < s->deques[w].back;
+			const double remaining = s->deques[w].remaining;
+			pthread_mutex_unlock(&s->deques[w].lock);
+			if(left && (victim < 0 || remaining > most)){
+				victim = w;
+				most = remaining;
+			}
+		}
+		if(victim < 0) return(0);
+		if(popBack(s->deques + victim, s->cost, task)) return(1);
+		// someone was faster, look again
+	}
+}
+
+static void* work(void *data){
+	struct worker *w = (struct worker*) data;
+	struct scheduler *s = w->s;
+	unsigned long int task;
+
+	while(popFront(s->deques + w->id, s->cost, &task) || steal(s, w->id, &task)){
+		s->fn(task, w->id, s->arg);
+	}
+
+	return(NULL);
+}
+
+static int byCostDesc(const void *x, const void *y, void *cost){
+	const double cx = ((const double*) cost)[*(const unsigned long int*) x], cy = ((const double*) cost)[*(const unsigned long int*) y];
+	return( (cx < cy) - (cx > cy) );
+}
+
+///  run tasks of known cost on a work stealing pool
+/**
+ * Tasks are sorted by their estimated cost and dealt to the workers greedily (always to the one with the least work so far), so the deques start balanced. Every worker runs its own tasks from the most expensive down; an idle worker steals the cheapest task of the worker with the most work left. Costs are only estimates, they need not be exact.
+ *
+ * @param[in] no_tasks Number of tasks, numbered from 0
+ * @param[in] cost Estimated cost of each task
+ * @param[in] threads Number of workers. If 0, the OpenMP default is used.
+ * @param[in] fn Function running a task
+ * @param[in] arg Passed to fn
+ *
+ * @return 0 on success, 1 if some error happened.
+ */
+int runTasks(const unsigned long int no_tasks, const double *cost, const int threads, task_f fn, void *arg){
+	struct scheduler s;
+	s.cost = cost;
+	s.threads = threads ? threads : omp_get_max_threads();
+	s.fn = fn;
+	s.arg = arg;
+
+	unsigned long int *order = (unsigned long int*) malloc(no_tasks * sizeof(unsigned long int));
+	s.deques = (struct deque*) calloc(s.threads, sizeof(struct deque));
+	struct worker *workers = (struct worker*) calloc(s.threads, sizeof(struct worker));
+	pthread_t *ids = (pthread_t*) calloc(s.threads, sizeof(pthread_t));
+	if((no_tasks && !order) || !s.deques || !workers || !ids){
+		fprintf(stderr, "ERROR: runTasks: could not allocate scheduler for %lu tasks\n", no_tasks);
+		free(order); free(s.deques); free(workers); free(ids);
+		return(1);
+	}
+
+	// most expensive first
+	for(unsigned long int t = 0; t < no_tasks; ++t) order[t] = t;
+	qsort_r(order, no_tasks, sizeof(unsigned long int), &byCostDesc, (void*) cost);
+
+	// deal them: count first, so every deque is one array
+	int *owner = (int*) malloc((no_tasks ? no_tasks : 1) * sizeof(int));
+	if(!owner){
+		fprintf(stderr, "ERROR: runTasks: could not allocate scheduler for %lu tasks\n", no_tasks);
+		free(order); free(s.deques); free(workers); free(ids);
+		return(1);
+	}
+	for(unsigned long int i = 0; i < no_tasks; ++i){
+		int least = 0;
+		for(int w = 1; w < s.threads; ++w) if(s.deques[w].remaining < s.deques[least].remaining) least = w;
+		owner[i] = least;
+		s.deques[least].remaining += cost[order[i]];
+		++s.deques[least].back;
+	}
+	int error = 0;
+	for(int w = 0; w < s.threads; ++w){
+		s.deques[w].tasks = (unsigned long int*) malloc((s.deques[w].back ? s.deques[w].back : 1) * sizeof(unsigned long int));
+		if(!s.deques[w].tasks) error = 1;
+		s.deques[w].back = 0;
+		pthread_mutex_init(&s.deques[w].lock, NULL);
+	}
+	if(!error){
+		for(unsigned long int i = 0; i < no_tasks; ++i){
+			struct deque *d = s.deques + owner[i];
+			d->tasks[d->back++] = order[i];
+		}
+
+		// run
+		int started = 0;
+		for(; started < s.threads; ++started){
+			workers[started].s = &s;
+			workers[started].id = started;
+			if(pthread_create(ids + started, NULL, &work, workers + started)){
+				fprintf(stderr, "ERROR: runTasks: could not start worker %d\n", started);
+				break;
+			}
+		}
+		// with fewer workers the others steal everything
+		if(!started) work(workers);
+		for(int w = 0; w < started; ++w) pthread_join(ids[w], NULL);
+	} else {
+		fprintf(stderr, "ERROR: runTasks: could not allocate deques\n");
+	}
+
+	for(int w = 0; w < s.threads; ++w){
+		free(s.deques[w].tasks);
+		pthread_mutex_destroy(&s.deques[w].lock);
+	}
+	free(owner);
+	free(order);
+	free(s.deques);
+	free(workers);
+	free(ids);
+
+	return(error);
+}
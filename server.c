@@ -0,0 +1,776 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <omp.h>
+#include <ViennaRNA/fold.h>
+#include "interaction.h"
+#include "server.h"
+
+#define READ_SIZE (64UL << 10)
+#define MAX_FIELDS 8
+#define SERVER_CACHE_MB 256 // a long running server sees the same monomers and duplexes again, -c 0 turns the cache off
+
+static int stop_pipe[2] = {-1, -1}; // written by the signal handler, wakes the accept loop
+
+static uint64_t nowNs(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return( (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec );
+}
+
+// queue
+
+static int initRequestQueue(const unsigned int capacity, struct request_queue *q){
+	memset(q, 0, sizeof(struct request_queue));
+	q->items = (struct server_request**) calloc(capacity, sizeof(struct server_request*));
+	if(!q->items){
+		fprintf(stderr, "ERROR: initRequestQueue: could not allocate queue of %u\n", capacity);
+		return(0);
+	}
+	q->capacity = capacity;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->not_empty, NULL);
+	pthread_cond_init(&q->not_full, NULL);
+	return(1);
+}
+
+static void freeRequestQueue(struct request_queue *q){
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->not_empty);
+	pthread_cond_destroy(&q->not_full);
+	free(q->items);
+	q->items = NULL;
+}
+
+static void pushRequest(struct request_queue *q, struct server_request *r){
+	pthread_mutex_lock(&q->lock);
+	while(q->count == q->capacity) pthread_cond_wait(&q->not_full, &q->lock);
+	q->items[(q->head + q->count++) % q->capacity] = r;
+	++q->pushed;
+	q->depth_sum += q->count;
+	if(q->count > q->depth_max) q->depth_max = q->count;
+	pthread_cond_signal(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+}
+
+// up to max requests, waits for the first one; 0 once the queue is closed and empty
+static unsigned int popRequests(struct request_queue *q, struct server_request **out, const unsigned int max){
+	pthread_mutex_lock(&q->lock);
+	while(!q->count && !q->closed) pthread_cond_wait(&q->not_empty, &q->lock);
+	unsigned int n = 0;
+	for(; n < max && q->count; ++n){
+		out[n] = q->items[q->head];
+		q->head = (q->head + 1) % q->capacity;
+		--q->count;
+	}
+	if(n) pthread_cond_broadcast(&q->not_full);
+	pthread_mutex_unlock(&q->lock);
+	return(n);
+}
+
+static void closeRequestQueue(struct request_queue *q){
+	pthread_mutex_lock(&q->lock);
+	q->closed = 1;
+	pthread_cond_broadcast(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+}
+
+// connections
+
+static void releaseConn(struct server_conn *c){
+	struct server *s = c->server;
+	pthread_mutex_lock(&s->lock);
+	if(--c->refs){
+		pthread_mutex_unlock(&s->lock);
+		return;
+	}
+	for(struct server_conn **p = &s->conns; *p; p = &(*p)->next){
+		if(*p == c){
+			*p = c->next;
+			break;
+		}
+	}
+	--s->no_conns;
+	pthread_cond_broadcast(&s->idle);
+	pthread_mutex_unlock(&s->lock);
+
+	if(c->in != STDIN_FILENO) close(c->in);
+	pthread_mutex_destroy(&c->lock);
+	free(c);
+}
+
+static int writeAll(const int fd, const char *data, size_t length){
+	while(length){
+		const ssize_t n = write(fd, data, length);
+		if(n < 0){
+			if(errno == EINTR) continue;
+			return(0);
+		}
+		data += n;
+		length -= n;
+	}
+	return(1);
+}
+
+// queue one request of a connection, the reader blocks while the workers are behind
+static int queueRequest(struct server_conn *c, const char *line, const size_t length, const uint64_t received){
+	struct server_request *r = (struct server_request*) malloc(sizeof(struct server_request) + length + 1);
+	if(!r){
+		fprintf(stderr, "ERROR: queueRequest: could not allocate a request of %zu bytes\n", length);
+		return(0);
+	}
+	r->conn = c;
+	r->received = received;
+	memcpy(r->line, line, length);
+	r->line[length] = '\0';
+
+	pthread_mutex_lock(&c->server->lock);
+	++c->refs;
+	pthread_mutex_unlock(&c->server->lock);
+	pushRequest(&c->server->queue, r);
+	return(1);
+}
+
+///  read the requests of a connection until it is closed
+/**
+ * Parses lines, or frames of a 4 byte big-endian length, out of a read buffer and queues them as they come, so a client can pipeline. Empty lines are skipped.
+ */
+static void* connThread(void *arg){
+	struct server_conn *c = (struct server_conn*) arg;
+	const int framed = c->server->framed;
+	size_t size = READ_SIZE, used = 0, pos = 0;
+	char *buf = (char*) malloc(size);
+
+	int eof = !buf;
+	while(!eof){
+		if(size - used < READ_SIZE / 2){
+			// drop what was parsed, grow if a request does not fit
+			memmove(buf, buf + pos, used - pos);
+			used -= pos;
+			pos = 0;
+			if(size - used < READ_SIZE / 2){
+				char *grown = (char*) realloc(buf, 2 * size);
+				if(!grown) break;
+				buf = grown;
+				size *= 2;
+			}
+		}
+		const ssize_t n = read(c->in, buf + used, size - used);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) eof = 1;
+		else used += n;
+		const uint64_t received = nowNs();
+
+		// complete requests, and at the end a last line without a newline
+		for(;;){
+			const char *begin = buf + pos;
+			size_t length, next;
+			if(framed){
+				if(used - pos < 4) break;
+				const unsigned char *h = (const unsigned char*) begin;
+				length = (size_t) h[0] << 24 | (size_t) h[1] << 16 | (size_t) h[2] << 8 | h[3];
+				if(length > SERVER_MAX_REQUEST){
+					fprintf(stderr, "ERROR: connThread: request of %zu bytes, closing the connection\n", length);
+					eof = 1;
+					break;
+				}
+				if(used - pos < 4 + length) break;
+				begin += 4;
+				next = pos + 4 + length;
+			} else {
+				const char *end = (const char*) memchr(begin, '\n', used - pos);
+				if(!end && !eof){
+					if(used - pos > SERVER_MAX_REQUEST){
+						fprintf(stderr, "ERROR: connThread: request over %u bytes, closing the connection\n", SERVER_MAX_REQUEST);
+						eof = 1;
+					}
+					break;
+				}
+				length = end ? (size_t) (end - begin) : used - pos;
+				next = end ? pos + length + 1 : used;
+				while(length && begin[length-1] == '\r') --length;
+			}
+			if(!framed && !length && next == pos) break;
+			if(length && !queueRequest(c, begin, length, received)) eof = 1;
+			pos = next;
+			if(pos == used) break;
+		}
+	}
+
+	free(buf);
+	releaseConn(c);
+	return(NULL);
+}
+
+///  serve a client, reading on in and replying on out
+/**
+ * The connection owns in from here on, it is closed (unless it is stdin) once the client is done or on error.
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int addConnection(struct server *s, const int in, const int out){
+	struct server_conn *c = (struct server_conn*) calloc(1, sizeof(struct server_conn));
+	if(!c){
+		fprintf(stderr, "ERROR: addConnection: could not allocate a connection\n");
+		if(in != STDIN_FILENO) close(in);
+		return(0);
+	}
+	c->in = in;
+	c->out = out;
+	c->refs = 1;
+	c->server = s;
+	pthread_mutex_init(&c->lock, NULL);
+
+	pthread_mutex_lock(&s->lock);
+	c->next = s->conns;
+	s->conns = c;
+	++s->no_conns;
+	++s->no_accepted;
+	pthread_mutex_unlock(&s->lock);
+
+	pthread_t thread;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	const int error = pthread_create(&thread, &attr, connThread, c);
+	pthread_attr_destroy(&attr);
+	if(error){
+		fprintf(stderr, "ERROR: addConnection: could not start a reader\n");
+		releaseConn(c);
+		return(0);
+	}
+	return(1);
+}
+
+// replies
+
+// growing buffer of the replies of a worker to one connection
+struct reply{
+	char *data;
+	size_t size, used;
+	size_t begin; // of the reply being written
+	int framed;
+};
+
+static int reserveReply(struct reply *r, const size_t length){
+	if(r->used + length <= r->size) return(1);
+	size_t size = r->size ? r->size : READ_SIZE;
+	while(r->used + length > size) size *= 2;
+	char *data = (char*) realloc(r->data, size);
+	if(!data) return(0);
+	r->data = data;
+	r->size = size;
+	return(1);
+}
+
+static void beginReply(struct reply *r, const char *id){
+	r->begin = r->used;
+	if(r->framed && reserveReply(r, 4)) r->used += 4;
+	const size_t length = strlen(id);
+	if(reserveReply(r, length)){
+		memcpy(r->data + r->used, id, length);
+		r->used += length;
+	}
+}
+
+// append a tab and a field
+static void appendField(struct reply *r, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void appendField(struct reply *r, const char *fmt, ...){
+	va_list args;
+	va_start(args, fmt);
+	const int length = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+	if(length < 0 || !reserveReply(r, length + 2)) return;
+	r->data[r->used++] = '\t';
+	va_start(args, fmt);
+	vsnprintf(r->data + r->used, length + 1, fmt, args);
+	va_end(args);
+	r->used += length;
+}
+
+static void endReply(struct reply *r){
+	if(r->framed){
+		const size_t length = r->used - r->begin - 4;
+		unsigned char *h = (unsigned char*) r->data + r->begin;
+		h[0] = length >> 24; h[1] = length >> 16; h[2] = length >> 8; h[3] = length;
+	} else if(reserveReply(r, 1)) r->data[r->used++] = '\n';
+}
+
+// requests
+
+// bases of a single strand
+static int validStrand(const char *seq){
+	if(!seq || !*seq) return(0);
+	for(const char *c = seq; *c; ++c) if(!strchr("ACGUTacgut", *c)) return(0);
+	return(1);
+}
+
+// bases of strands separated by '&'
+static int validComplex(const char *seq){
+	if(!seq || !*seq || *seq == '&') return(0);
+	for(const char *c = seq; *c; ++c){
+		if(*c == '&'){
+			if(c[1] == '&' || !c[1]) return(0);
+		} else if(!strchr("ACGUTacgut", *c)) return(0);
+	}
+	return(1);
+}
+
+// balanced dot-bracket of the length of seq, separators where seq has them
+static int validStructure(const char *str, const char *seq){
+	int depth = 0;
+	for(; *seq && *str; ++seq, ++str){
+		if((*seq == '&') != (*str == '&')) return(0);
+		if(*str == '(') ++depth;
+		else if(*str == ')'){ if(--depth < 0) return(0); }
+		else if(*str != '.' && *str != '&') return(0);
+	}
+	return( !*seq && !*str && !depth );
+}
+
+///  answer one request into the reply buffer
+/**
+ * Results in the arena of the worker are copied to the reply and released.
+ *
+ * @return 1 if it was answered with ok, 0 with an error.
+ */
+static int handleRequest(struct server *s, char *line, struct reply *r){
+	char *field[MAX_FIELDS], *save = NULL;
+	unsigned int n = 0;
+	for(char *f = strtok_r(line, "\t", &save); f && n < MAX_FIELDS; f = strtok_r(NULL, "\t", &save)) field[n++] = f;
+
+	beginReply(r, n ? field[0] : "");
+	if(n < 2){
+		appendField(r, "error");
+		appendField(r, "no operation");
+		endReply(r);
+		return(0);
+	}
+
+	struct context *ctx = s->ctx;
+	const char *op = field[1], *error = NULL;
+	char **arg = field + 2;
+	const unsigned int no_args = n - 2;
+	unsigned int length = 0;
+	for(unsigned int k = 0; k < no_args; ++k) length += strlen(arg[k]) + 1;
+	struct workspace *ws = getWorkspace(ctx, length);
+	if(!ws){
+		appendField(r, "error");
+		appendField(r, "out of memory");
+		endReply(r);
+		return(0);
+	}
+	ws->error = 0;
+
+	if(!strcmp(op, "fold")){
+		if(no_args != 1 || !validStrand(arg[0])) error = "usage: fold seq";
+		else{
+			char *structure = (char*) arenaAlloc(&ws->arena, strlen(arg[0]) + 1);
+			const float mfe = structure ? foldRNA(arg[0], structure, ctx) : 0.0;
+			if(!structure || ws->error) error = "folding failed";
+			else{
+				appendField(r, "ok");
+				appendField(r, "%s", structure);
+				appendField(r, "%.2f", mfe);
+			}
+		}
+	} else if(!strcmp(op, "fn2")){
+		char *seq[2] = {NULL, NULL}, *str[2] = {NULL, NULL};
+		if(no_args == 2 || no_args == 4){
+			const unsigned int step = no_args / 2;
+			for(unsigned int k = 0; k < 2; ++k){
+				seq[k] = arg[k*step];
+				str[k] = step == 2 ? arg[k*step+1] : NULL;
+				if(!validStrand(seq[k]) || (str[k] && !validStructure(str[k], seq[k]))) error = "usage: fn2 left_seq [left_str] right_seq [right_str]";
+			}
+		} else error = "usage: fn2 left_seq [left_str] right_seq [right_str]";
+
+		// monomers of the request are folded as addRNA does, from the table or the cache
+		for(unsigned int k = 0; k < 2 && !error; ++k){
+			if(str[k]) continue;
+			str[k] = (char*) arenaAlloc(&ws->arena, strlen(seq[k]) + 1);
+			if(!str[k]) error = "out of memory";
+			else{
+				foldRNA(seq[k], str[k], ctx);
+				if(ws->error) error = "folding failed";
+			}
+		}
+		if(!error){
+			char *compl_seq = NULL, *compl_str = NULL;
+			const double mfe = fn2(seq[0], str[0], seq[1], str[1], &compl_seq, &compl_str, ctx);
+			if(ws->error || !compl_seq || !compl_str) error = "folding failed";
+			else{
+				appendField(r, "ok");
+				appendField(r, "%s", compl_seq);
+				appendField(r, "%s", compl_str);
+				appendField(r, "%.2f", mfe);
+			}
+		}
+	} else if(!strcmp(op, "fn3")){
+		if(no_args != 2 || !validStrand(arg[0]) || !validStrand(arg[1])) error = "usage: fn3 rna1 rna2";
+		else{
+			vrna_subopt_solution_t *duplexes = fn3(arg[0], arg[1], ctx);
+			if(ws->error) error = "folding failed";
+			else{
+				const int formed = countLength(duplexes) > 0;
+				appendField(r, "ok");
+				appendField(r, "%s", formed ? duplexes[0].structure : "");
+				appendField(r, "%.2f", formed ? duplexes[0].energy : 0.0);
+			}
+		}
+	} else if(!strcmp(op, "connect3")){
+		if(no_args != 4 || !validStrand(arg[0]) || !validStrand(arg[1]) || !validStrand(arg[3])) error = "usage: connect3 duplex1 duplex2 duplex_str single";
+		else{
+			char *duplex = (char*) arenaAlloc(&ws->arena, strlen(arg[0]) + strlen(arg[1]) + 2);
+			if(!duplex) error = "out of memory";
+			else if(!validStructure(arg[2], strcat(strcat(strcpy(duplex, arg[0]), "&"), arg[1]))) error = "usage: connect3 duplex1 duplex2 duplex_str single";
+		}
+		if(!error){
+			vrna_subopt_solution_t *triplexes = connect3(arg[0], arg[1], arg[2], arg[3], ctx);
+			if(ws->error) error = "folding failed";
+			else{
+				const int formed = countLength(triplexes) > 0;
+				appendField(r, "ok");
+				appendField(r, "%s", formed ? triplexes[0].structure : "");
+				appendField(r, "%.2f", formed ? triplexes[0].energy : 0.0);
+			}
+		}
+	} else if(!strcmp(op, "fn4")){
+		if(no_args != 2 || !validComplex(arg[0]) || !validStructure(arg[1], arg[0])) error = "usage: fn4 seq str";
+		else{
+			const float energy = fn4(arg[0], arg[1], ctx);
+			if(ws->error) error = "evaluation failed";
+			else{
+				appendField(r, "ok");
+				appendField(r, "%.2f", energy);
+			}
+		}
+	} else if(!strcmp(op, "stats")){
+		char line[512];
+		serverStatsLine(s, line, sizeof(line));
+		appendField(r, "ok");
+		appendField(r, "%s", line);
+	} else error = "unknown operation";
+
+	resetArena(&ws->arena);
+	if(error){
+		appendField(r, "error");
+		appendField(r, "%s", error);
+	}
+	endReply(r);
+	return(!error);
+}
+
+static unsigned int latencyBucket(const uint64_t us){
+	const unsigned int b = us ? 64 - __builtin_clzll(us) : 0;
+	return( b < SERVER_LATENCY_BUCKETS ? b : SERVER_LATENCY_BUCKETS - 1 );
+}
+
+// write the replies of a run of requests of one connection at once, and time them
+static void flushReplies(struct server_request **requests, const unsigned int n, struct reply *r, struct server_stats *stats){
+	struct server_conn *c = requests[0]->conn;
+	pthread_mutex_lock(&c->lock);
+	if(!c->broken && !writeAll(c->out, r->data, r->used)) c->broken = 1;
+	pthread_mutex_unlock(&c->lock);
+	r->used = 0;
+
+	const uint64_t done = nowNs();
+	for(unsigned int k = 0; k < n; ++k){
+		const uint64_t us = (done - requests[k]->received) / 1000;
+		stats->latency_sum += us;
+		if(us > stats->latency_max) stats->latency_max = us;
+		++stats->latency[latencyBucket(us)];
+		free(requests[k]);
+		releaseConn(c);
+	}
+}
+
+static void* workerThread(void *arg){
+	struct server *s = (struct server*) arg;
+	struct server_request *batch[SERVER_BATCH];
+	struct reply r = {NULL, 0, 0, 0, s->framed};
+
+	unsigned int n;
+	while((n = popRequests(&s->queue, batch, SERVER_BATCH))){
+		struct server_stats local;
+		memset(&local, 0, sizeof(struct server_stats));
+
+		// the replies of consecutive requests of a connection are written together
+		unsigned int first = 0;
+		for(unsigned int k = 0; k < n; ++k){
+			++local.requests;
+			if(!handleRequest(s, batch[k]->line, &r)) ++local.errors;
+			if(k+1 == n || batch[k+1]->conn != batch[first]->conn){
+				flushReplies(batch + first, k+1 - first, &r, &local);
+				first = k+1;
+			}
+		}
+
+		pthread_mutex_lock(&s->lock);
+		s->stats.requests += local.requests;
+		s->stats.errors += local.errors;
+		s->stats.latency_sum += local.latency_sum;
+		if(local.latency_max > s->stats.latency_max) s->stats.latency_max = local.latency_max;
+		for(unsigned int b = 0; b < SERVER_LATENCY_BUCKETS; ++b) s->stats.latency[b] += local.latency[b];
+		pthread_mutex_unlock(&s->lock);
+	}
+	free(r.data);
+	return(NULL);
+}
+
+// stats
+
+// upper bound of the bucket of the q quantile, in us
+static uint64_t latencyQuantile(const struct server_stats *stats, const double q){
+	unsigned long int seen = 0;
+	for(unsigned int b = 0; b < SERVER_LATENCY_BUCKETS; ++b){
+		seen += stats->latency[b];
+		if(seen && seen >= q * stats->requests) return( 1ULL << b );
+	}
+	return(0);
+}
+
+///  the stats of a server as key=value fields, tab separated
+/**
+ * Latencies are from reading a request to writing its reply in us, quantiles rounded up to powers of 2. The queue depth is sampled on every push.
+ *
+ * @return The length of the line, as snprintf.
+ */
+int serverStatsLine(struct server *s, char *buf, const size_t size){
+	pthread_mutex_lock(&s->lock);
+	const struct server_stats stats = s->stats;
+	const unsigned int no_conns = s->no_conns;
+	const unsigned long int no_accepted = s->no_accepted;
+	pthread_mutex_unlock(&s->lock);
+
+	pthread_mutex_lock(&s->queue.lock);
+	const unsigned int depth = s->queue.count, depth_max = s->queue.depth_max;
+	const double depth_mean = s->queue.pushed ? (double) s->queue.depth_sum / s->queue.pushed : 0.0;
+	pthread_mutex_unlock(&s->queue.lock);
+
+	int length = snprintf(buf, size, "requests=%lu\terrors=%lu\tlatency_mean_us=%.1f\tlatency_p50_us=%llu\tlatency_p99_us=%llu\tlatency_max_us=%llu"
+			"\tqueue=%u\tqueue_max=%u\tqueue_mean=%.2f\tconnections=%u\taccepted=%lu",
+			stats.requests, stats.errors, stats.requests ? (double) stats.latency_sum / stats.requests : 0.0,
+			(unsigned long long) latencyQuantile(&stats, 0.5), (unsigned long long) latencyQuantile(&stats, 0.99),
+			(unsigned long long) stats.latency_max, depth, depth_max, depth_mean, no_conns, no_accepted);
+	if(s->ctx->cache && length >= 0 && (size_t) length < size){
+		struct cache_stats cs;
+		getCacheStats(s->ctx->cache, &cs);
+		length += snprintf(buf + length, size - length, "\tcache_hits=%lu\tcache_misses=%lu", cs.hits, cs.misses);
+	}
+	return(length);
+}
+
+void printServerStats(struct server *s, FILE *out){
+	pthread_mutex_lock(&s->lock);
+	const struct server_stats stats = s->stats;
+	pthread_mutex_unlock(&s->lock);
+	fprintf(out, "server: %lu requests (%lu errors), latency mean %.1f us, p50 %llu us, p99 %llu us, max %llu us, queue depth max %u mean %.2f\n",
+			stats.requests, stats.errors, stats.requests ? (double) stats.latency_sum / stats.requests : 0.0,
+			(unsigned long long) latencyQuantile(&stats, 0.5), (unsigned long long) latencyQuantile(&stats, 0.99),
+			(unsigned long long) stats.latency_max, s->queue.depth_max,
+			s->queue.pushed ? (double) s->queue.depth_sum / s->queue.pushed : 0.0);
+}
+
+// server
+
+int initServer(struct context *ctx, const int framed, struct server *s){
+	memset(s, 0, sizeof(struct server));
+	s->ctx = ctx;
+	s->framed = framed;
+	if(!initRequestQueue(SERVER_QUEUE, &s->queue)) return(0);
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->idle, NULL);
+	return(1);
+}
+
+void freeServer(struct server *s){
+	freeRequestQueue(&s->queue);
+	pthread_mutex_destroy(&s->lock);
+	pthread_cond_destroy(&s->idle);
+}
+
+static void onStop(int sig){
+	(void) sig;
+	const char c = 0;
+	if(write(stop_pipe[1], &c, 1) < 0) return;
+}
+
+static int listenSocket(const char *path){
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "ERROR: listenSocket: path %s is too long\n", path);
+		return(-1);
+	}
+	strcpy(addr.sun_path, path);
+
+	// a socket left behind by a server that was killed
+	struct stat st;
+	if(!stat(path, &st) && S_ISSOCK(st.st_mode)) unlink(path);
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) || listen(fd, 64)){
+		fprintf(stderr, "ERROR: listenSocket: could not listen on %s: %s\n", path, strerror(errno));
+		if(fd >= 0) close(fd);
+		return(-1);
+	}
+	return(fd);
+}
+
+///  answer requests until the input ends or the server is stopped
+/**
+ * Without a socket, stdin is read and replies are written to stdout until stdin ends. With a socket, clients are accepted until SIGINT or SIGTERM; then the connections are shut down for reading, and the requests already read are answered before returning. The context stays warm for the whole run, and every worker keeps its workspace.
+ *
+ * @param[in] s The server, see initServer
+ * @param[in] socket_path Path of the Unix domain socket, NULL for stdin/stdout
+ * @param[in] threads Number of worker threads. If 0, the OpenMP default is used.
+ *
+ * @return 0 on success, 1 if some error happened.
+ */
+int serve(struct server *s, const char *socket_path, const int threads){
+	const int no_workers = threads > 0 ? threads : omp_get_max_threads();
+	pthread_t *workers = (pthread_t*) calloc(no_workers, sizeof(pthread_t));
+	if(!workers){
+		fprintf(stderr, "ERROR: serve: could not allocate %d workers\n", no_workers);
+		return(1);
+	}
+	signal(SIGPIPE, SIG_IGN); // a client that went away is only a broken connection
+
+	int no_started = 0;
+	for(; no_started < no_workers; ++no_started){
+		if(pthread_create(workers + no_started, NULL, workerThread, s)) break;
+	}
+	int error = !no_started;
+	if(error) fprintf(stderr, "ERROR: serve: could not start worker threads\n");
+
+	if(!error && !socket_path) error = !addConnection(s, STDIN_FILENO, STDOUT_FILENO);
+	else if(!error){
+		const int fd = listenSocket(socket_path);
+		error = fd < 0 || pipe(stop_pipe);
+		if(!error){
+			struct sigaction sa;
+			memset(&sa, 0, sizeof(sa));
+			sa.sa_handler = onStop;
+			sigemptyset(&sa.sa_mask);
+			sigaction(SIGINT, &sa, NULL);
+			sigaction(SIGTERM, &sa, NULL);
+			fprintf(stderr, "serve: listening on %s with %d workers\n", socket_path, no_started);
+
+			struct pollfd fds[2] = {{fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+			for(;;){
+				if(poll(fds, 2, -1) < 0){
+					if(errno == EINTR) continue;
+					break;
+				}
+				if(fds[1].revents) break;
+				if(!(fds[0].revents & POLLIN)) continue;
+				const int client = accept(fd, NULL, NULL);
+				if(client < 0) continue;
+				addConnection(s, client, client);
+			}
+
+			// clients still connected get the answers to what they sent, then EOF
+			pthread_mutex_lock(&s->lock);
+			for(struct server_conn *c = s->conns; c; c = c->next) shutdown(c->in, SHUT_RD);
+			pthread_mutex_unlock(&s->lock);
+			signal(SIGINT, SIG_DFL);
+			signal(SIGTERM, SIG_DFL);
+		}
+		if(fd >= 0){
+			close(fd);
+			unlink(socket_path);
+		}
+		for(int k = 0; k < 2; ++k){
+			if(stop_pipe[k] >= 0) close(stop_pipe[k]);
+			stop_pipe[k] = -1;
+		}
+	}
+
+	// every reader is done and every reply written
+	pthread_mutex_lock(&s->lock);
+	while(s->no_conns) pthread_cond_wait(&s->idle, &s->lock);
+	pthread_mutex_unlock(&s->lock);
+
+	closeRequestQueue(&s->queue);
+	for(int i = 0; i < no_started; ++i) pthread_join(workers[i], NULL);
+	free(workers);
+	return(error);
+}
+
+int serverMain(int argc, char** argv){
+	const char *socket_path = NULL, *table_path = NULL;
+	unsigned long int cache_mb = SERVER_CACHE_MB;
+	double temperature = VRNA_MODEL_DEFAULT_TEMPERATURE;
+	int threads = 0, framed = 0, ends = 0, prefilter = 1;
+	struct subopt_limits limits = {1, -1, 0, 0}; // only the best structure is replied
+
+	int c;
+	while((c = getopt(argc, argv, "s:Lt:c:M:T:k:w:m:S:EN")) != -1){
+		switch(c){
+			case 's': socket_path = optarg; break;
+			case 'L': framed = 1; break;
+			case 't': threads = atoi(optarg); break;
+			case 'c': cache_mb = strtoul(optarg, NULL, 10); break;
+			case 'M': table_path = optarg; break;
+			case 'T': temperature = strtod(optarg, NULL); break;
+			case 'k': limits.top_k = strtoul(optarg, NULL, 10); break;
+			case 'w': limits.window = atoi(optarg); break;
+			case 'm': limits.max_count = strtoul(optarg, NULL, 10); break;
+			case 'S': limits.samples = strtoul(optarg, NULL, 10); break;
+			case 'E': ends = 1; break;
+			case 'N': prefilter = 0; break;
+			default:
+				fprintf(stderr, "usage: %s [-s socket] [-L] [-t threads] [-c cache_MB] [-M mfe.table] [-T temperature] [-k top_k] [-w window] [-m max_count] [-S samples] [-E] [-N]\n", argv[0]);
+				fprintf(stderr, "  requests: id<TAB>fold|fn2|fn3|connect3|fn4|stats<TAB>arguments..., one per line, or length-prefixed with -L\n");
+				fprintf(stderr, "  -c 0 turns the cache off, it has %d MB by default\n", SERVER_CACHE_MB);
+				return(1);
+		}
+	}
+
+	struct context ctx;
+	if(!initContext(temperature, &ctx)) return(1);
+	ctx.limits = limits;
+	ctx.ends = ends;
+	ctx.prefilter = prefilter;
+
+	struct mfetable table = {NULL, 0};
+	struct cache cache;
+	int error = 0;
+	if(table_path){
+		if(openTable(table_path, &table)) ctx.table = &table;
+		else error = 1;
+	}
+	if(!error && cache_mb){
+		if(initCache(cache_mb << 20, 64, &cache)) ctx.cache = &cache;
+		else error = 1;
+	}
+
+	struct server s;
+	if(!error && initServer(&ctx, framed, &s)){
+		error = serve(&s, socket_path, threads);
+		printServerStats(&s, stderr);
+		freeServer(&s);
+	} else error = 1;
+
+	if(ctx.prefilter && ctx.bound.applicable) printPrefilterStats(&ctx, stderr);
+	if(ctx.cache){
+		printCacheStats(ctx.cache, stderr);
+		freeCache(ctx.cache);
+	}
+	freeContext(&ctx);
+	closeTable(&table);
+	return(error);
+}
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "shard.h"
+
+///  parse a shard given as i/N
+/**
+ * @return 1 on success, 0 if s is not a shard (i must be less than N).
+ */
+int parseShard(const char *s, unsigned long int *shard, unsigned long int *no_shards){
+	char *end;
+	*shard = strtoul(s, &end, 10);
+	if(end == s || *end != '/') return(0);
+	s = end + 1;
+	*no_shards = strtoul(s, &end, 10);
+	return( end != s && !*end && *shard < *no_shards );
+}
+
+///  iterations [first, last) of a shard, the slices of all shards are disjoint and cover the run
+void shardRange(const unsigned long int iterations, const unsigned long int shard, const unsigned long int no_shards, unsigned long int *first, unsigned long int *last){
+	*first = (unsigned long int) ((unsigned __int128) iterations * shard / no_shards);
+	*last = (unsigned long int) ((unsigned __int128) iterations * (shard + 1) / no_shards);
+}
+
+///  write a checkpoint, atomically: to a temporary file that replaces the old one
+/**
+ * @return 1 on success, 0 if some error happened.
+ */
+int saveCheckpoint(const struct checkpoint *c){
+	const size_t length = strlen(c->path);
+	char *tmp = (char*) malloc(length + 5);
+	if(!tmp){
+		fprintf(stderr, "ERROR: saveCheckpoint: could not allocate path\n");
+		return(0);
+	}
+	sprintf(tmp, "%s.tmp", c->path);
+
+	FILE *f = fopen(tmp, "w");
+	int ok = f != NULL;
+	if(ok){
+		ok = fprintf(f, "%s\nseed %lu\niterations %lu\nshard %lu/%lu\nnext %lu\noffset %lu\n",
+				CHECKPOINT_MAGIC, c->seed, c->iterations, c->shard, c->no_shards, c->next, (unsigned long int) c->offset) > 0;
+		ok = !fflush(f) && !fsync(fileno(f)) && ok;
+		ok = !fclose(f) && ok;
+	}
+	ok = ok && !rename(tmp, c->path);
+	if(!ok) fprintf(stderr, "ERROR: saveCheckpoint: could not write %s\n", c->path);
+	free(tmp);
+	return(ok);
+}
+
+///  read the checkpoint at c->path, if there is one
+/**
+ * @param[in,out] c The checkpoint, path in, the rest out
+ * @param[out] found 0 if there is no checkpoint yet, c is not changed then
+ *
+ * @return 1 on success, 0 if the file can not be read or is not a checkpoint.
+ */
+int loadCheckpoint(struct checkpoint *c, int *found){
+	*found = 0;
+	FILE *f = fopen(c->path, "r");
+	if(!f){
+		if(errno == ENOENT) return(1);
+		fprintf(stderr, "ERROR: loadCheckpoint: could not open %s\n", c->path);
+		return(0);
+	}
+
+	char magic[16];
+	struct checkpoint x = *c;
+	unsigned long int offset;
+	const int ok = fscanf(f, "%15s seed %lu iterations %lu shard %lu/%lu next %lu offset %lu",
+			magic, &x.seed, &x.iterations, &x.shard, &x.no_shards, &x.next, &offset) == 7
+		&& !strcmp(magic, CHECKPOINT_MAGIC);
+	fclose(f);
+	if(!ok){
+		fprintf(stderr, "ERROR: loadCheckpoint: %s is not a checkpoint\n", c->path);
+		return(0);
+	}
+	x.offset = offset;
+	*c = x;
+	*found = 1;
+	return(1);
+}
+
+///  sync the output and record that it holds the rows of all iterations before next
+/**
+ * @param[in,out] c The checkpoint
+ * @param[in] next First iteration whose rows are not written yet
+ * @param[in] out TSV output, a file, if bin is NULL
+ * @param[in] bin Result file written instead, can be NULL
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int checkpointOutput(struct checkpoint *c, const unsigned long int next, FILE *out, struct results_writer *bin){
+	uint64_t offset;
+	if(bin){
+		if(!syncResultsWriter(bin, &offset)) return(0);
+	} else{
+		const off_t end = (fflush(out) || fsync(fileno(out))) ? -1 : ftello(out);
+		if(end < 0){
+			fprintf(stderr, "ERROR: checkpointOutput: could not flush the output\n");
+			return(0);
+		}
+		offset = end;
+	}
+	c->next = next;
+	c->offset = offset;
+	return( saveCheckpoint(c) );
+}
+
+///  concatenate the TSV outputs of shards, with the header of the first one only
+/**
+ * @return 1 on success, 0 if some error happened.
+ */
+int mergeTsv(const char **paths, const unsigned int no_paths, FILE *out){
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t length;
+	int ok = 1;
+	for(unsigned int k = 0; k < no_paths && ok; ++k){
+		FILE *in = fopen(paths[k], "r");
+		if(!in){
+			fprintf(stderr, "ERROR: mergeTsv: could not open %s\n", paths[k]);
+			ok = 0;
+			break;
+		}
+		for(unsigned long int l = 0; ok && (length = getline(&line, &size, in)) != -1; ++l){
+			if(l || !k) ok = fwrite(line, 1, length, out) == (size_t) length;
+		}
+		fclose(in);
+	}
+	free(line);
+	if(!ok) fprintf(stderr, "ERROR: mergeTsv: could not write the output\n");
+	return(ok);
+}
+
+int mergeMain(int argc, char** argv){
+	const char *output = "-";
+
+	int c;
+	while((c = getopt(argc, argv, "o:")) != -1){
+		switch(c){
+			case 'o': output = optarg; break;
+			default:
+				fprintf(stderr, "usage: %s [-o output] shard0 shard1 ...\n", argv[0]);
+				return(1);
+		}
+	}
+	if(optind == argc){
+		fprintf(stderr, "usage: %s [-o output] shard0 shard1 ...\n", argv[0]);
+		return(1);
+	}
+	const char **paths = (const char**) argv + optind;
+	const unsigned int no_paths = argc - optind;
+
+	// result files or TSV, by the magic of the first shard
+	char magic[8] = {0};
+	FILE *first = fopen(paths[0], "rb");
+	if(!first){
+		fprintf(stderr, "ERROR: could not open %s\n", paths[0]);
+		return(1);
+	}
+	const int binary = fread(magic, 1, 8, first) == 8 && !memcmp(magic, RESULTS_MAGIC, 8);
+	fclose(first);
+
+	if(binary) return( !mergeResults(paths, no_paths, output) );
+
+	FILE *out = strcmp(output, "-") ? fopen(output, "w") : stdout;
+	if(!out){
+		fprintf(stderr, "ERROR: could not open %s\n", output);
+		return(1);
+	}
+	int error = !mergeTsv(paths, no_paths, out);
+	if(out != stdout && fclose(out)) error = 1;
+	return(error);
+}
@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// one chunk of an arena
+struct arena_block{
+	struct arena_block *next;
+	size_t size, used;
+	_Alignas(16) char data[];
+};
+
+// bump allocator, everything in it is released at once with resetArena
+struct arena{
+	struct arena_block *blocks; // the block in use first
+	struct arena_block *spare; // released blocks, reused before allocating new ones
+	size_t block_size;
+};
+
+void initArena(const size_t block_size, struct arena *a);
+void freeArena(struct arena *a);
+void resetArena(struct arena *a);
+void* arenaAlloc(struct arena *a, const size_t size);
+char* arenaStrdup(struct arena *a, const char *str);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef ASSEMBLY_H
+#define ASSEMBLY_H
+
+#include "interaction.h"
+#include "pool.h"
+
+/*
+ * Assembly of N strands into one linear complex: starting from a duplex, every step binds one more strand
+ * to the free 5' or 3' end of the complex, as fn2 does with two strands. The search looks for the pathway
+ * with the lowest binding energy over all binding orders and ends.
+ */
+
+#define ASSEMBLY_MAX_STRANDS 12 // strands of a complex are packed in 5 bits each into a 64 bit key
+
+// sides a strand can bind to
+#define ASSEMBLY_3 0 // complex&strand
+#define ASSEMBLY_5 1 // strand&complex
+
+// one step of a pathway
+struct assembly_step{
+	unsigned char strand; // index in the pool
+	unsigned char side; // ASSEMBLY_3 or ASSEMBLY_5
+	float energy; // binding energy of the step
+};
+
+// a pathway and the complex it ends in
+struct assembly{
+	unsigned char first; // strand the pathway starts with
+	unsigned int no_steps; // strands of the complex - 1
+	struct assembly_step steps[ASSEMBLY_MAX_STRANDS-1];
+	unsigned char order[ASSEMBLY_MAX_STRANDS]; // strands of the complex, 5' to 3'
+	char *seq, *structure; // of the complex, strands separated by '&'
+	float energy; // of the complex
+	float binding; // energy minus the monomer MFEs
+};
+
+struct assembly_stats{
+	unsigned long int complexes; // intermediate complexes reached
+	unsigned long int bounded; // not expanded because of the bound
+	unsigned long int transpositions; // not expanded because the same order was reached with no higher energy
+};
+
+int assemble(const struct pool *p, const int threads, struct context *ctx, struct assembly *best, struct assembly_stats *stats);
+void freeAssembly(struct assembly *a);
+int assemblyMain(int argc, char** argv);
+
+#endif
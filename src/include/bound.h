@@ -0,0 +1,30 @@
+#ifndef BOUND_H
+#define BOUND_H
+
+#include <ViennaRNA/params/basic.h>
+
+/*
+ * Under the fn3 constraint only intermolecular pairs form, so the pairs of a duplex are a chain from its outer
+ * end to the end at the cut: DuplexInit, two exterior stems and the interior loops between consecutive pairs.
+ * duplexBound scores such chains with every term at or below its true energy (exact stacks and small loops,
+ * stems at their lowest over the dangles, the lowest energy of the pair type for larger loops), so if the
+ * bound is not negative, neither is the MFE of fn3 and the duplex need not be folded.
+ */
+
+#define BOUND_SMALL_LOOP 3 // interior loops with up to this many unpaired bases on either side are scored exactly
+
+// per context lower bounds, see initBound
+struct duplex_bound{
+	int applicable; // the model details allow the bound, see evalApplicable
+	int loop[NBPAIRS+1]; // interior loop larger than BOUND_SMALL_LOOP enclosing a type
+};
+
+// duplexes checked by the prefilter of fn3, per workspace
+struct prefilter_stats{
+	unsigned long int tested, rejected;
+};
+
+void initBound(const vrna_param_t *P, struct duplex_bound *b);
+int duplexBound(const char *rna1, const unsigned int length1, const char *rna2, const unsigned int length2, const struct duplex_bound *b, const vrna_param_t *P, int *tables);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <ViennaRNA/subopt/wuchty.h>
+#include "arena.h"
+
+// one memoized result
+struct cache_entry{
+	char *key;
+	unsigned long int hash;
+	float mfe;
+	char *structure; // may be NULL
+	vrna_subopt_solution_t *subopts; // may be NULL, terminated by an entry with NULL structure
+	size_t size; // bytes accounted against the budget
+	struct cache_entry *next; // chain of the bucket
+	struct cache_entry *newer, *older; // LRU order of the shard
+};
+
+struct cache_shard{
+	pthread_mutex_t lock;
+	struct cache_entry **buckets;
+	unsigned int no_buckets;
+	unsigned int count;
+	struct cache_entry *newest, *oldest;
+	size_t used, budget;
+	unsigned long int hits, misses, evictions;
+};
+
+struct cache{
+	struct cache_shard *shards;
+	unsigned int no_shards;
+};
+
+struct cache_stats{
+	unsigned long int hits, misses, evictions, entries;
+	size_t used, budget;
+};
+
+int initCache(const size_t budget, const unsigned int no_shards, struct cache *c);
+void freeCache(struct cache *c);
+int cacheGet(struct cache *c, const char *key, struct arena *a, float *mfe, char **structure, vrna_subopt_solution_t **subopts);
+void cachePut(struct cache *c, const char *key, const float mfe, const char *structure, const vrna_subopt_solution_t *subopts);
+char* cacheKey(char *buf, const char kind, const double temperature, const char *seq, const char *constraint);
+size_t cacheKeyLength(const unsigned int length);
+void getCacheStats(struct cache *c, struct cache_stats *stats);
+void printCacheStats(struct cache *c, FILE *out);
+
+#endif
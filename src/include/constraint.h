@@ -0,0 +1,43 @@
+#ifndef CONSTRAINT_H
+#define CONSTRAINT_H
+
+#include <ViennaRNA/fold_compound.h>
+
+#define CONSTRAINT_MAX_STRANDS 16 // complexes of fn2 chained by assemble
+
+// kinds of hard constraints
+enum hc_kind{
+	HC_UNPAIRED, // 'x': i stays unpaired
+	HC_PAIR,     // '(' ')': i pairs with j
+	HC_INTERMOL  // 'e': i pairs only with other strands, if at all
+};
+
+struct hc_op{
+	unsigned int i, j; // 1-based positions without separators, j only for HC_PAIR
+	unsigned char kind;
+};
+
+// hard constraints ready to apply to a fold compound, without parsing
+struct compiled_constraint{
+	struct hc_op *ops;
+	unsigned int no_ops, size;
+	unsigned int length; // bases, without separators
+	unsigned int no_strands;
+	unsigned int strand_start[CONSTRAINT_MAX_STRANDS+1]; // first base of every strand, and length+1
+	unsigned char pair_context; // context of HC_PAIR, with VRNA_CONSTRAINT_CONTEXT_ENFORCE if pairs are enforced
+	unsigned int *scratch; // bracket stack while compiling, intermolecular flags while applying
+	unsigned int scratch_size;
+};
+
+void initCompiled(struct compiled_constraint *c);
+void freeCompiled(struct compiled_constraint *c);
+int compileConstraint(const char *constraint, const unsigned int options, struct compiled_constraint *c);
+int compileFn2(const char *left_str, const unsigned int left_length, const char *right_str, const unsigned int right_length, struct compiled_constraint *c);
+int compileFn3(const unsigned int length1, const unsigned int length2, struct compiled_constraint *c);
+int compileConnect3(const char *duplex_str, const unsigned int duplex1_length, const unsigned int single_length, struct compiled_constraint *c);
+int compileFn4(const char *str, struct compiled_constraint *c);
+int permuteStrands(const struct compiled_constraint *src, const unsigned int *order, struct compiled_constraint *dst);
+int applyConstraint(vrna_fold_compound_t *fc, struct compiled_constraint *c);
+int equalCompiled(const struct compiled_constraint *a, const struct compiled_constraint *b);
+
+#endif
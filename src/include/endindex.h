@@ -0,0 +1,91 @@
+#ifndef ENDINDEX_H
+#define ENDINDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pool.h"
+
+/*
+ * An index of the sticky ends of a library of strands: the 5' (head) and 3' (tail) runs of unpaired bases of
+ * their monomer structures, the segments fn2 and makeStickyEnds leave free to pair. Every k-mer of a segment is
+ * stored as the keys it can pair with, antiparallel: its reverse complement, with G-U wobble unless noGU.
+ * A query packs the k-mers of its own open ends and looks them up, and only library strands hit by enough
+ * distinct k-mers are folded with it. Helices without k consecutive pairs are not found.
+ *
+ * The file is a CSR table that is mapped read-only and shared by any number of query processes: a bucket of
+ * postings per key (4^k + 1 offsets), the postings (library strand, segments), then the strands with their
+ * monomer folds.
+ */
+
+#define ENDINDEX_MAGIC "RNAENDX1"
+#define ENDINDEX_MAX_K 12
+
+// segments of a strand
+#define ENDINDEX_HEAD 1U // 5' dangling end, binds the tail of a left strand (fn2 with the library strand on the right)
+#define ENDINDEX_TAIL 2U // 3' dangling end, binds the head of a right strand
+
+// flags of an index
+#define ENDINDEX_WHOLE 1U // segments are the whole strands, both head and tail (the single strand of connect3 is free everywhere)
+#define ENDINDEX_WOBBLE 2U // keys include G-U pairs
+
+// file header, the sections follow at their offsets
+struct endindex_header{
+	char magic[8];
+	uint32_t k;
+	uint32_t flags;
+	double temperature; // of the monomer folds
+	uint64_t no_entries, no_postings;
+	uint64_t buckets; // offset of 4^k + 1 uint64_t, the postings of key x are [buckets[x], buckets[x+1])
+	uint64_t postings; // offset of the postings, by key and then by strand
+	uint64_t entries; // offset of the strands
+	uint64_t strings; // offset of the sequences and structures, size bytes
+	uint64_t size;
+};
+
+struct endindex_posting{
+	uint32_t entry;
+	uint32_t segments; // ENDINDEX_HEAD and/or ENDINDEX_TAIL
+};
+
+// a library strand
+struct endindex_entry{
+	uint64_t seq; // offset in the strings of its sequence, followed by its structure
+	float mfe; // of the monomer
+	uint32_t length;
+};
+
+// an index mapped into memory
+struct endindex{
+	const struct endindex_header *header;
+	const uint64_t *buckets;
+	const struct endindex_posting *postings;
+	const struct endindex_entry *entries;
+	const char *strings;
+	size_t size;
+};
+
+// seed counts of one query, one per thread
+struct endindex_query{
+	uint16_t *hits; // distinct k-mers per strand and slot, 2 * no_entries
+	uint32_t *touched; // strand * 2 + slot with hits
+	uint64_t *keys; // k-mers gathered from the open ends being seeded, see gatherEnd
+	unsigned int no_touched, keys_size, no_keys;
+};
+
+int buildEndIndex(const struct pool *p, const unsigned int k, const unsigned int flags, const double temperature, const char *path);
+int openEndIndex(const char *path, struct endindex *x);
+void closeEndIndex(struct endindex *x);
+const char* entrySeq(const struct endindex *x, const uint32_t entry);
+const char* entryStructure(const struct endindex *x, const uint32_t entry);
+
+int initEndQuery(const struct endindex *x, struct endindex_query *q);
+void freeEndQuery(struct endindex_query *q);
+int gatherEnd(const struct endindex *x, const char *segment, const unsigned int length, struct endindex_query *q);
+void seedGathered(const struct endindex *x, const unsigned int segments, const unsigned int slot, struct endindex_query *q);
+int seedEnd(const struct endindex *x, const char *segment, const unsigned int length, const unsigned int segments, const unsigned int slot, struct endindex_query *q);
+unsigned int endCandidates(struct endindex_query *q, const unsigned int min_hits, uint32_t *candidates);
+
+int indexMain(int argc, char** argv);
+int queryMain(int argc, char** argv);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef ENDS_H
+#define ENDS_H
+
+#include <ViennaRNA/model.h>
+#include "interaction.h"
+
+/*
+ * In fn2 only the 3' dangling end of the left strand and the 5' dangling end of the right strand are free,
+ * everything else is unpaired or paired as in the monomer structures. With dangles 0 or 2 the energy of
+ * such a complex splits into the energy of the fixed core and the energy of the helix the two ends form,
+ * so only the helix has to be folded: a duplex DP over the two ends, cost tail * head.
+ */
+
+int endsApplicable(const vrna_md_t *md);
+int hybridizeEnds(const char *concat, const unsigned int left_length, const char *left_str, const char *right_str, char *structure, float *mfe, struct context *ctx);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stddef.h>
+#include <ViennaRNA/model.h>
+#include <ViennaRNA/params/basic.h>
+#include "sweep.h"
+
+/*
+ * Loop energies as RNAlib scores them, in dcal/mol, straight from a set of scaled energy parameters.
+ * Bases are encoded as by RNAlib (A 1, C 2, G 3, U 4, anything else 0), types are md.pair of the bases.
+ */
+
+int encodeBase(const char c);
+int extStemEnergy(const int type, const int n5d, const int n3d, const vrna_param_t *P);
+int mlStemEnergy(const int type, const int n5d, const int n3d, const vrna_param_t *P);
+int hairpinEnergy(const unsigned int size, const int type, const int si1, const int sj1, const char *loop, const vrna_param_t *P);
+int interiorLoopEnergy(const unsigned int n1, const unsigned int n2, const int type, const int type_2, const int si1, const int sj1, const int sp1, const int sq1, const vrna_param_t *P);
+int interiorLoopBound(const unsigned int min_side, const int type_2, const vrna_param_t *P);
+
+// buffers of evalStructure, grown to the longest complex seen so far
+struct evaluator{
+	char *seq; // bases without separators, upper case, T as U
+	short *S; // encoded bases, 1-based
+	short *pt; // pair table, 1-based
+	unsigned short *strand; // strand of every base, 1-based
+	unsigned int *stack; // open brackets while reading the structure, then the union-find of the strands
+	unsigned int size;
+};
+
+// one complex of a batch
+struct eval_tuple{
+	const char *seq; // strands separated by '&'
+	const char *structure; // dot-bracket, strands separated by '&' as in seq
+	double temperature; // one of the temperatures of the sweep
+	float energy; // in kcal/mol, set by evalBatch
+	int ok; // set by evalBatch: 0 if the structure could not be evaluated
+};
+
+void initEvaluator(struct evaluator *e);
+void freeEvaluator(struct evaluator *e);
+int evalApplicable(const vrna_md_t *md);
+int evalStructure(const char *seq, const char *structure, const vrna_param_t *P, struct evaluator *e, int *energy);
+int evalBatch(const struct sweep *s, struct eval_tuple *tuples, const size_t no_tuples, const int threads);
+int evalMain(int argc, char** argv);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef HYBRID_H
+#define HYBRID_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ViennaRNA/params/basic.h>
+
+/*
+ * MFE of many short two-strand hybrids at once, under the fn3 constraint (intermolecular pairs only). Such a
+ * duplex is a chain of pairs (see bound.h), so its MFE is a DP over the pairs of rna1 x rna2 with interior
+ * loops up to MAXLOOP between them, scored as RNAlib does (energy.c). HYBRID_LANES pairs of strands are folded
+ * together, one per lane: the pairs are sorted by their lengths, shorter ones padded, and every term that
+ * differs between lanes is laid out per cell as a struct of arrays, so a loop of a given size is the same
+ * instructions for every lane. The kernel is picked at run time: AVX-512, AVX2, or plain C.
+ */
+
+#define HYBRID_LANES 16
+#define HYBRID_INF (1 << 26) // no chain, low enough that a few of them can be added to 32 bits
+
+// terms of one cell of the DP, every one HYBRID_LANES int32
+enum hybrid_plane{
+	HP_F,      // lowest chain from the outer end down to the pair of the cell
+	HP_INIT,   // DuplexInit and the outer exterior stem
+	HP_TINF,   // HYBRID_INF where the bases of the cell do not pair
+	HP_CUT,    // exterior stem at the cut
+	// the cell as the outer pair of a loop (_O) or as the inner one (_I): indices and terms of the tables
+	HP_STACK_O, HP_STACK_I,
+	HP_AU_O, HP_AU_I,
+	HP_M1N_O, HP_M1N_I,
+	HP_M23_O, HP_M23_I,
+	HP_MI_O, HP_MI_I,
+	HP_I11_O, HP_I11_I,
+	HP_I21A_O, HP_I21A_I, // int21 with 1 unpaired base in rna1
+	HP_I21B_O, HP_I21B_I, // with 2
+	HP_I22_O, HP_I22_I,
+	HYBRID_PLANES
+};
+
+// kinds of interior loops by the unpaired bases on their sides, the same for every lane
+enum hybrid_loop{LOOP_STACK, LOOP_BULGE1, LOOP_BULGE, LOOP_INT11, LOOP_INT21A, LOOP_INT21B, LOOP_INT1N, LOOP_INT22, LOOP_INT23, LOOP_GENERIC};
+
+struct hybrid_params;
+
+// folds the lanes of one group of cells, see hybrid_kernel.h
+typedef void (*hybrid_kernel)(const struct hybrid_params*, int32_t*, const unsigned int, const unsigned int, int32_t*);
+
+// a set of energy parameters prepared for the kernel, see initHybrid
+struct hybrid_params{
+	int applicable; // the model details allow the kernel, see hybridApplicable
+	const vrna_param_t *P; // tables the kernel gathers from
+	int ext[NBPAIRS+1][6][6]; // exterior stem of a type by its 5' and 3' neighbours, 0 none, else the base + 1
+	int au[NBPAIRS+1]; // TerminalAU of a type
+	unsigned char kind[MAXLOOP+1][MAXLOOP+1]; // hybrid_loop of n1 and n2 unpaired bases
+	int loop[MAXLOOP+1][MAXLOOP+1]; // the part of a loop that depends only on its size
+	hybrid_kernel kernel; // picked once by initHybrid, before any thread folds with these parameters
+	const char *kernel_name;
+};
+
+// lanes of one call, sorted by lengths
+struct hybrid_item{
+	unsigned int length1, length2;
+	size_t index;
+};
+
+// scratch memory of one thread
+struct hybrid_workspace{
+	int32_t *cells; // HYBRID_PLANES * HYBRID_LANES per cell, 64 byte aligned
+	size_t no_cells;
+	struct hybrid_item *items;
+	size_t no_items;
+	unsigned char *bases; // of the lanes of a group, padded
+	size_t no_bases;
+};
+
+int hybridApplicable(const vrna_md_t *md);
+void initHybrid(const vrna_param_t *P, struct hybrid_params *k);
+void initHybridWorkspace(struct hybrid_workspace *w);
+void freeHybridWorkspace(struct hybrid_workspace *w);
+const char* hybridKernelName(const struct hybrid_params *k);
+int hybridBatch(char **rna1, char **rna2, const size_t n, const struct hybrid_params *k, struct hybrid_workspace *w, float *mfe);
+int hybridMain(int argc, char** argv);
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * The DP of hybrid.c for one instruction set, included once for each of them. The includer defines
+ * KERNEL_NAME, KERNEL_TARGET (a function attribute), the vector type V of VLANES int32 and its operations
+ * VLOAD, VSTORE (64 byte aligned), VADD, VMIN, VSET1 and VGATHER(base, indices). Lanes [h, h+VLANES) of the
+ * cells are folded together, HYBRID_LANES / VLANES times.
+ */
+
+static KERNEL_TARGET void KERNEL_NAME(const struct hybrid_params *k, int32_t *cells, const unsigned int length1, const unsigned int length2, int32_t *mfe){
+	const vrna_param_t *P = k->P;
+	const int *stack = &P->stack[0][0], *int11 = &P->int11[0][0][0][0];
+	const int *int21 = &P->int21[0][0][0][0][0], *int22 = &P->int22[0][0][0][0][0][0];
+	const size_t stride = HYBRID_PLANES * HYBRID_LANES;
+#define PLANE(c, plane) ((c) + (plane) * HYBRID_LANES)
+
+	for(unsigned int h = 0; h < HYBRID_LANES; h += VLANES){
+		V best = VSET1(HYBRID_INF);
+		for(unsigned int a = 0; a < length1; ++a){
+			for(unsigned int j = length2; j-- > 0;){
+				int32_t *in = cells + (a * length2 + j) * stride + h;
+				V f = VLOAD(PLANE(in, HP_INIT));
+
+				// loops closed by (o,p) with n1 unpaired bases in rna1 and n2 in rna2
+				for(unsigned int n1 = 0; n1 < a && n1 <= MAXLOOP; ++n1){
+					const unsigned int o = a - 1 - n1;
+					for(unsigned int n2 = 0; n1 + n2 <= MAXLOOP && j + 1 + n2 < length2; ++n2){
+						const int32_t *out = cells + (o * length2 + j + 1 + n2) * stride + h;
+						V e;
+						switch(k->kind[n1][n2]){
+							case LOOP_STACK:
+								e = VGATHER(stack, VADD(VLOAD(PLANE(out, HP_STACK_O)), VLOAD(PLANE(in, HP_STACK_I))));
+								break;
+							case LOOP_BULGE1:
+								e = VADD(VSET1(k->loop[n1][n2]), VGATHER(stack, VADD(VLOAD(PLANE(out, HP_STACK_O)), VLOAD(PLANE(in, HP_STACK_I)))));
+								break;
+							case LOOP_BULGE:
+								e = VADD(VSET1(k->loop[n1][n2]), VADD(VLOAD(PLANE(out, HP_AU_O)), VLOAD(PLANE(in, HP_AU_I))));
+								break;
+							case LOOP_INT11:
+								e = VGATHER(int11, VADD(VLOAD(PLANE(out, HP_I11_O)), VLOAD(PLANE(in, HP_I11_I))));
+								break;
+							case LOOP_INT21A:
+								e = VGATHER(int21, VADD(VLOAD(PLANE(out, HP_I21A_O)), VLOAD(PLANE(in, HP_I21A_I))));
+								break;
+							case LOOP_INT21B:
+								e = VGATHER(int21, VADD(VLOAD(PLANE(out, HP_I21B_O)), VLOAD(PLANE(in, HP_I21B_I))));
+								break;
+							case LOOP_INT22:
+								e = VGATHER(int22, VADD(VLOAD(PLANE(out, HP_I22_O)), VLOAD(PLANE(in, HP_I22_I))));
+								break;
+							case LOOP_INT1N:
+								e = VADD(VSET1(k->loop[n1][n2]), VADD(VLOAD(PLANE(out, HP_M1N_O)), VLOAD(PLANE(in, HP_M1N_I))));
+								break;
+							case LOOP_INT23:
+								e = VADD(VSET1(k->loop[n1][n2]), VADD(VLOAD(PLANE(out, HP_M23_O)), VLOAD(PLANE(in, HP_M23_I))));
+								break;
+							default:
+								e = VADD(VSET1(k->loop[n1][n2]), VADD(VLOAD(PLANE(out, HP_MI_O)), VLOAD(PLANE(in, HP_MI_I))));
+								break;
+						}
+						f = VMIN(f, VADD(VLOAD(PLANE(out, HP_F)), e));
+					}
+				}
+
+				f = VMIN(VADD(f, VLOAD(PLANE(in, HP_TINF))), VSET1(HYBRID_INF));
+				VSTORE(PLANE(in, HP_F), f);
+				best = VMIN(best, VADD(f, VLOAD(PLANE(in, HP_CUT))));
+			}
+		}
+		// an open duplex has 0 kcal/mol
+		VSTORE(mfe + h, VMIN(best, VSET1(0)));
+	}
+#undef PLANE
+}
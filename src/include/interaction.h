@@ -0,0 +1,129 @@
+#ifndef INTERACTION_H
+#define INTERACTION_H
+
+#include <pthread.h>
+#include <ViennaRNA/fold_compound.h>
+#include <ViennaRNA/params/basic.h>
+#include <ViennaRNA/subopt/wuchty.h>
+#include <ViennaRNA/constraints/hard.h>
+#include "arena.h"
+#include "cache.h"
+#include "mfetable.h"
+#include "subopt.h"
+#include "constraint.h"
+#include "energy.h"
+#include "bound.h"
+#include "hybrid.h"
+
+// dot-bracket constraint options of the functions
+#define FN2_CONSTRAINT (VRNA_CONSTRAINT_DB_X | VRNA_CONSTRAINT_DB_INTERMOL | VRNA_CONSTRAINT_DB_DEFAULT | VRNA_CONSTRAINT_DB_PIPE)
+#define FN3_CONSTRAINT (VRNA_CONSTRAINT_DB_X | VRNA_CONSTRAINT_DB_INTERMOL | VRNA_CONSTRAINT_DB_DEFAULT | VRNA_CONSTRAINT_DB_ENFORCE_BP | VRNA_CONSTRAINT_DB_PIPE)
+#define FN4_CONSTRAINT FN3_CONSTRAINT
+#define CONNECT3_CONSTRAINT (VRNA_CONSTRAINT_DB | VRNA_CONSTRAINT_DB_X | VRNA_CONSTRAINT_DB_INTERMOL | VRNA_CONSTRAINT_DB_ENFORCE_BP)
+
+// scratch memory of one thread, grown to the longest complex seen so far
+struct workspace{
+	char *constraint;
+	char *concat;
+	char *structure;
+	char *key; // cache key, cacheKeyLength(size-1) chars
+	unsigned int size; // capacity of each buffer (with terminator)
+	struct compiled_constraint hc; // hard constraints of the last call
+	struct compiled_constraint hc_swap; // of the second orientation of connect3Ends
+	unsigned int hc_fn3[2]; // strand lengths hc was compiled for by fn3, it is reused while they match
+	int *ends; // DP tables of hybridizeEnds
+	size_t ends_size;
+	struct evaluator eval; // buffers of evalStructure
+	int *bound; // DP tables of duplexBound
+	size_t bound_size;
+	struct prefilter_stats prefilter; // of the fn3 calls of the thread
+	struct hybrid_workspace hybrid; // cells of fn3Batch
+	struct arena arena; // results of the running job
+	int error; // set when a call of the thread fails, for callers that can not tell from the result (see api.c)
+	struct workspace *next; // all workspaces of a context are chained, so they can be freed together
+};
+
+// ends of a duplex a single strand can bind to
+#define TRIPLEX_END1_5 1U // 5' end of the first member of the duplex
+#define TRIPLEX_END1_3 2U
+#define TRIPLEX_END2_5 4U
+#define TRIPLEX_END2_3 8U
+
+// triplexes of one order of the strands
+struct triplex_orientation{
+	char *seq; // strands in the order of the structures
+	vrna_subopt_solution_t *triplexes; // NULL if no triplex was formed
+	unsigned int ends; // TRIPLEX_END* flags the single strand binds in the best triplex
+};
+
+// triplexes of a single strand with every end of a duplex, see connect3Ends
+struct triplex_ends{
+	struct triplex_orientation orientation[2]; // duplex1&duplex2&single and duplex2&duplex1&single
+	int best; // orientation of the best triplex, -1 if none was formed
+	float energy[4]; // of the best triplex binding each end, in the order of the TRIPLEX_END* bits
+	const char *structure[4]; // NULL if no triplex binds that end
+	unsigned char end_orientation[4]; // orientation of those structures
+};
+
+// everything needed for folding at a given temperature, shared by all threads
+struct context{
+	vrna_md_t md; // model details
+	vrna_param_t *params; // energy parameters scaled to md.temperature
+	pthread_key_t key; // workspace of the calling thread
+	pthread_mutex_t lock; // guards the chain of workspaces
+	struct workspace *workspaces;
+	struct cache *cache; // memoized results, NULL if not used
+	const struct mfetable *table; // precomputed monomer folds, NULL if not used
+	struct subopt_limits limits; // of the suboptimal lists of fn3 and connect3
+	int dot_bracket; // add constraints as dot-bracket strings, the reference for the compiled ones
+	int ends; // fn2 folds only the dangling ends around the fixed core, see hybridizeEnds
+	int prefilter; // fn3 skips duplexes whose bound is not negative, see duplexBound
+	struct duplex_bound bound; // of params
+	struct hybrid_params hybrid; // params laid out for fn3Batch
+};
+
+int initContext(const double temperature, struct context *ctx);
+void freeContext(struct context *ctx);
+struct workspace* getWorkspace(struct context *ctx, const unsigned int length);
+struct arena* getArena(struct context *ctx);
+void getPrefilterStats(struct context *ctx, struct prefilter_stats *stats);
+void printPrefilterStats(struct context *ctx, FILE *out);
+vrna_fold_compound_t* newFoldCompound(const char *seq, struct context *ctx);
+
+float foldRNA(const char *seq, char *structure, struct context *ctx);
+
+char* fn2Constraint(const char *left_str, const unsigned int left_length, const char *right_str, const unsigned int right_length, char *constraint);
+char* fn3Constraint(const unsigned int length1, const unsigned int length2, char *constraint);
+char* connect3Constraint(const char *duplex_str, const unsigned int duplex1_length, const unsigned int single_length, char *constraint);
+char* fn4Constraint(const char *str, char *constraint);
+
+double fn2(
+		char *left_seq, char *left_str,
+		char *right_seq, char *right_str,
+		char **compl_seq, char **compl_str,
+		struct context *ctx);
+vrna_subopt_solution_t* fn3(char *rna1, char *rna2, struct context *ctx);
+int fn3Batch(char **rna1, char **rna2, const size_t n, float *mfe, struct context *ctx);
+vrna_subopt_solution_t* connect3(
+		char *duplex1_seq,
+		char *duplex2_seq,
+		char *duplex_str,
+		char *single_seq,
+		struct context *ctx);
+int connect3Ends(
+		char *duplex1_seq,
+		char *duplex2_seq,
+		char *duplex_str,
+		char *single_seq,
+		struct triplex_ends *res,
+		struct context *ctx);
+float fn4(char *seq, char *str, struct context *ctx);
+
+void freeSubopt(vrna_subopt_solution_t *l);
+vrna_subopt_solution_t* arenaSubopt(vrna_subopt_solution_t *l, struct arena *a);
+char* insertCutPoints(const char *seq, const char *structure, char *out);
+unsigned int countLength(vrna_subopt_solution_t* x);
+void makeStickyEnds(char* begin, char* end);
+char* invertSeq(char* str, struct context *ctx);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef MFETABLE_H
+#define MFETABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MFETABLE_MAGIC "RNAMFET1"
+#define MFETABLE_MAX_LENGTH 16 // structures are packed in 32 bits, 2 bits per base
+
+// file header, followed by the records of length 1, 2, ... max_length
+struct mfetable_header{
+	char magic[8];
+	uint32_t max_length;
+	uint32_t record_size;
+	double temperature;
+	uint64_t offset[MFETABLE_MAX_LENGTH+1]; // byte offset of the records of each length, indexed by the packed sequence
+};
+
+// precomputed fold of one sequence
+struct mfetable_record{
+	int32_t mfe; // in 0.01 kcal/mol
+	uint32_t structure; // 2 bits per base: 0 '.', 1 '(', 2 ')', first base in the lowest bits
+};
+
+// a table mapped into memory
+struct mfetable{
+	const struct mfetable_header *header;
+	size_t size;
+};
+
+int packSeq(const char *seq, const unsigned int length, uint64_t *index);
+void unpackSeq(uint64_t index, const unsigned int length, char *seq);
+uint32_t encodeStructure(const char *structure, const unsigned int length);
+void decodeStructure(uint32_t code, const unsigned int length, char *structure);
+
+int openTable(const char *path, struct mfetable *t);
+void closeTable(struct mfetable *t);
+int lookupTable(const struct mfetable *t, const char *seq, float *mfe, char *structure);
+
+#endif
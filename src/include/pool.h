@@ -0,0 +1,34 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include "interaction.h"
+
+#define MATRIX_MAGIC "RNAMATX1"
+
+// header of a binding energy matrix, followed by n*n floats at offset, row = left strand, column = right strand
+struct matrix_header{
+	char magic[8];
+	uint32_t n;
+	uint32_t tile;
+	double temperature;
+	uint64_t offset;
+};
+
+// strands with their monomer folds
+struct pool{
+	char **seqs;
+	char **strs;
+	double *mfe;
+	unsigned int *length;
+	unsigned int n;
+};
+
+int readPool(const char *path, struct pool *p);
+int addPool(const char *seq, struct pool *p);
+void freePool(struct pool *p);
+int foldPool(struct pool *p, const int threads, struct context *ctx);
+int poolMatrix(struct pool *p, const unsigned int tile, const int threads, struct context *ctx, const char *path);
+int poolMain(int argc, char** argv);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+// stages of the hot path that are timed
+enum probe_stage{
+	STAGE_CONSTRAINT,      // building the dot-bracket constraint (fn2 dangling ends, makeStickyEnds)
+	STAGE_FOLD_COMPOUND,   // vrna_fold_compound
+	STAGE_CONSTRAINTS_ADD, // vrna_constraints_add parsing
+	STAGE_MFE,             // vrna_mfe_dimer, vrna_mfe
+	STAGE_SUBOPT,          // suboptimal enumeration
+	STAGE_CUT_POINTS,      // reinserting the strand separators
+	NO_STAGES
+};
+
+// sizes that are histogrammed, in power of 2 buckets
+enum probe_size{
+	SIZE_STRUCTURE, // length of the folded complex, with separators
+	SIZE_SUBOPT,    // length of the suboptimal lists
+	NO_SIZES
+};
+
+#define PROBE_BUCKETS 32
+
+#ifdef PROBES
+
+#include <stdint.h>
+#include <stdio.h>
+
+uint64_t probeClock(void);
+void probeStage(const enum probe_stage stage, const uint64_t ticks);
+void probeSize(const enum probe_size size, const unsigned long int value);
+void probeDump(FILE *out);
+
+/// time a statement as a stage of the hot path, e.g. PROBE_TIME(STAGE_MFE, mfe = vrna_mfe_dimer(fc, s));
+#define PROBE_TIME(stage, ...) do{ const uint64_t probe_start = probeClock(); __VA_ARGS__; probeStage((stage), probeClock() - probe_start); }while(0)
+/// count a size in its histogram
+#define PROBE_SIZE(size, value) probeSize((size), (value))
+
+#else
+
+// compiled out: the statement is run as it is, sizes are not even evaluated
+#define PROBE_TIME(stage, ...) do{ __VA_ARGS__; }while(0)
+#define PROBE_SIZE(size, value) ((void) 0)
+
+#endif
+
+#endif
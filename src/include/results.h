@@ -0,0 +1,102 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define RESULTS_MAGIC "RNARES01"
+#define RESULTS_INDEX_MAGIC "RNARESIX"
+#define RESULTS_BLOCK_ROWS 65536
+
+// flags of a row
+#define RESULT_RNA3    1 // the row has a third strand
+#define RESULT_DUPLEX  2 // a duplex was formed
+#define RESULT_TRIPLEX 4 // a triplex was formed
+
+/*
+ * A result file is the header, blocks of rows, the index of the blocks and the trailer.
+ *
+ * Every block stores its rows column by column, in this order:
+ *   flags         uint8 per row
+ *   lengths       uint16 per row and strand (rna1, rna2, rna3; 0 if there is no rna3)
+ *   energies      int16 per row, duplex then triplex, in 0.01 kcal/mol (0 if not formed)
+ *   sequences     rna1, rna2 and rna3 of every row, 2 bits per base (A 0, C 1, G 2, U 3)
+ *   structures    duplex then triplex of every row, 2 bits per base ('.' 0, '(' 1, ')' 2)
+ * Sequences and structures start on a byte and hold 4 symbols per byte, first in the lowest bits.
+ * Strand breaks ('&') are not stored, they follow from the lengths.
+ */
+
+// file header
+struct results_header{
+	char magic[8];
+	uint32_t block_rows; // most rows in a block
+	uint32_t reserved;
+};
+
+// start of every block
+struct results_block_header{
+	uint32_t no_rows;
+	uint32_t sequence_bytes;
+	uint32_t structure_bytes;
+	uint32_t reserved;
+};
+
+// one entry of the index
+struct results_index_entry{
+	uint64_t offset; // of the block header
+	uint64_t first_row;
+	uint32_t no_rows;
+	uint32_t size; // of the block with its header
+};
+
+// last bytes of the file
+struct results_trailer{
+	uint64_t index_offset;
+	uint64_t no_blocks;
+	uint64_t no_rows;
+	char magic[8];
+};
+
+// growing byte buffer of one column
+struct results_column{
+	unsigned char *data;
+	size_t used, size;
+};
+
+// writes rows into blocks
+struct results_writer{
+	FILE *out;
+	uint64_t offset, no_rows;
+	unsigned int block_rows, rows; // rows in the current block
+	struct results_column flags, lengths, energies, sequences, structures;
+	struct results_index_entry *index;
+	uint64_t no_blocks, index_size;
+};
+
+// a result file mapped into memory
+struct results_file{
+	const unsigned char *map;
+	size_t size;
+	const struct results_trailer *trailer;
+	const struct results_index_entry *index;
+};
+
+// a decoded row, see readBlockRows
+typedef int (*row_f)(const char *rna1, const char *rna2, const char *rna3, const char *str_duplex, const char *str_triplex, const double e_duplex, const double e_triplex, void *arg);
+
+int openResultsWriter(const char *path, const unsigned int block_rows, struct results_writer *w);
+int resumeResultsWriter(const char *path, const uint64_t offset, struct results_writer *w);
+int syncResultsWriter(struct results_writer *w, uint64_t *offset);
+int addResult(struct results_writer *w, const char *rna1, const char *rna2, const char *rna3, const char *str_duplex, const char *str_triplex, const float e_duplex, const float e_triplex);
+int closeResultsWriter(struct results_writer *w);
+
+int openResults(const char *path, struct results_file *f);
+void closeResults(struct results_file *f);
+int readBlockRows(const struct results_file *f, const uint64_t block, row_f fn, void *arg);
+int writeBlockTsv(const struct results_file *f, const uint64_t block, FILE *out);
+int resultsToTsv(const char *path, FILE *out);
+int mergeResults(const char **paths, const unsigned int no_paths, const char *output);
+int convertMain(int argc, char** argv);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef RNAINTERACTION_H
+#define RNAINTERACTION_H
+
+/*
+ * Public C API of librnainteraction.so.
+ *
+ * Everything goes through a context handle made by rnaiCreate. Configure it with the rnaiSet* functions
+ * before the first call, then it can be shared: every function may be called concurrently from any number
+ * of threads on the same context. Functions return RNAI_OK or a negative status, see rnaiStatusString.
+ *
+ * Sequences are strings of A, C, G, U (T is read as U, lower case is accepted), structures are dot-bracket
+ * strings of the same length. Energies are in kcal/mol. Results are copied to memory owned by the caller.
+ *
+ * Only this header is stable; it does not depend on the headers of RNAlib. Bump RNAI_VERSION on any change.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RNAI_VERSION 2
+
+#if defined(__GNUC__)
+#define RNAI_EXPORT __attribute__((visibility("default")))
+#else
+#define RNAI_EXPORT
+#endif
+
+// status of a call
+#define RNAI_OK 0
+#define RNAI_ERROR_ARGUMENT -1 // NULL pointer, or a sequence or structure that is not valid
+#define RNAI_ERROR_MEMORY -2
+#define RNAI_ERROR_FOLD -3 // RNAlib could not fold the complex
+
+typedef struct rnai_context rnai_context;
+
+// one structure of a list
+struct rnai_structure{
+	float energy;
+	const char *structure; // strands separated by '&'
+};
+
+// list of structures sorted by energy, free it with rnaiFreeStructures
+// with sampling on, a structure drawn k times is in it k times in a row, its frequency is k / samples
+struct rnai_structures{
+	struct rnai_structure *items;
+	size_t count; // 0 if no complex was formed
+};
+
+RNAI_EXPORT int rnaiVersion(void);
+RNAI_EXPORT const char* rnaiStatusString(const int status);
+
+RNAI_EXPORT int rnaiCreate(const double temperature, rnai_context **ctx);
+RNAI_EXPORT void rnaiDestroy(rnai_context *ctx);
+RNAI_EXPORT int rnaiSetCache(rnai_context *ctx, const size_t bytes);
+RNAI_EXPORT int rnaiSetLimits(rnai_context *ctx, const unsigned int top_k, const int window, const unsigned int max_count);
+RNAI_EXPORT int rnaiSetEnds(rnai_context *ctx, const int ends);
+RNAI_EXPORT int rnaiSetSampling(rnai_context *ctx, const unsigned int samples);
+
+RNAI_EXPORT int rnaiFold(rnai_context *ctx, const char *seq, float *mfe, char *structure);
+RNAI_EXPORT int rnaiFn2(rnai_context *ctx, const char *left_seq, const char *left_str, const char *right_seq, const char *right_str, float *mfe, char *structure);
+RNAI_EXPORT int rnaiFn3(rnai_context *ctx, const char *rna1, const char *rna2, struct rnai_structures *duplexes);
+RNAI_EXPORT int rnaiConnect3(rnai_context *ctx, const char *duplex1_seq, const char *duplex2_seq, const char *duplex_str, const char *single_seq, struct rnai_structures *triplexes);
+RNAI_EXPORT int rnaiFn4(rnai_context *ctx, const char *seq, const char *str, float *mfe);
+RNAI_EXPORT void rnaiFreeStructures(struct rnai_structures *list);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
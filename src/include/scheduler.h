@@ -0,0 +1,9 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// runs one task, called from the worker threads
+typedef void (*task_f)(const unsigned long int task, const int worker, void *arg);
+
+int runTasks(const unsigned long int no_tasks, const double *cost, const int threads, task_f fn, void *arg);
+
+#endif
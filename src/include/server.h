@@ -0,0 +1,89 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "interaction.h"
+
+/*
+ * A long-lived process that keeps one folding context warm (energy parameters, the workspaces of its worker
+ * threads, the cache and the MFE table) and answers requests over stdin/stdout or a Unix domain socket.
+ * A request is a line of tab separated fields, or with -L a frame of a 4 byte big-endian length and the same
+ * fields; replies are framed like the requests. The first field is an id chosen by the client, echoed back:
+ *
+ *   id fold seq                                   id ok structure mfe
+ *   id fn2 left_seq [left_str] right_seq [right_str]   id ok seq structure mfe (monomers are folded if no structures)
+ *   id fn3 rna1 rna2                              id ok structure energy of the best duplex
+ *   id connect3 duplex1 duplex2 duplex_str single id ok structure energy of the best triplex
+ *   id fn4 seq str                                id ok energy
+ *   id stats                                      id ok key=value ... (see serverStatsLine)
+ *
+ * Complexes that were not formed have an empty structure and 0 energy. A request that fails is answered with
+ * "id error message". Requests are pipelined: a client may send many before reading, and the replies of one
+ * connection come in the order they are finished, not sent.
+ */
+
+#define SERVER_MAX_REQUEST (1U << 20) // longer requests close the connection
+#define SERVER_QUEUE 4096 // requests read ahead of the workers, readers block when it is full
+#define SERVER_BATCH 64 // requests a worker takes from the queue at once
+#define SERVER_LATENCY_BUCKETS 32 // power of 2 microseconds
+
+struct server;
+
+// a client, stdin/stdout or an accepted socket
+struct server_conn{
+	int in, out;
+	pthread_mutex_t lock; // replies of different workers are written whole
+	int refs; // its reader and its requests in flight, guarded by the server lock
+	int broken; // a write failed, later replies are dropped
+	struct server *server;
+	struct server_conn *next;
+};
+
+// a request waiting for a worker
+struct server_request{
+	struct server_conn *conn;
+	uint64_t received; // in ns, for the latency
+	char line[]; // NUL terminated fields
+};
+
+// bounded FIFO of requests, blocks when full or empty, like the batch_queue of stream.c
+struct request_queue{
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty, not_full;
+	struct server_request **items;
+	unsigned int capacity, head, count;
+	int closed;
+	unsigned long int pushed, depth_sum; // depth after each push
+	unsigned int depth_max;
+};
+
+struct server_stats{
+	unsigned long int requests, errors;
+	uint64_t latency_sum, latency_max; // in us, from reading a request to writing its reply
+	unsigned long int latency[SERVER_LATENCY_BUCKETS]; // bucket b counts latencies below 2^b us
+};
+
+struct server{
+	struct context *ctx;
+	int framed; // length-prefixed requests and replies
+	struct request_queue queue;
+	pthread_mutex_t lock; // guards the connections and the stats
+	pthread_cond_t idle; // signalled when a connection is gone
+	struct server_conn *conns;
+	unsigned int no_conns;
+	unsigned long int no_accepted;
+	struct server_stats stats;
+};
+
+int initServer(struct context *ctx, const int framed, struct server *s);
+void freeServer(struct server *s);
+int addConnection(struct server *s, const int in, const int out);
+int serve(struct server *s, const char *socket_path, const int threads);
+int serverStatsLine(struct server *s, char *buf, const size_t size);
+void printServerStats(struct server *s, FILE *out);
+int serverMain(int argc, char** argv);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "results.h"
+
+#define CHECKPOINT_MAGIC "RNACKPT1"
+
+/*
+ * A screening run of n iterations can be cut into N shards, shard i doing the iterations [i*n/N, (i+1)*n/N).
+ * Every iteration has its own random stream (see screenSeed), so a shard gives the same rows as that slice of
+ * a single run, and the outputs of the shards in order are the output of the run.
+ *
+ * A checkpoint records how far the output of a shard is complete, it is written after the output was synced.
+ * A restarted shard cuts its output back to the checkpoint and goes on from the iteration after it.
+ */
+
+// progress of one shard
+struct checkpoint{
+	const char *path; // of the checkpoint file
+	unsigned long int interval; // iterations between checkpoints
+	unsigned long int seed, iterations; // of the whole run
+	unsigned long int shard, no_shards;
+	unsigned long int next; // first iteration whose rows are not in the output yet
+	uint64_t offset; // bytes of the output holding the rows before next
+};
+
+int parseShard(const char *s, unsigned long int *shard, unsigned long int *no_shards);
+void shardRange(const unsigned long int iterations, const unsigned long int shard, const unsigned long int no_shards, unsigned long int *first, unsigned long int *last);
+int saveCheckpoint(const struct checkpoint *c);
+int loadCheckpoint(struct checkpoint *c, int *found);
+int checkpointOutput(struct checkpoint *c, const unsigned long int next, FILE *out, struct results_writer *bin);
+int mergeTsv(const char **paths, const unsigned int no_paths, FILE *out);
+int mergeMain(int argc, char** argv);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "interaction.h"
+
+#define STREAM_MAX_STRANDS 3
+
+// input, memory mapped if it is a regular file, read in chunks otherwise (pipes, stdin)
+struct reader{
+	int fd;
+	char *map; // the mapped file, or NULL
+	size_t map_size, released; // map[0..released) was given back to the kernel
+	char *chunk; // read buffer of unmapped input
+	size_t chunk_size, chunk_used;
+	size_t pos; // next unparsed byte of map or chunk
+	int eof;
+	int fasta; // FASTA or TSV, decided on the first record
+	int header; // the header of the next FASTA entry was read
+	char *record; // strands of the current record, NUL separated, reused between records
+	size_t record_size, record_used;
+	unsigned int no_strands;
+	unsigned long int line, skipped;
+};
+
+// one record of a batch: offsets of its strands in the data of the batch
+struct stream_record{
+	unsigned int strand[STREAM_MAX_STRANDS];
+	unsigned int no_strands;
+};
+
+// records parsed together, processed by one worker and written at once
+struct batch{
+	unsigned long int seq; // index of the batch in the input
+	char *data; // strands, NUL terminated
+	size_t data_size, data_used;
+	struct stream_record *records;
+	unsigned int no_records, capacity;
+	char *out; // formatted rows
+	size_t out_size, out_used;
+};
+
+// bounded FIFO of batches, blocks when full or empty
+struct batch_queue{
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty, not_full;
+	struct batch **items;
+	unsigned int capacity, head, count;
+	int closed; // no more pushes, pops return NULL once empty
+};
+
+int openReader(const char *path, struct reader *r);
+void closeReader(struct reader *r);
+int nextRecord(struct reader *r);
+int fillBatch(struct reader *r, struct batch *b);
+int initBatch(const size_t data_size, const unsigned int capacity, struct batch *b);
+void freeBatch(struct batch *b);
+int initQueue(const unsigned int capacity, struct batch_queue *q);
+void freeQueue(struct batch_queue *q);
+void pushBatch(struct batch_queue *q, struct batch *b);
+struct batch* popBatch(struct batch_queue *q);
+void closeQueue(struct batch_queue *q);
+int streamFile(const char *input, FILE *out, const int threads, struct context *ctx);
+int streamMain(int argc, char** argv);
+
+#endif
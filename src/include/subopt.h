@@ -0,0 +1,20 @@
+#ifndef SUBOPT_H
+#define SUBOPT_H
+
+#include <ViennaRNA/fold_compound.h>
+#include <ViennaRNA/subopt/wuchty.h>
+#include "arena.h"
+
+// limits of a suboptimal enumeration, 0 means no limit
+struct subopt_limits{
+	unsigned int top_k; // keep the k best structures
+	int window; // in 0.01 kcal/mol above the MFE, negative: up to 0 kcal/mol
+	unsigned int max_count; // stop widening the window when this many structures were enumerated
+	unsigned int samples; // if not 0, draw this many structures from the Boltzmann ensemble instead (see sampledSubopt)
+};
+
+vrna_subopt_solution_t* boundedSubopt(vrna_fold_compound_t *fc, const float mfe, const struct subopt_limits *limits, struct arena *a);
+vrna_subopt_solution_t* sampledSubopt(vrna_fold_compound_t *fc, const float mfe, const struct subopt_limits *limits, struct arena *a);
+unsigned int countSample(const vrna_subopt_solution_t *l, const unsigned int k);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Distributions of a screening run, kept while it runs instead of writing a row per triplet: counts, energy
+ * histograms and moments by the length of the complex, and the strongest triplexes. Every thread adds to its
+ * own summary, they are merged once the threads are done. Energies are summed in 0.01 kcal/mol integers, so
+ * the merged summary is exactly the same with any number of threads, and ties of the top list are broken by
+ * the iteration.
+ */
+
+#define SUMMARY_MAX_LENGTH 64 // complexes of more bases are counted with this length
+#define SUMMARY_BINS 80
+#define SUMMARY_BIN_WIDTH 50 // in 0.01 kcal/mol
+#define SUMMARY_MIN_ENERGY (-SUMMARY_BINS * SUMMARY_BIN_WIDTH) // lower end of the first bin, the end bins also hold what is beyond them
+
+// energies of one kind of complex of one length
+struct energy_moments{
+	uint64_t count;
+	int64_t sum, sum_squares; // in 0.01 kcal/mol
+	int min, max;
+};
+
+// complexes of one kind, duplexes or triplexes
+struct complex_summary{
+	struct energy_moments length[SUMMARY_MAX_LENGTH+1];
+	uint64_t histogram[SUMMARY_MAX_LENGTH+1][SUMMARY_BINS];
+};
+
+// a kept triplex
+struct top_entry{
+	int energy; // of the triplex, in 0.01 kcal/mol
+	unsigned long int iteration;
+	char *row; // TSV row of the triplet, as screen writes it
+};
+
+struct summary{
+	uint64_t triplets, duplexes, triplexes;
+	struct complex_summary duplex, triplex;
+	struct top_entry *top; // max-heap on (energy, iteration): the root is the first to be replaced
+	unsigned int no_top, top_size;
+};
+
+int initSummary(const unsigned int top_size, struct summary *s);
+void freeSummary(struct summary *s);
+int addTriplet(struct summary *s, const unsigned long int iteration, const char *rna1, const char *rna2, const char *rna3,
+		const char *str_duplex, const char *str_triplex, const float e_duplex, const float e_triplex);
+void mergeSummary(struct summary *to, struct summary *from);
+int writeSummary(const struct summary *s, FILE *out);
+
+#endif
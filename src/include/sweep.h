@@ -0,0 +1,21 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <ViennaRNA/fold_compound.h>
+#include <ViennaRNA/params/basic.h>
+
+// energy parameters of every temperature of a sweep, scaled once
+struct sweep{
+	vrna_md_t md; // model details at the first temperature
+	double *temperatures;
+	vrna_param_t **params;
+	unsigned int no_temperatures;
+};
+
+int initSweep(const double *temperatures, const unsigned int no_temperatures, struct sweep *s);
+int initSweepRange(const double from, const double to, const double step, struct sweep *s);
+void freeSweep(struct sweep *s);
+int sweepMfe(const struct sweep *s, const char *seq, const char *constraint, const unsigned int options, const int threads, float *mfe, char **structures);
+int sweepMain(int argc, char** argv);
+
+#endif
@@ -0,0 +1,647 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <ViennaRNA/fold.h>
+#include "interaction.h"
+#include "stream.h"
+
+#define CHUNK_SIZE (4UL << 20) // read size of unmapped input
+#define RELEASE_SIZE (64UL << 20) // mapped input is given back to the kernel in steps this large
+#define BATCH_DATA_SIZE (1UL << 20)
+#define BATCH_RECORDS 4096
+#define OUTPUT_BUFFER_SIZE (8UL << 20)
+
+// reader
+
+///  open an input of strands for streaming
+/**
+ * Regular files are memory mapped and read sequentially, everything else is read in chunks, so the memory used does not depend on the size of the input. Free it with closeReader.
+ *
+ * @param[in] path Path of the input, "-" for stdin
+ * @param[out] r The reader to init
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int openReader(const char *path, struct reader *r){
+	memset(r, 0, sizeof(struct reader));
+	r->fasta = -1;
+	r->fd = strcmp(path, "-") ? open(path, O_RDONLY) : STDIN_FILENO;
+	if(r->fd < 0){
+		fprintf(stderr, "ERROR: openReader: could not open %s\n", path);
+		return(0);
+	}
+
+	struct stat st;
+	if(!fstat(r->fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0){
+		r->map = (char*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+		if(r->map == MAP_FAILED) r->map = NULL;
+		else{
+			r->map_size = st.st_size;
+			madvise(r->map, r->map_size, MADV_SEQUENTIAL);
+		}
+	}
+
+	if(!r->map){
+		r->chunk_size = CHUNK_SIZE;
+		r->chunk = (char*) malloc(r->chunk_size);
+		if(!r->chunk){
+			fprintf(stderr, "ERROR: openReader: could not allocate read buffer\n");
+			closeReader(r);
+			return(0);
+		}
+	}
+
+	r->record_size = 1024;
+	r->record = (char*) malloc(r->record_size);
+	if(!r->record){
+		fprintf(stderr, "ERROR: openReader: could not allocate record buffer\n");
+		closeReader(r);
+		return(0);
+	}
+
+	return(1);
+}
+
+void closeReader(struct reader *r){
+	if(r->map) munmap(r->map, r->map_size);
+	if(r->fd > STDIN_FILENO) close(r->fd);
+	free(r->chunk);
+	free(r->record);
+	memset(r, 0, sizeof(struct reader));
+	r->fd = -1;
+}
+
+// the next line, without the line break, valid until the next call; 0 at the end of the input
+static int nextLine(struct reader *r, const char **line, size_t *length){
+	if(r->map){
+		if(r->pos >= r->map_size) return(0);
+
+		// give back what was parsed, so a large input does not stay resident
+		if(r->pos - r->released >= RELEASE_SIZE){
+			const size_t page = sysconf(_SC_PAGESIZE);
+			const size_t end = r->pos & ~(page - 1);
+			madvise(r->map + r->released, end - r->released, MADV_DONTNEED);
+			r->released = end;
+		}
+
+		const char *start = r->map + r->pos;
+		const char *nl = (const char*) memchr(start, '\n', r->map_size - r->pos);
+		*line = start;
+		*length = nl ? (size_t) (nl - start) : r->map_size - r->pos;
+		r->pos += *length + (nl ? 1 : 0);
+	} else {
+		char *nl = NULL;
+		for(;;){
+			nl = (char*) memchr(r->chunk + r->pos, '\n', r->chunk_used - r->pos);
+			if(nl || r->eof) break;
+
+			// keep the partial line, grow only if a single line does not fit
+			memmove(r->chunk, r->chunk + r->pos, r->chunk_used - r->pos);
+			r->chunk_used -= r->pos;
+			r->pos = 0;
+			if(r->chunk_used == r->chunk_size){
+				char *chunk = (char*) realloc(r->chunk, 2 * r->chunk_size);
+				if(!chunk){
+					fprintf(stderr, "ERROR: nextLine: line %lu does not fit in memory\n", r->line + 1);
+					return(0);
+				}
+				r->chunk = chunk;
+				r->chunk_size *= 2;
+			}
+
+			const ssize_t n = read(r->fd, r->chunk + r->chunk_used, r->chunk_size - r->chunk_used);
+			if(n <= 0) r->eof = 1;
+			else r->chunk_used += n;
+		}
+		if(r->pos >= r->chunk_used) return(0);
+
+		*line = r->chunk + r->pos;
+		*length = nl ? (size_t) (nl - *line) : r->chunk_used - r->pos;
+		r->pos += *length + (nl ? 1 : 0);
+	}
+
+	++r->line;
+	if(*length && (*line)[*length - 1] == '\r') --*length;
+	return(1);
+}
+
+// append bases to the current record, upper case RNA; separators ('&' or tab) close a strand
+static int appendRecord(struct reader *r, const char *s, const size_t length, const char separator){
+	if(r->record_used + length + 1 > r->record_size){
+		size_t size = r->record_size;
+		while(r->record_used + length + 1 > size) size *= 2;
+		char *record = (char*) realloc(r->record, size);
+		if(!record){
+			fprintf(stderr, "ERROR: appendRecord: record at line %lu does not fit in memory\n", r->line);
+			return(0);
+		}
+		r->record = record;
+		r->record_size = size;
+	}
+
+	for(size_t i = 0; i < length; ++i){
+		char c = s[i];
+		if(c == separator){
+			r->record[r->record_used++] = '\0';
+			++r->no_strands;
+			continue;
+		}
+		if(isspace((unsigned char) c)) continue;
+		c = toupper((unsigned char) c);
+		if(c == 'T') c = 'U';
+		if(c != 'A' && c != 'C' && c != 'G' && c != 'U') return(-1); // not a sequence (e.g. a header)
+		r->record[r->record_used++] = c;
+	}
+	return(1);
+}
+
+// close the last strand, drop empty ones
+static int closeRecord(struct reader *r){
+	r->record[r->record_used++] = '\0';
+	++r->no_strands;
+
+	// empty strands come from trailing separators
+	unsigned int no_strands = 0;
+	size_t used = 0;
+	for(size_t i = 0; i < r->record_used; ){
+		const size_t length = strlen(r->record + i);
+		if(length){
+			memmove(r->record + used, r->record + i, length + 1);
+			used += length + 1;
+			++no_strands;
+		}
+		i += length + 1;
+	}
+	r->record_used = used;
+	r->no_strands = no_strands;
+
+	if(no_strands < 2 || no_strands > STREAM_MAX_STRANDS){
+		++r->skipped;
+		return(0);
+	}
+	return(1);
+}
+
+///  parse the next record of the input into r->record
+/**
+ * A record is a TSV line of 2 or 3 strands, or a FASTA entry whose sequence has 2 or 3 strands separated by '&' (the sequence may span lines). T is read as U. Lines starting with '#', and TSV lines that are not sequences (e.g. a header), are skipped, as are records with a wrong number of strands.
+ *
+ * @param[in] r The reader
+ *
+ * @return 1 if a record was read, 0 at the end of the input.
+ */
+int nextRecord(struct reader *r){
+	const char *line;
+	size_t length;
+
+	for(;;){
+		r->record_used = 0;
+		r->no_strands = 0;
+
+		if(r->fasta != 1){
+			// TSV, or the format is not known yet
+			if(!nextLine(r, &line, &length)) return(0);
+			if(!length || line[0] == '#') continue;
+			if(r->fasta < 0) r->fasta = (line[0] == '>');
+			if(r->fasta == 1){
+				r->header = 1;
+				continue;
+			}
+
+			const int ok = appendRecord(r, line, length, '\t');
+			if(!ok) return(0);
+			if(ok > 0 && closeRecord(r)) return(1);
+			if(ok < 0) ++r->skipped;
+			continue;
+		}
+
+		// FASTA: an entry is the lines after its header, up to the next header
+		while(!r->header && nextLine(r, &line, &length)) r->header = (length && line[0] == '>');
+		if(!r->header) return(0);
+		r->header = 0;
+
+		int bad = 0;
+		while(nextLine(r, &line, &length)){
+			if(!length || line[0] == '#' || line[0] == ';') continue;
+			if(line[0] == '>'){
+				r->header = 1;
+				break;
+			}
+			const int ok = appendRecord(r, line, length, '&');
+			if(!ok) return(0);
+			if(ok < 0) bad = 1;
+		}
+		if(!bad && closeRecord(r)) return(1);
+		if(bad) ++r->skipped;
+	}
+}
+
+// batches
+
+int initBatch(const size_t data_size, const unsigned int capacity, struct batch *b){
+	memset(b, 0, sizeof(struct batch));
+	b->data = (char*) malloc(data_size);
+	b->records = (struct stream_record*) malloc(capacity * sizeof(struct stream_record));
+	b->out = (char*) malloc(data_size);
+	if(!b->data || !b->records || !b->out){
+		fprintf(stderr, "ERROR: initBatch: could not allocate batch\n");
+		freeBatch(b);
+		return(0);
+	}
+	b->data_size = b->out_size = data_size;
+	b->capacity = capacity;
+	return(1);
+}
+
+void freeBatch(struct batch *b){
+	free(b->data);
+	free(b->records);
+	free(b->out);
+	memset(b, 0, sizeof(struct batch));
+}
+
+///  parse records into a batch until it is full
+/**
+ * @param[in] r The reader
+ * @param[out] b The batch, its previous records are dropped. A record larger than the batch grows it.
+ *
+ * @return Number of records in the batch, 0 at the end of the input.
+ */
+int fillBatch(struct reader *r, struct batch *b){
+	b->no_records = 0;
+	b->data_used = 0;
+	b->out_used = 0;
+
+	// a record left over from the previous batch
+	int pending = r->record_used > 0;
+	while(b->no_records < b->capacity){
+		if(!pending && !nextRecord(r)) break;
+		pending = 0;
+
+		if(b->data_used + r->record_used > b->data_size){
+			if(b->no_records){
+				pending = 1;
+				break;
+			}
+			char *data = (char*) realloc(b->data, r->record_used);
+			if(!data){
+				fprintf(stderr, "ERROR: fillBatch: could not grow batch to %zu bytes\n", r->record_used);
+				break;
+			}
+			b->data = data;
+			b->data_size = r->record_used;
+		}
+
+		struct stream_record *rec = b->records + b->no_records++;
+		rec->no_strands = r->no_strands;
+		memcpy(b->data + b->data_used, r->record, r->record_used);
+		for(unsigned int s = 0, offset = 0; s < r->no_strands; ++s){
+			rec->strand[s] = b->data_used + offset;
+			offset += strlen(r->record + offset) + 1;
+		}
+		b->data_used += r->record_used;
+	}
+
+	// keep the record that did not fit for the next batch
+	if(!pending) r->record_used = 0;
+	return(b->no_records);
+}
+
+// queue
+
+int initQueue(const unsigned int capacity, struct batch_queue *q){
+	memset(q, 0, sizeof(struct batch_queue));
+	q->items = (struct batch**) calloc(capacity, sizeof(struct batch*));
+	if(!q->items){
+		fprintf(stderr, "ERROR: initQueue: could not allocate queue of %u\n", capacity);
+		return(0);
+	}
+	q->capacity = capacity;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->not_empty, NULL);
+	pthread_cond_init(&q->not_full, NULL);
+	return(1);
+}
+
+void freeQueue(struct batch_queue *q){
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->not_empty);
+	pthread_cond_destroy(&q->not_full);
+	free(q->items);
+	q->items = NULL;
+}
+
+void pushBatch(struct batch_queue *q, struct batch *b){
+	pthread_mutex_lock(&q->lock);
+	while(q->count == q->capacity) pthread_cond_wait(&q->not_full, &q->lock);
+	q->items[(q->head + q->count++) % q->capacity] = b;
+	pthread_cond_signal(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+}
+
+struct batch* popBatch(struct batch_queue *q){
+	struct batch *b = NULL;
+	pthread_mutex_lock(&q->lock);
+	while(!q->count && !q->closed) pthread_cond_wait(&q->not_empty, &q->lock);
+	if(q->count){
+		b = q->items[q->head];
+		q->head = (q->head + 1) % q->capacity;
+		--q->count;
+		pthread_cond_signal(&q->not_full);
+	}
+	pthread_mutex_unlock(&q->lock);
+	return(b);
+}
+
+void closeQueue(struct batch_queue *q){
+	pthread_mutex_lock(&q->lock);
+	q->closed = 1;
+	pthread_cond_broadcast(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+}
+
+// pipeline
+
+// shared by the reader, the workers and the writer
+struct stream{
+	struct reader *reader;
+	struct context *ctx;
+	struct batch_queue free, input;
+	struct batch **done; // finished batches by seq modulo no_batches
+	unsigned int no_batches;
+	unsigned long int no_read; // batches read, final once reading is over
+	int reading;
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+};
+
+// append a row to the output of a batch
+static int appendRow(struct batch *b, const char *row, const size_t length){
+	if(b->out_used + length + 1 > b->out_size){
+		size_t size = b->out_size;
+		while(b->out_used + length + 1 > size) size *= 2;
+		char *out = (char*) realloc(b->out, size);
+		if(!out) return(0);
+		b->out = out;
+		b->out_size = size;
+	}
+	memcpy(b->out + b->out_used, row, length);
+	b->out_used += length;
+	return(1);
+}
+
+///  bind the strands of every record of a batch, like screen does
+/**
+ * 2 strands are bound as a duplex (fn3), the 3rd one, if any, to the sticky ends of the best duplex (connect3). Every record gets a row; complexes that were not formed have empty structures and 0 energy.
+ */
+static void processBatch(struct batch *b, struct context *ctx){
+	struct arena *a = getArena(ctx);
+	char *row = NULL;
+	size_t row_size = 0;
+
+	b->out_used = 0;
+	for(unsigned int i = 0; i < b->no_records && a; ++i){
+		const struct stream_record *rec = b->records + i;
+		char *rna1 = b->data + rec->strand[0], *rna2 = b->data + rec->strand[1];
+		char *rna3 = rec->no_strands > 2 ? b->data + rec->strand[2] : NULL;
+
+		vrna_subopt_solution_t *duplexes = fn3(rna1, rna2, ctx), *triplexes = NULL;
+		if(rna3 && countLength(duplexes) > 0) triplexes = connect3(rna1, rna2, duplexes[0].structure, rna3, ctx);
+		const int duplex = countLength(duplexes) > 0, triplex = countLength(triplexes) > 0;
+
+		const size_t size = 3 * (strlen(rna1) + strlen(rna2) + (rna3 ? strlen(rna3) : 0)) + 64;
+		if(size > row_size){
+			free(row);
+			row = (char*) malloc(size);
+			row_size = row ? size : 0;
+		}
+		if(row){
+			const int length = snprintf(row, row_size, "%s\t%s\t%s\t%s\t%s\t%f\t%f\n", rna1, rna2, rna3 ? rna3 : "",
+					duplex ? duplexes[0].structure : "", triplex ? triplexes[0].structure : "",
+					duplex ? duplexes[0].energy : 0.0, triplex ? triplexes[0].energy : 0.0);
+			if(length > 0 && !appendRow(b, row, length)) fprintf(stderr, "ERROR: processBatch: could not grow output of batch %lu\n", b->seq);
+		}
+
+		resetArena(a);
+	}
+	free(row);
+}
+
+static void* readerThread(void *arg){
+	struct stream *s = (struct stream*) arg;
+	for(;;){
+		struct batch *b = popBatch(&s->free);
+		if(!b || !fillBatch(s->reader, b)){
+			if(b) pushBatch(&s->free, b);
+			break;
+		}
+		pthread_mutex_lock(&s->lock);
+		b->seq = s->no_read++;
+		pthread_mutex_unlock(&s->lock);
+		pushBatch(&s->input, b);
+	}
+
+	closeQueue(&s->input);
+	pthread_mutex_lock(&s->lock);
+	s->reading = 0;
+	pthread_cond_broadcast(&s->finished);
+	pthread_mutex_unlock(&s->lock);
+	return(NULL);
+}
+
+static void* workerThread(void *arg){
+	struct stream *s = (struct stream*) arg;
+	struct batch *b;
+	while((b = popBatch(&s->input))){
+		processBatch(b, s->ctx);
+
+		pthread_mutex_lock(&s->lock);
+		s->done[b->seq % s->no_batches] = b;
+		pthread_cond_broadcast(&s->finished);
+		pthread_mutex_unlock(&s->lock);
+	}
+	return(NULL);
+}
+
+///  bind the strands of every record of an input, streaming
+/**
+ * A reader thread parses the input into batches, worker threads bind them (see processBatch) and the calling thread writes their rows in the order of the input, a whole batch per fwrite. Batches are recycled, so memory is constant in the size of the input, and reading and writing overlap with folding.
+ *
+ * @param[in] input Path of the TSV or FASTA input, "-" for stdin (see nextRecord)
+ * @param[in] out Stream to write the rows to, it is flushed before returning. Give it a large buffer before writing to it, as streamMain does.
+ * @param[in] threads Number of worker threads. If 0, the OpenMP default is used.
+ * @param[in] ctx Folding context (temperature, model details, workspaces)
+ *
+ * @return 0 on success, 1 if some error happened.
+ */
+int streamFile(const char *input, FILE *out, const int threads, struct context *ctx){
+	const int no_workers = threads > 0 ? threads : omp_get_max_threads();
+	struct reader reader;
+	if(!openReader(input, &reader)) return(1);
+
+	struct stream s;
+	memset(&s, 0, sizeof(struct stream));
+	s.reader = &reader;
+	s.ctx = ctx;
+	s.reading = 1;
+	s.no_batches = 2 * no_workers + 2; // enough to keep every worker busy while one is read and one is written
+	pthread_mutex_init(&s.lock, NULL);
+	pthread_cond_init(&s.finished, NULL);
+
+	struct batch *batches = (struct batch*) calloc(s.no_batches, sizeof(struct batch));
+	pthread_t *workers = (pthread_t*) calloc(no_workers, sizeof(pthread_t));
+	s.done = (struct batch**) calloc(s.no_batches, sizeof(struct batch*));
+	int error = !batches || !workers || !s.done || !initQueue(s.no_batches, &s.free) || !initQueue(s.no_batches, &s.input);
+	unsigned int no_init = 0;
+	for(; !error && no_init < s.no_batches; ++no_init){
+		if(!initBatch(BATCH_DATA_SIZE, BATCH_RECORDS, batches + no_init)) error = 1;
+		else pushBatch(&s.free, batches + no_init);
+	}
+	if(error){
+		fprintf(stderr, "ERROR: streamFile: could not allocate %u batches\n", s.no_batches);
+		for(unsigned int i = 0; i < no_init; ++i) freeBatch(batches + i);
+		free(batches);
+		free(workers);
+		free(s.done);
+		if(s.free.items) freeQueue(&s.free);
+		if(s.input.items) freeQueue(&s.input);
+		closeReader(&reader);
+		return(1);
+	}
+
+	// workers first: without them the reader would block on the free batches for good
+	int no_started = 0;
+	for(; no_started < no_workers; ++no_started){
+		if(pthread_create(workers + no_started, NULL, workerThread, &s)) break;
+	}
+	pthread_t reader_thread;
+	if(!no_started || pthread_create(&reader_thread, NULL, readerThread, &s)){
+		fprintf(stderr, "ERROR: streamFile: could not start %s thread\n", no_started ? "reader" : "worker");
+		closeQueue(&s.input);
+		for(int i = 0; i < no_started; ++i) pthread_join(workers[i], NULL);
+		for(unsigned int i = 0; i < s.no_batches; ++i) freeBatch(batches + i);
+		free(batches);
+		free(workers);
+		free(s.done);
+		freeQueue(&s.free);
+		freeQueue(&s.input);
+		pthread_mutex_destroy(&s.lock);
+		pthread_cond_destroy(&s.finished);
+		closeReader(&reader);
+		return(1);
+	}
+
+	fprintf(out, "rna1\trna2\trna3\tstr_duplex\tstr_triplex\tEduplex\tEtriplex\n");
+
+	// write in input order
+	for(unsigned long int next = 0; ; ++next){
+		pthread_mutex_lock(&s.lock);
+		while(!(s.done[next % s.no_batches] && s.done[next % s.no_batches]->seq == next) && (s.reading || next < s.no_read)){
+			pthread_cond_wait(&s.finished, &s.lock);
+		}
+		struct batch *b = s.done[next % s.no_batches];
+		if(b && b->seq == next) s.done[next % s.no_batches] = NULL;
+		else b = NULL;
+		pthread_mutex_unlock(&s.lock);
+		if(!b) break;
+
+		if(fwrite(b->out, 1, b->out_used, out) != b->out_used) error = 1;
+		pushBatch(&s.free, b);
+	}
+
+	pthread_join(reader_thread, NULL);
+	for(int i = 0; i < no_started; ++i) pthread_join(workers[i], NULL);
+	if(fflush(out)) error = 1;
+
+	if(reader.skipped) fprintf(stderr, "skipped %lu records that are not 2 or 3 strands\n", reader.skipped);
+	if(error) fprintf(stderr, "ERROR: streamFile: could not write output\n");
+
+	for(unsigned int i = 0; i < s.no_batches; ++i) freeBatch(batches + i);
+	free(batches);
+	free(workers);
+	free(s.done);
+	freeQueue(&s.free);
+	freeQueue(&s.input);
+	pthread_mutex_destroy(&s.lock);
+	pthread_cond_destroy(&s.finished);
+	closeReader(&reader);
+	return(error);
+}
+
+// close an output with the buffer given to it, stdout keeps its buffer until the process exits
+static int closeOutput(FILE *out, const int file, char *buffer){
+	if(!file) return( fflush(out) != 0 );
+	const int error = fclose(out) != 0;
+	free(buffer);
+	return(error);
+}
+
+int streamMain(int argc, char** argv){
+	const char *input = "-", *output = NULL;
+	unsigned long int cache_mb = 0;
+	int threads = 0;
+	struct subopt_limits limits = {1, -1, 0, 0}; // only the best duplex and triplex are written
+
+	int c;
+	while((c = getopt(argc, argv, "i:o:t:c:k:w:m:S:")) != -1){
+		switch(c){
+			case 'i': input = optarg; break;
+			case 'o': output = optarg; break;
+			case 't': threads = atoi(optarg); break;
+			case 'c': cache_mb = strtoul(optarg, NULL, 10); break;
+			case 'k': limits.top_k = strtoul(optarg, NULL, 10); break;
+			case 'w': limits.window = atoi(optarg); break;
+			case 'm': limits.max_count = strtoul(optarg, NULL, 10); break;
+			case 'S': limits.samples = strtoul(optarg, NULL, 10); break;
+			default:
+				fprintf(stderr, "usage: %s [-i input.tsv|input.fa] [-o output.tsv] [-t threads] [-c cache_MB] [-k top_k] [-w window] [-m max_count] [-S samples]\n", argv[0]);
+				return(1);
+		}
+	}
+
+	FILE *out = output ? fopen(output, "w") : stdout;
+	if(!out){
+		fprintf(stderr, "ERROR: could not open %s\n", output);
+		return(1);
+	}
+	// rows are written in big blocks, the buffer has to be set before anything is written and kept until out is closed
+	char *buffer = (char*) malloc(OUTPUT_BUFFER_SIZE);
+	if(buffer && setvbuf(out, buffer, _IOFBF, OUTPUT_BUFFER_SIZE)){
+		free(buffer);
+		buffer = NULL;
+	}
+
+	struct context ctx;
+	if(!initContext(VRNA_MODEL_DEFAULT_TEMPERATURE, &ctx)){
+		closeOutput(out, output != NULL, buffer);
+		return(1);
+	}
+	ctx.limits = limits;
+
+	struct cache cache;
+	if(cache_mb){
+		if(!initCache(cache_mb << 20, 64, &cache)){
+			freeContext(&ctx);
+			closeOutput(out, output != NULL, buffer);
+			return(1);
+		}
+		ctx.cache = &cache;
+	}
+
+	int error = streamFile(input, out, threads, &ctx);
+
+	if(ctx.cache){
+		printCacheStats(ctx.cache, stderr);
+		freeCache(ctx.cache);
+	}
+	freeContext(&ctx);
+	if(closeOutput(out, output != NULL, buffer)) error = 1;
+	return(error);
+}
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <ViennaRNA/eval.h>
+#include <ViennaRNA/part_func.h>
+#include <ViennaRNA/sampling/basic.h>
+#include <ViennaRNA/params/basic.h>
+#include <ViennaRNA/utils/basic.h>
+#include "subopt.h"
+
+#define SUBOPT_FIRST_WINDOW 100 // 1 kcal/mol
+
+// structures kept while enumerating
+struct subopt_stream{
+	vrna_subopt_solution_t *kept; // max-heap on (energy, structure) if bounded
+	unsigned int no_kept, capacity;
+	unsigned int bounded; // capacity is a hard limit, the worst is replaced
+	unsigned int length; // length of the structures (with separators)
+	unsigned long int seen; // structures with negative energy enumerated
+	struct arena *a;
+};
+
+static int compareSolution(const vrna_subopt_solution_t *x, const vrna_subopt_solution_t *y){
+	if(x->energy < y->energy) return(-1);
+	if(x->energy > y->energy) return(1);
+	return( strcmp(x->structure, y->structure) );
+}
+
+static int compareSolutionQsort(const void *x, const void *y){
+	return( compareSolution((const vrna_subopt_solution_t*) x, (const vrna_subopt_solution_t*) y) );
+}
+
+static void siftDown(vrna_subopt_solution_t *heap, const unsigned int n, unsigned int i){
+	for(;;){
+		unsigned int largest = i, l = 2*i+1, r = 2*i+2;
+		if(l < n && compareSolution(heap + l, heap + largest) > 0) largest = l;
+		if(r < n && compareSolution(heap + r, heap + largest) > 0) largest = r;
+		if(largest == i) return;
+		vrna_subopt_solution_t tmp = heap[i];
+		heap[i] = heap[largest];
+		heap[largest] = tmp;
+		i = largest;
+	}
+}
+
+static void siftUp(vrna_subopt_solution_t *heap, unsigned int i){
+	while(i){
+		const unsigned int parent = (i-1)/2;
+		if(compareSolution(heap + i, heap + parent) <= 0) return;
+		vrna_subopt_solution_t tmp = heap[i];
+		heap[i] = heap[parent];
+		heap[parent] = tmp;
+		i = parent;
+	}
+}
+
+static void collectSolution(const char *structure, float energy, void *data){
+	struct subopt_stream *s = (struct subopt_stream*) data;
+	if(!structure || energy >= 0.0) return; // separate strands are not a complex
+	++s->seen;
+
+	if(s->no_kept == s->capacity){
+		if(s->bounded){
+			// replace the worst if this one is better
+			vrna_subopt_solution_t candidate = {energy, (char*) structure};
+			if(compareSolution(&candidate, s->kept) >= 0) return;
+			s->kept[0].energy = energy;
+			strcpy(s->kept[0].structure, structure);
+			siftDown(s->kept, s->no_kept, 0);
+			return;
+		}
+
+		// grow, the old array stays in the arena until it is reset
+		const unsigned int capacity = s->capacity ? 2 * s->capacity : 16;
+		vrna_subopt_solution_t *kept = (vrna_subopt_solution_t*) arenaAlloc(s->a, capacity * sizeof(vrna_subopt_solution_t));
+		if(!kept) return;
+		if(s->no_kept) memcpy(kept, s->kept, s->no_kept * sizeof(vrna_subopt_solution_t));
+		memset(kept + s->no_kept, 0, (capacity - s->no_kept) * sizeof(vrna_subopt_solution_t));
+		s->kept = kept;
+		s->capacity = capacity;
+	}
+
+	vrna_subopt_solution_t *slot = s->kept + s->no_kept;
+	if(!slot->structure) slot->structure = (char*) arenaAlloc(s->a, s->length + 1);
+	if(!slot->structure) return;
+	slot->energy = energy;
+	strcpy(slot->structure, structure);
+	++s->no_kept;
+	if(s->bounded) siftUp(s->kept, s->no_kept - 1);
+}
+
+///  enumerate suboptimal structures within limits, without materializing the full list
+/**
+ * Structures are streamed from vrna_subopt_cb. Only the best top_k (or at most max_count) structures with negative energy are kept, so memory does not depend on the size of the structure space. The energy window starts at 1 kcal/mol above the MFE and is doubled until top_k structures are found, max_count structures were enumerated, or the limit of the window (or 0 kcal/mol) is reached. Without any limit the result is the same as that of vrna_subopt up to 0 kcal/mol, filtered to negative energies.
+ *
+ * @param[in] fc Fold compound, with constraints, after vrna_mfe_dimer (model details need uniq_ML)
+ * @param[in] mfe MFE of the fold compound
+ * @param[in] limits Limits of the enumeration
+ * @param[in] a Arena the result is allocated in
+ *
+ * @return List sorted by energy (ties by structure), terminated by an entry with NULL structure. NULL if there is no structure with negative energy, or memory could not be allocated.
+ */
+vrna_subopt_solution_t* boundedSubopt(vrna_fold_compound_t *fc, const float mfe, const struct subopt_limits *limits, struct arena *a){
+	if(mfe >= 0.0) return(NULL);
+
+	// the widest window: up to 0 kcal/mol, or the limit
+	int max_delta = (int)(-mfe*100.0)+1; // delta * 0.01 kcal/mol
+	if(limits->window >= 0 && limits->window < max_delta) max_delta = limits->window;
+
+	struct subopt_stream s;
+	memset(&s, 0, sizeof(s));
+	s.a = a;
+	s.length = fc->length + fc->strands - 1;
+	if(limits->top_k || limits->max_count){
+		s.bounded = 1;
+		s.capacity = limits->top_k ? limits->top_k : limits->max_count;
+		if(limits->max_count && limits->max_count < s.capacity) s.capacity = limits->max_count;
+		s.kept = (vrna_subopt_solution_t*) arenaAlloc(a, s.capacity * sizeof(vrna_subopt_solution_t));
+		if(!s.kept) return(NULL);
+		memset(s.kept, 0, s.capacity * sizeof(vrna_subopt_solution_t));
+	}
+
+	// with a bounded list, the window is widened only while needed
+	int delta = (s.bounded && SUBOPT_FIRST_WINDOW < max_delta) ? SUBOPT_FIRST_WINDOW : max_delta;
+	for(;;){
+		s.no_kept = 0;
+		s.seen = 0;
+		vrna_subopt_cb(fc, delta, &collectSolution, &s);
+
+		if(delta >= max_delta) break;
+		if(limits->top_k && s.no_kept >= limits->top_k) break;
+		if(limits->max_count && s.seen >= limits->max_count) break;
+		delta = (2 * delta < max_delta) ? 2 * delta : max_delta;
+	}
+
+	if(!s.no_kept) return(NULL);
+
+	// sorted and terminated
+	vrna_subopt_solution_t *l = (vrna_subopt_solution_t*) arenaAlloc(a, (s.no_kept + 1) * sizeof(vrna_subopt_solution_t));
+	if(!l) return(NULL);
+	memcpy(l, s.kept, s.no_kept * sizeof(vrna_subopt_solution_t));
+	qsort(l, s.no_kept, sizeof(vrna_subopt_solution_t), &compareSolutionQsort);
+	l[s.no_kept].energy = 0.0;
+	l[s.no_kept].structure = NULL;
+
+	return(l);
+}
+
+// structures drawn by stochastic backtracking
+struct sample_stream{
+	vrna_subopt_solution_t *drawn; // structures as RNAlib gives them, energies not set yet
+	unsigned int no_drawn, capacity;
+	unsigned int length; // of those structures
+	struct arena *a;
+};
+
+#ifdef __GLIBC__
+// generator of the draws of one complex, as vrna_init_rand_seed would seed the global one of RNAlib
+struct sample_rng{
+	unsigned short state[3];
+	struct drand48_data data;
+};
+
+static __thread struct sample_rng *sampling = NULL; // of the complex this thread draws from, if any
+
+static void seedSample(struct sample_rng *r, const unsigned int seed){
+	memset(r, 0, sizeof(struct sample_rng));
+	r->state[0] = r->state[1] = r->state[2] = (unsigned short) seed;
+	r->state[1] += (unsigned short) (seed >> 6);
+	r->state[2] += (unsigned short) (seed >> 12);
+}
+
+// vrna_urn advances the one generator of the process, xsubi, by erand48 of glibc: interposed, a sampling thread advances its own instead, so draws need no lock
+double erand48(unsigned short xsubi[3]){
+	static __thread struct drand48_data data; // of the other callers
+	struct sample_rng *r = sampling;
+	double x;
+	erand48_r(r ? r->state : xsubi, r ? &r->data : &data, &x);
+	return(x);
+}
+#else
+// the random generator of RNAlib is global, draws are serialized to keep them reproducible
+static pthread_mutex_t sampling_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void collectSample(const char *structure, void *data){
+	struct sample_stream *s = (struct sample_stream*) data;
+	if(!structure || s->no_drawn == s->capacity) return;
+	char *copy = (char*) arenaAlloc(s->a, s->length + 1);
+	if(!copy) return;
+	s->drawn[s->no_drawn].energy = 0.0;
+	s->drawn[s->no_drawn].structure = strcpy(copy, structure);
+	++s->no_drawn;
+}
+
+static int compareStructureQsort(const void *x, const void *y){
+	return( strcmp(((const vrna_subopt_solution_t*) x)->structure, ((const vrna_subopt_solution_t*) y)->structure) );
+}
+
+// seed of the draws of a complex, so the same complex always gets the same sample
+static unsigned int sampleSeed(const char *seq){
+	unsigned int h = 2166136261U; // FNV-1a
+	for(; *seq; ++seq) h = (h ^ (unsigned char) *seq) * 16777619U;
+	return(h);
+}
+
+// copy a structure of fc with '&' between its strands
+static char* insertSeparators(const vrna_fold_compound_t *fc, const char *structure, char *out){
+	if(strlen(structure) != fc->length) return( strcpy(out, structure) ); // it has them already
+	char *o = out;
+	unsigned int s = 0;
+	for(unsigned int i = 1; i <= fc->length; ++i){
+		*o++ = structure[i-1];
+		if(s + 1 < fc->strands && i == fc->strand_end[s]){
+			*o++ = '&';
+			++s;
+		}
+	}
+	*o = '\0';
+	return(out);
+}
+
+///  draw structures from the Boltzmann ensemble instead of enumerating them
+/**
+ * The partition function of the complex is computed once (scaled around the MFE), then limits->samples structures are drawn by stochastic backtracking and evaluated. The cost is fixed by the number of samples, unlike that of vrna_subopt, which grows with the number of structures up to 0 kcal/mol. The draws of a complex are seeded from its sequence, so they do not depend on the thread or on the order of the calls.
+ *
+ * The list has the shape of that of boundedSubopt: sorted by energy, only structures with negative energy (the separate strands are not a complex), terminated by an entry with NULL structure. A structure drawn more than once is in it as many times, next to each other and sharing its string, so its frequency is countSample / limits->samples.
+ *
+ * @param[in] fc Fold compound, with constraints, after vrna_mfe_dimer (model details need uniq_ML)
+ * @param[in] mfe MFE of the fold compound
+ * @param[in] limits Only samples is used
+ * @param[in] a Arena the result is allocated in
+ *
+ * @return The list, NULL if no complex was drawn, or memory could not be allocated.
+ */
+vrna_subopt_solution_t* sampledSubopt(vrna_fold_compound_t *fc, const float mfe, const struct subopt_limits *limits, struct arena *a){
+	if(mfe >= 0.0 || !limits->samples) return(NULL);
+
+	// partition function, Boltzmann factors scaled to the MFE so they do not overflow
+	double scale = mfe;
+	vrna_exp_params_rescale(fc, &scale);
+	vrna_pf(fc, NULL);
+
+	struct sample_stream s;
+	memset(&s, 0, sizeof(s));
+	s.a = a;
+	s.capacity = limits->samples;
+	s.length = fc->length + fc->strands - 1;
+	s.drawn = (vrna_subopt_solution_t*) arenaAlloc(a, s.capacity * sizeof(vrna_subopt_solution_t));
+	if(!s.drawn) return(NULL);
+
+#ifdef __GLIBC__
+	struct sample_rng rng;
+	seedSample(&rng, sampleSeed(fc->sequence));
+	sampling = &rng;
+	vrna_pbacktrack_cb(fc, limits->samples, &collectSample, &s, VRNA_PBACKTRACK_DEFAULT);
+	sampling = NULL;
+#else
+	pthread_mutex_lock(&sampling_lock);
+	vrna_init_rand_seed(sampleSeed(fc->sequence));
+	vrna_pbacktrack_cb(fc, limits->samples, &collectSample, &s, VRNA_PBACKTRACK_DEFAULT);
+	pthread_mutex_unlock(&sampling_lock);
+#endif
+
+	// every distinct structure is evaluated once and gets the separators, copies share it
+	qsort(s.drawn, s.no_drawn, sizeof(vrna_subopt_solution_t), &compareStructureQsort);
+	unsigned int n = 0;
+	for(unsigned int k = 0; k < s.no_drawn; ++k){
+		if(k && !strcmp(s.drawn[k].structure, s.drawn[k-1].structure)) s.drawn[k].energy = s.drawn[k-1].energy;
+		else s.drawn[k].energy = vrna_eval_structure(fc, s.drawn[k].structure);
+		if(s.drawn[k].energy < 0.0) ++n;
+	}
+	if(!n) return(NULL);
+
+	vrna_subopt_solution_t *l = (vrna_subopt_solution_t*) arenaAlloc(a, (n + 1) * sizeof(vrna_subopt_solution_t));
+	if(!l) return(NULL);
+	n = 0;
+	for(unsigned int k = 0; k < s.no_drawn; ++k){
+		if(s.drawn[k].energy >= 0.0) continue; // separate strands are not a complex
+		l[n].energy = s.drawn[k].energy;
+		if(n && !strcmp(s.drawn[k].structure, s.drawn[k-1].structure)) l[n].structure = l[n-1].structure;
+		else{
+			l[n].structure = (char*) arenaAlloc(a, s.length + 1);
+			if(!l[n].structure) return(NULL);
+			insertSeparators(fc, s.drawn[k].structure, l[n].structure);
+		}
+		++n;
+	}
+	qsort(l, n, sizeof(vrna_subopt_solution_t), &compareSolutionQsort);
+	l[n].energy = 0.0;
+	l[n].structure = NULL;
+
+	return(l);
+}
+
+///  how often the k-th structure of a sampled list was drawn: the length of its run of copies
+unsigned int countSample(const vrna_subopt_solution_t *l, const unsigned int k){
+	unsigned int first = k, last = k;
+	while(first && l[first-1].structure && !strcmp(l[first-1].structure, l[k].structure)) --first;
+	while(l[last+1].structure && !strcmp(l[last+1].structure, l[k].structure)) ++last;
+	return(last - first + 1);
+}
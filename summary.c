@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "summary.h"
+
+///  an empty summary, keeping the top_size strongest triplexes
+/**
+ * @return 1 on success, 0 if some error happened.
+ */
+int initSummary(const unsigned int top_size, struct summary *s){
+	memset(s, 0, sizeof(struct summary));
+	for(unsigned int l = 0; l <= SUMMARY_MAX_LENGTH; ++l){
+		s->duplex.length[l].min = s->triplex.length[l].min = INT32_MAX;
+		s->duplex.length[l].max = s->triplex.length[l].max = INT32_MIN;
+	}
+	if(top_size){
+		s->top = (struct top_entry*) calloc(top_size, sizeof(struct top_entry));
+		if(!s->top){
+			fprintf(stderr, "ERROR: initSummary: could not allocate the top %u\n", top_size);
+			return(0);
+		}
+	}
+	s->top_size = top_size;
+	return(1);
+}
+
+void freeSummary(struct summary *s){
+	for(unsigned int k = 0; k < s->no_top; ++k) free(s->top[k].row);
+	free(s->top);
+	s->top = NULL;
+	s->no_top = s->top_size = 0;
+}
+
+static int fixedEnergy(const float e){
+	return( (int) lroundf(e * 100.0f) );
+}
+
+static void addEnergy(struct complex_summary *c, const unsigned int length, const int e){
+	const unsigned int l = length < SUMMARY_MAX_LENGTH ? length : SUMMARY_MAX_LENGTH;
+	struct energy_moments *m = c->length + l;
+	++m->count;
+	m->sum += e;
+	m->sum_squares += (int64_t) e * e;
+	if(e < m->min) m->min = e;
+	if(e > m->max) m->max = e;
+
+	const int bin = (e - SUMMARY_MIN_ENERGY) / SUMMARY_BIN_WIDTH;
+	++c->histogram[l][bin < 0 ? 0 : (bin >= SUMMARY_BINS ? SUMMARY_BINS - 1 : bin)];
+}
+
+// top list
+
+// a is replaced before b
+static inline int weaker(const struct top_entry *a, const struct top_entry *b){
+	return( a->energy > b->energy || (a->energy == b->energy && a->iteration > b->iteration) );
+}
+
+static int topAccepts(const struct summary *s, const struct top_entry *e){
+	return( s->no_top < s->top_size || (s->top_size && weaker(s->top, e)) );
+}
+
+// add an entry the top accepts, the summary owns its row from here on
+static void pushTop(struct summary *s, const struct top_entry *e){
+	struct top_entry *h = s->top;
+	unsigned int i;
+	if(s->no_top < s->top_size){
+		// sift up from the new leaf
+		for(i = s->no_top++; i && weaker(e, h + (i-1)/2); i = (i-1)/2) h[i] = h[(i-1)/2];
+	} else {
+		// replace the root and sift down
+		free(h[0].row);
+		for(i = 0; 2*i+1 < s->no_top;){
+			unsigned int c = 2*i+1;
+			if(c+1 < s->no_top && weaker(h + c+1, h + c)) ++c;
+			if(!weaker(h + c, e)) break;
+			h[i] = h[c];
+			i = c;
+		}
+	}
+	h[i] = *e;
+}
+
+static int compareTop(const void *a, const void *b){
+	const struct top_entry *x = (const struct top_entry*) a, *y = (const struct top_entry*) b;
+	return( weaker(x, y) - weaker(y, x) );
+}
+
+///  add one iteration of the screening loop
+/**
+ * @param[in] s Summary of the calling thread
+ * @param[in] iteration Index of the iteration, breaks ties of the top list
+ * @param[in] rna1 First strand
+ * @param[in] rna2 Second strand
+ * @param[in] rna3 Third strand
+ * @param[in] str_duplex Structure of the best duplex, NULL if no duplex was formed
+ * @param[in] str_triplex Structure of the best triplex, NULL if no triplex was formed
+ * @param[in] e_duplex Energy of the duplex
+ * @param[in] e_triplex Energy of the triplex
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int addTriplet(struct summary *s, const unsigned long int iteration, const char *rna1, const char *rna2, const char *rna3,
+		const char *str_duplex, const char *str_triplex, const float e_duplex, const float e_triplex){
+	++s->triplets;
+	if(!rna1 || !rna2 || !str_duplex) return(1);
+
+	const unsigned int length = strlen(rna1) + strlen(rna2);
+	++s->duplexes;
+	addEnergy(&s->duplex, length, fixedEnergy(e_duplex));
+	if(!rna3 || !str_triplex) return(1);
+
+	++s->triplexes;
+	struct top_entry e = {fixedEnergy(e_triplex), iteration, NULL};
+	addEnergy(&s->triplex, length + strlen(rna3), e.energy);
+	if(!topAccepts(s, &e)) return(1);
+
+	const int size = snprintf(NULL, 0, "%s\t%s\t%s\t%s\t%s\t%f\t%f", rna1, rna2, rna3, str_duplex, str_triplex, e_duplex, e_triplex);
+	e.row = (char*) malloc(size + 1);
+	if(!e.row){
+		fprintf(stderr, "ERROR: addTriplet: could not allocate a row of %d\n", size);
+		return(0);
+	}
+	sprintf(e.row, "%s\t%s\t%s\t%s\t%s\t%f\t%f", rna1, rna2, rna3, str_duplex, str_triplex, e_duplex, e_triplex);
+	pushTop(s, &e);
+	return(1);
+}
+
+static void mergeComplex(struct complex_summary *to, const struct complex_summary *from){
+	for(unsigned int l = 0; l <= SUMMARY_MAX_LENGTH; ++l){
+		struct energy_moments *m = to->length + l;
+		const struct energy_moments *n = from->length + l;
+		m->count += n->count;
+		m->sum += n->sum;
+		m->sum_squares += n->sum_squares;
+		if(n->min < m->min) m->min = n->min;
+		if(n->max > m->max) m->max = n->max;
+		for(unsigned int b = 0; b < SUMMARY_BINS; ++b) to->histogram[l][b] += from->histogram[l][b];
+	}
+}
+
+///  add the counts of a summary to another one
+/**
+ * The rows of the top list of from are moved to the one of to, from is left with an empty top list.
+ */
+void mergeSummary(struct summary *to, struct summary *from){
+	to->triplets += from->triplets;
+	to->duplexes += from->duplexes;
+	to->triplexes += from->triplexes;
+	mergeComplex(&to->duplex, &from->duplex);
+	mergeComplex(&to->triplex, &from->triplex);
+
+	for(unsigned int k = 0; k < from->no_top; ++k){
+		if(topAccepts(to, from->top + k)) pushTop(to, from->top + k);
+		else free(from->top[k].row);
+	}
+	from->no_top = 0;
+}
+
+static void writeComplex(const struct complex_summary *c, const char *kind, FILE *out){
+	for(unsigned int l = 0; l <= SUMMARY_MAX_LENGTH; ++l){
+		const struct energy_moments *m = c->length + l;
+		if(!m->count) continue;
+		const double mean = (double) m->sum / m->count;
+		const double variance = m->count > 1 ? ((double) m->sum_squares - mean * m->sum) / (m->count - 1) : 0.0;
+		fprintf(out, "energy\t%s\t%u\t%lu\t%.4f\t%.4f\t%.2f\t%.2f\n", kind, l, (unsigned long int) m->count,
+				mean / 100.0, sqrt(variance > 0.0 ? variance : 0.0) / 100.0, m->min / 100.0, m->max / 100.0);
+	}
+	for(unsigned int l = 0; l <= SUMMARY_MAX_LENGTH; ++l){
+		for(unsigned int b = 0; b < SUMMARY_BINS; ++b){
+			if(c->histogram[l][b]) fprintf(out, "histogram\t%s\t%u\t%.2f\t%lu\n", kind, l,
+					(SUMMARY_MIN_ENERGY + (int) b * SUMMARY_BIN_WIDTH) / 100.0, (unsigned long int) c->histogram[l][b]);
+		}
+	}
+}
+
+///  write a summary as TSV, the first column telling the kind of line
+/**
+ * Lengths are of the whole complex, in bases. Histogram lines give the lower end of the bin in kcal/mol, empty bins are left out. The top triplexes are written from the strongest.
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int writeSummary(const struct summary *s, FILE *out){
+	fprintf(out, "triplets\t%lu\n", (unsigned long int) s->triplets);
+	fprintf(out, "duplexes\t%lu\t%.6f\n", (unsigned long int) s->duplexes, s->triplets ? (double) s->duplexes / s->triplets : 0.0);
+	fprintf(out, "triplexes\t%lu\t%.6f\n", (unsigned long int) s->triplexes, s->triplets ? (double) s->triplexes / s->triplets : 0.0);
+
+	fprintf(out, "#energy\tkind\tlength\tcount\tmean\tsd\tmin\tmax\n");
+	fprintf(out, "#histogram\tkind\tlength\tfrom\tcount\n");
+	writeComplex(&s->duplex, "duplex", out);
+	writeComplex(&s->triplex, "triplex", out);
+
+	fprintf(out, "#top\trank\trna1\trna2\trna3\tstr_duplex\tstr_triplex\tEduplex\tEtriplex\n");
+	if(s->no_top){
+		struct top_entry *sorted = (struct top_entry*) malloc(s->no_top * sizeof(struct top_entry));
+		if(!sorted){
+			fprintf(stderr, "ERROR: writeSummary: could not sort the top %u\n", s->no_top);
+			return(0);
+		}
+		memcpy(sorted, s->top, s->no_top * sizeof(struct top_entry));
+		qsort(sorted, s->no_top, sizeof(struct top_entry), compareTop);
+		for(unsigned int k = 0; k < s->no_top; ++k) fprintf(out, "top\t%u\t%s\n", k+1, sorted[k].row);
+		free(sorted);
+	}
+	return( !ferror(out) );
+}
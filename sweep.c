@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <omp.h>
+#include <ViennaRNA/fold.h>
+#include <ViennaRNA/constraints/hard.h>
+#include "interaction.h"
+#include "sweep.h"
+
+///  init a temperature sweep
+/**
+ * Energy parameters are scaled to every temperature here, once for all the sequence sets swept with it. Free it with freeSweep.
+ *
+ * @param[in] temperatures Temperatures in Celsius degrees
+ * @param[in] no_temperatures Number of temperatures
+ * @param[out] s The sweep to init
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int initSweep(const double *temperatures, const unsigned int no_temperatures, struct sweep *s){
+	s->no_temperatures = no_temperatures;
+	s->temperatures = (double*) calloc(no_temperatures ? no_temperatures : 1, sizeof(double));
+	s->params = (vrna_param_t**) calloc(no_temperatures ? no_temperatures : 1, sizeof(vrna_param_t*));
+	if(!s->temperatures || !s->params){
+		fprintf(stderr, "ERROR: initSweep: could not allocate %u temperatures\n", no_temperatures);
+		free(s->temperatures);
+		free(s->params);
+		return(0);
+	}
+
+	/* create a new model details structure to store the Model Settings */
+	vrna_md_set_default(&s->md);
+	s->md.uniq_ML = 1; // same as the context
+	if(no_temperatures) s->md.temperature = temperatures[0];
+
+	int ok = 1;
+	#pragma omp parallel for
+	for(unsigned int t = 0; t < no_temperatures; ++t){
+		vrna_md_t md = s->md;
+		md.temperature = temperatures[t];
+		s->temperatures[t] = temperatures[t];
+		s->params[t] = vrna_params(&md);
+		if(!s->params[t]){
+			#pragma omp atomic write
+			ok = 0;
+		}
+	}
+
+	if(!ok){
+		fprintf(stderr, "ERROR: initSweep: could not get energy parameters!\n");
+		freeSweep(s);
+	}
+	return(ok);
+}
+
+///  init a sweep from a range of temperatures: from, from+step, ... up to to
+int initSweepRange(const double from, const double to, const double step, struct sweep *s){
+	if(step <= 0.0 || to < from){
+		fprintf(stderr, "ERROR: initSweepRange: empty range %g..%g by %g\n", from, to, step);
+		return(0);
+	}
+
+	const unsigned int n = (unsigned int) ((to - from) / step + 1e-9) + 1;
+	double *temperatures = (double*) malloc(n * sizeof(double));
+	if(!temperatures){
+		fprintf(stderr, "ERROR: initSweepRange: could not allocate %u temperatures\n", n);
+		return(0);
+	}
+	for(unsigned int t = 0; t < n; ++t) temperatures[t] = from + t * step;
+
+	const int ok = initSweep(temperatures, n, s);
+	free(temperatures);
+	return(ok);
+}
+
+void freeSweep(struct sweep *s){
+	if(s->params){
+		for(unsigned int t = 0; t < s->no_temperatures; ++t) free(s->params[t]);
+	}
+	free(s->params);
+	free(s->temperatures);
+	s->params = NULL;
+	s->temperatures = NULL;
+	s->no_temperatures = 0;
+}
+
+///  MFE curve of a sequence and constraint over the temperatures of a sweep
+/**
+ * Every thread builds one fold compound for the set, so sequence encoding and constraint parsing happen once per thread, not once per temperature. Each thread then takes a contiguous block of temperatures; for every one of them only the pre-scaled parameters are substituted before the MFE is computed.
+ *
+ * @param[in] s The sweep
+ * @param[in] seq Sequence, strands separated by '&'
+ * @param[in] constraint Dot-bracket constraint, can be NULL (e.g. made by fn3Constraint, connect3Constraint or fn4Constraint)
+ * @param[in] options Options of vrna_constraints_add (e.g. FN3_CONSTRAINT)
+ * @param[in] threads Number of threads. If 0, the OpenMP default is used.
+ * @param[out] mfe MFE at every temperature, s->no_temperatures values
+ * @param[out] structures MFE structure (with separators) at every temperature, each with space for strlen(seq)+1 chars. If NULL no output will be written.
+ *
+ * @return 1 on success, 0 if some error happened.
+ */
+int sweepMfe(const struct sweep *s, const char *seq, const char *constraint, const unsigned int options, const int threads, float *mfe, char **structures){
+	const unsigned int length = strlen(seq);
+	int ok = 1;
+
+	#pragma omp parallel num_threads(threads ? threads : omp_get_max_threads())
+	{
+		// one fold compound per thread for the whole set
+		vrna_fold_compound_t *fc = vrna_fold_compound(seq, &s->md, VRNA_OPTION_DEFAULT | VRNA_OPTION_HYBRID);
+		char *structure = (char*) malloc(length+1);
+		const int constrained = fc && (!constraint || vrna_constraints_add(fc, constraint, options));
+		if(!fc || !structure || !constrained){
+			#pragma omp atomic write
+			ok = 0;
+		}
+
+		#pragma omp for schedule(static)
+		for(unsigned int t = 0; t < s->no_temperatures; ++t){
+			if(!fc || !structure || !constrained) continue;
+			vrna_params_subst(fc, s->params[t]);
+			mfe[t] = vrna_mfe_dimer(fc, structure);
+			if(structures) insertCutPoints(seq, structure, structures[t]);
+		}
+
+		if(fc) vrna_fold_compound_free(fc);
+		free(structure);
+	}
+
+	if(!ok) fprintf(stderr, "ERROR: sweepMfe: could not create fold compound or add constraint!\n");
+	return(ok);
+}
+
+int sweepMain(int argc, char** argv){
+	double from = 0.0, to = 100.0, step = 5.0;
+	int threads = 0, with_structures = 0;
+
+	int c;
+	while((c = getopt(argc, argv, "a:b:d:t:S")) != -1){
+		switch(c){
+			case 'a': from = strtod(optarg, NULL); break;
+			case 'b': to = strtod(optarg, NULL); break;
+			case 'd': step = strtod(optarg, NULL); break;
+			case 't': threads = atoi(optarg); break;
+			case 'S': with_structures = 1; break;
+			default: optind = argc + 1; break;
+		}
+	}
+
+	// kind of the set and its sequences
+	const int n = argc - optind;
+	const char *kind = n > 0 ? argv[optind] : "";
+	char **arg = argv + optind + 1;
+	if(!((!strcmp(kind, "fn3") && n == 3) || (!strcmp(kind, "connect3") && n == 5) || (!strcmp(kind, "fn4") && n == 3))){
+		fprintf(stderr, "usage: %s [-a from] [-b to] [-d step] [-t threads] [-S] fn3 rna1 rna2 | connect3 rna1 rna2 duplex_str rna3 | fn4 seq str\n", argv[0]);
+		return(1);
+	}
+
+	// the set: sequence with separators and its constraint
+	char *seq, *constraint;
+	unsigned int options;
+	if(!strcmp(kind, "fn3")){
+		const unsigned int length1 = strlen(arg[0]), length2 = strlen(arg[1]);
+		seq = (char*) malloc(length1 + length2 + 2);
+		constraint = (char*) malloc(length1 + length2 + 2);
+		if(seq && constraint){
+			sprintf(seq, "%s&%s", arg[0], arg[1]);
+			fn3Constraint(length1, length2, constraint);
+		}
+		options = FN3_CONSTRAINT;
+	} else if(!strcmp(kind, "connect3")){
+		// the constraint is built in place of the duplex, it has to be a structure of rna1&rna2
+		if(strlen(arg[2]) != strlen(arg[0]) + strlen(arg[1]) + 1 || arg[2][strlen(arg[0])] != '&'){
+			fprintf(stderr, "ERROR: sweepMain: %s is not a structure of %s&%s\n", arg[2], arg[0], arg[1]);
+			return(1);
+		}
+		const unsigned int length = strlen(arg[0]) + strlen(arg[1]) + strlen(arg[3]) + 3;
+		seq = (char*) malloc(length);
+		constraint = (char*) malloc(length);
+		if(seq && constraint){
+			sprintf(seq, "%s&%s&%s", arg[0], arg[1], arg[3]);
+			connect3Constraint(arg[2], strlen(arg[0]), strlen(arg[3]), constraint);
+		}
+		options = CONNECT3_CONSTRAINT;
+	} else {
+		seq = strdup(arg[0]);
+		constraint = (char*) malloc(strlen(arg[1]) + 1);
+		if(seq && constraint) fn4Constraint(arg[1], constraint);
+		options = FN4_CONSTRAINT;
+	}
+
+	struct sweep s;
+	if(!seq || !constraint || !initSweepRange(from, to, step, &s)){
+		free(seq);
+		free(constraint);
+		return(1);
+	}
+
+	// results
+	const unsigned int length = strlen(seq);
+	float *mfe = (float*) calloc(s.no_temperatures, sizeof(float));
+	char **structures = with_structures ? (char**) calloc(s.no_temperatures, sizeof(char*)) : NULL;
+	char *buffer = with_structures ? (char*) calloc((size_t) s.no_temperatures * (length+1), sizeof(char)) : NULL;
+	int error = !mfe || (with_structures && (!structures || !buffer));
+	if(!error && structures) for(unsigned int t = 0; t < s.no_temperatures; ++t) structures[t] = buffer + (size_t) t * (length+1);
+
+	if(!error) error = !sweepMfe(&s, seq, constraint, options, threads, mfe, structures);
+
+	if(!error){
+		printf("temperature\tmfe%s\n", structures ? "\tstructure" : "");
+		for(unsigned int t = 0; t < s.no_temperatures; ++t){
+			if(structures) printf("%g\t%f\t%s\n", s.temperatures[t], mfe[t], structures[t]);
+			else printf("%g\t%f\n", s.temperatures[t], mfe[t]);
+		}
+	}
+
+	free(buffer);
+	free(structures);
+	free(mfe);
+	free(seq);
+	free(constraint);
+	freeSweep(&s);
+	return(error);
+}